@@ -0,0 +1,67 @@
+//
+// Counts the bytes and calls going through the global operator new of the
+// benchmark executable (the library allocates through std::allocator).
+//
+
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> allocatedBytes(0);
+std::atomic<uint64_t> allocations(0);
+
+void *allocate(size_t size) {
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+}
+
+uint64_t AllocationCounter::bytes() {
+    return allocatedBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::count() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void *operator new(size_t size) {
+    void *ptr = allocate(size);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](size_t size) {
+    void *ptr = allocate(size);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
@@ -0,0 +1,18 @@
+//
+// Counts the bytes and calls going through the global operator new of the
+// benchmark executable (the library allocates through std::allocator).
+//
+
+#ifndef THETA_CLIENT_1_0_0_ALLOCATIONCOUNTER_H
+#define THETA_CLIENT_1_0_0_ALLOCATIONCOUNTER_H
+
+#include <cstdint>
+
+class AllocationCounter {
+public:
+    // totals since the start of the process, all threads together
+    static uint64_t bytes();
+    static uint64_t count();
+};
+
+#endif //THETA_CLIENT_1_0_0_ALLOCATIONCOUNTER_H
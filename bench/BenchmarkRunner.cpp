@@ -0,0 +1,190 @@
+//
+// Runs named benchmark scenarios, reports them as JSON and compares them with
+// a baseline produced by an earlier run.
+//
+
+#include "BenchmarkRunner.h"
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+volatile uint64_t sink;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Finds "key": after position and parses the value behind it. Only meant for
+// the flat objects written by writeJson.
+bool findValue(const std::string &json, size_t from, size_t to, const char *key, std::string &value) {
+    const std::string quoted = std::string("\"") + key + "\":";
+    const size_t pos = json.find(quoted, from);
+    if (pos == std::string::npos || pos >= to) return false;
+    size_t start = pos + quoted.length();
+    while (start < to && json[start] == ' ') start++;
+    if (json[start] == '"') {
+        const size_t end = json.find('"', start + 1);
+        value = json.substr(start + 1, end - start - 1);
+    } else {
+        size_t end = start;
+        while (end < to && json[end] != ',' && json[end] != '}' && json[end] != '\n') end++;
+        value = json.substr(start, end - start);
+    }
+    return true;
+}
+
+double number(const std::string &json, size_t from, size_t to, const char *key) {
+    std::string value;
+    if (!findValue(json, from, to, key, value)) throw std::runtime_error(std::string("baseline entry without ") + key);
+    return std::strtod(value.c_str(), nullptr);
+}
+
+}
+
+BenchmarkRunner::BenchmarkRunner(double minSeconds, int samples) : minSeconds_(minSeconds), samples_(samples) {}
+
+void BenchmarkRunner::add(const std::string &name, uint64_t items, uint64_t bytes, Operation operation) {
+    scenarios_.push_back({name, items, bytes, std::move(operation), -1, nullptr});
+}
+
+void BenchmarkRunner::add(const std::string &name, uint64_t items, uint64_t bytes, Operation operation, double exact,
+                          std::function<double()> estimate) {
+    scenarios_.push_back({name, items, bytes, std::move(operation), exact, std::move(estimate)});
+}
+
+std::vector<BenchmarkResult> BenchmarkRunner::run(const std::string &filter) const {
+    std::vector<BenchmarkResult> results;
+    for (const Scenario &scenario : scenarios_) {
+        if (scenario.name.find(filter) == std::string::npos) continue;
+        std::cerr << scenario.name << "..." << std::endl;
+        results.push_back(measure(scenario));
+    }
+    return results;
+}
+
+BenchmarkResult BenchmarkRunner::measure(const Scenario &scenario) const {
+    // warm up the caches and grow the batch until one sample takes long enough
+    sink = sink + scenario.operation();
+    uint64_t batch = 1;
+    for (;;) {
+        const auto start = Clock::now();
+        for (uint64_t i = 0; i < batch; i++) sink = sink + scenario.operation();
+        const double elapsed = secondsSince(start);
+        if (elapsed * samples_ >= minSeconds_ || batch >= (1ULL << 30)) break;
+        batch *= elapsed > 0 ? std::max<uint64_t>(2, std::min<uint64_t>(10, minSeconds_ / samples_ / elapsed + 1)) : 10;
+    }
+
+    // the median sample is reported, it is less sensitive to a noisy neighbour
+    std::vector<double> nsPerOp;
+    nsPerOp.reserve(samples_);
+    const uint64_t bytesBefore = AllocationCounter::bytes();
+    const uint64_t countBefore = AllocationCounter::count();
+    for (int s = 0; s < samples_; s++) {
+        const auto start = Clock::now();
+        for (uint64_t i = 0; i < batch; i++) sink = sink + scenario.operation();
+        nsPerOp.push_back(secondsSince(start) * 1e9 / batch);
+    }
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+    const uint64_t operations = batch * samples_;
+
+    BenchmarkResult result;
+    result.name = scenario.name;
+    result.operations = operations;
+    result.nsPerOp = nsPerOp[nsPerOp.size() / 2];
+    result.bytesAllocatedPerOp = static_cast<double>(AllocationCounter::bytes() - bytesBefore) / operations;
+    result.allocationsPerOp = static_cast<double>(AllocationCounter::count() - countBefore) / operations;
+    result.itemsPerSecond = scenario.items * 1e9 / result.nsPerOp;
+    result.bytesPerSecond = scenario.bytes * 1e9 / result.nsPerOp;
+    result.exact = scenario.estimate ? scenario.exact : -1;
+    result.estimate = scenario.estimate ? scenario.estimate() : -1;
+    return result;
+}
+
+void BenchmarkRunner::writeJson(std::ostream &os, const std::vector<BenchmarkResult> &results) {
+    // one scenario per line keeps baselines diffable
+    os << "{\n  \"benchmarks\": [\n" << std::setprecision(6) << std::fixed;
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &result = results[i];
+        os << "    {\"name\": \"" << result.name << "\""
+           << ", \"operations\": " << result.operations
+           << ", \"ns_per_op\": " << result.nsPerOp
+           << ", \"bytes_allocated_per_op\": " << result.bytesAllocatedPerOp
+           << ", \"allocations_per_op\": " << result.allocationsPerOp
+           << ", \"items_per_second\": " << result.itemsPerSecond
+           << ", \"bytes_per_second\": " << result.bytesPerSecond;
+        if (result.exact >= 0) {
+            os << ", \"exact\": " << result.exact << ", \"estimate\": " << result.estimate
+               << ", \"relative_error\": " << (result.exact > 0 ? result.estimate / result.exact - 1 : 0);
+        }
+        os << "}"
+           << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+std::vector<BenchmarkResult> BenchmarkRunner::readJson(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) throw std::runtime_error("cannot open " + path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string json = buffer.str();
+
+    std::vector<BenchmarkResult> results;
+    size_t pos = 0;
+    while ((pos = json.find('{', pos + 1)) != std::string::npos) {
+        const size_t end = json.find('}', pos);
+        if (end == std::string::npos) break;
+        BenchmarkResult result;
+        if (!findValue(json, pos, end, "name", result.name)) {
+            pos = end;
+            continue;
+        }
+        result.operations = static_cast<uint64_t>(number(json, pos, end, "operations"));
+        result.nsPerOp = number(json, pos, end, "ns_per_op");
+        result.bytesAllocatedPerOp = number(json, pos, end, "bytes_allocated_per_op");
+        result.allocationsPerOp = number(json, pos, end, "allocations_per_op");
+        result.itemsPerSecond = number(json, pos, end, "items_per_second");
+        result.bytesPerSecond = number(json, pos, end, "bytes_per_second");
+        std::string value;
+        result.exact = findValue(json, pos, end, "exact", value) ? std::strtod(value.c_str(), nullptr) : -1;
+        result.estimate = findValue(json, pos, end, "estimate", value) ? std::strtod(value.c_str(), nullptr) : -1;
+        results.push_back(result);
+        pos = end;
+    }
+    return results;
+}
+
+int BenchmarkRunner::compare(std::ostream &os, const std::vector<BenchmarkResult> &baseline,
+                             const std::vector<BenchmarkResult> &results, double threshold) {
+    int regressions = 0;
+    os << std::fixed << std::setprecision(1);
+    for (const BenchmarkResult &result : results) {
+        auto it = std::find_if(baseline.begin(), baseline.end(),
+                               [&result](const BenchmarkResult &b) { return b.name == result.name; });
+        if (it == baseline.end()) {
+            os << result.name << ": not in baseline" << std::endl;
+            continue;
+        }
+        const double time = result.nsPerOp / it->nsPerOp - 1;
+        const double memory = it->bytesAllocatedPerOp > 0
+                ? result.bytesAllocatedPerOp / it->bytesAllocatedPerOp - 1
+                : (result.bytesAllocatedPerOp > 0 ? 1 : 0);
+        const bool slower = time > threshold;
+        const bool bigger = memory > threshold;
+        os << result.name << ": time " << std::showpos << time * 100 << "%, allocated " << memory * 100 << "%"
+           << std::noshowpos << (slower || bigger ? "  REGRESSION" : "") << std::endl;
+        if (slower || bigger) regressions++;
+    }
+    return regressions;
+}
@@ -0,0 +1,71 @@
+//
+// Runs named benchmark scenarios, reports them as JSON and compares them with
+// a baseline produced by an earlier run.
+//
+
+#ifndef THETA_CLIENT_1_0_0_BENCHMARKRUNNER_H
+#define THETA_CLIENT_1_0_0_BENCHMARKRUNNER_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BenchmarkResult {
+    std::string name;
+    uint64_t operations;
+    double nsPerOp;
+    double bytesAllocatedPerOp;
+    double allocationsPerOp;
+    double itemsPerSecond;
+    double bytesPerSecond;      // 0 when the scenario has no byte throughput
+    // accuracy of scenarios with a known answer, both negative otherwise
+    double exact;
+    double estimate;
+};
+
+class BenchmarkRunner {
+public:
+    // An operation returns a value that is folded into a sink, so that the
+    // compiler cannot drop the work.
+    typedef std::function<uint64_t()> Operation;
+
+    BenchmarkRunner(double minSeconds, int samples);
+
+    // items and bytes are processed by one call of the operation
+    void add(const std::string &name, uint64_t items, uint64_t bytes, Operation operation);
+    // the same for a scenario with a known answer, estimate is called once after the measurement
+    void add(const std::string &name, uint64_t items, uint64_t bytes, Operation operation, double exact,
+             std::function<double()> estimate);
+
+    // runs the scenarios whose name contains filter, in registration order
+    std::vector<BenchmarkResult> run(const std::string &filter) const;
+
+    static void writeJson(std::ostream &os, const std::vector<BenchmarkResult> &results);
+    // reads back what writeJson wrote
+    static std::vector<BenchmarkResult> readJson(const std::string &path);
+
+    // Prints how results differ from baseline; returns the number of scenarios
+    // that got slower or allocate more by more than threshold (0.1 = 10%)
+    static int compare(std::ostream &os, const std::vector<BenchmarkResult> &baseline,
+                       const std::vector<BenchmarkResult> &results, double threshold);
+
+private:
+    struct Scenario {
+        std::string name;
+        uint64_t items;
+        uint64_t bytes;
+        Operation operation;
+        double exact;
+        std::function<double()> estimate;
+    };
+
+    double minSeconds_;
+    int samples_;
+    std::vector<Scenario> scenarios_;
+
+    BenchmarkResult measure(const Scenario &scenario) const;
+};
+
+#endif //THETA_CLIENT_1_0_0_BENCHMARKRUNNER_H
@@ -0,0 +1,414 @@
+//
+// The theta sketch scenarios of theta-bench. Inputs are deterministic: update
+// keys are consecutive integers and the set operations run over sketches.txt
+// and over a synthetic workload with known cardinalities.
+//
+
+#include "ThetaScenarios.h"
+#include "../src/HexSketchReader.h"
+#include "../src/WorkloadGenerator.h"
+#include "../src/common.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <theta_a_not_b.hpp>
+#include <theta_atomic_sketch.hpp>
+#include <theta_concurrent_sketch.hpp>
+#include <theta_direct_sketch.hpp>
+#include <theta_intersection.hpp>
+#include <theta_union.hpp>
+
+using namespace datasketches;
+
+namespace {
+
+const uint64_t UPDATE_KEYS = 1 << 20;
+const uint8_t UPDATE_LG_KS[] = {10, 12, 16, 20};
+// tables from about L2 size up to 1 GiB
+const uint8_t RESIDENT_LG_KS[] = {16, 18, 20, 22, 24, 26};
+// keys of the ordered set operation inputs, 4K to 1M
+const uint8_t ORDERED_LG_KEYS[] = {12, 16, 20};
+
+update_theta_sketch makeUpdateSketch(uint8_t lgK, uint64_t keys) {
+    auto sketch = update_theta_sketch::builder().set_lg_k(lgK).set_seed(SEED_DEFAULT).build();
+    for (uint64_t i = 0; i < keys; i++) sketch.update(i);
+    return sketch;
+}
+
+// the same updates in caller-owned memory, sized up front so that it never grows
+uint32_t updateDirectSketch(uint8_t lgK, uint64_t keys) {
+    std::vector<uint64_t> memory(direct_update_theta_sketch::get_max_serialized_size_bytes(lgK) / sizeof(uint64_t));
+    auto builder = update_theta_sketch::builder().set_lg_k(lgK).set_seed(SEED_DEFAULT);
+    auto sketch = direct_update_theta_sketch::initialize(memory.data(), memory.size() * sizeof(uint64_t), builder);
+    for (uint64_t i = 0; i < keys; i++) sketch.update(i);
+    return sketch.get_num_retained();
+}
+
+// a thread per task, for the parallel set operations; joins them when destroyed
+class ThreadPerTask {
+public:
+    ~ThreadPerTask() {
+        for (auto &thread : threads_) thread.join();
+    }
+    void operator()(std::function<void()> task) { threads_.emplace_back(std::move(task)); }
+
+private:
+    std::vector<std::thread> threads_;
+};
+
+update_theta_sketch makeUpdateSketchBatched(uint8_t lgK, const std::vector<uint64_t> &keys) {
+    auto sketch = update_theta_sketch::builder().set_lg_k(lgK).set_seed(SEED_DEFAULT).build();
+    sketch.update_batch(keys.data(), keys.size());
+    return sketch;
+}
+
+}
+
+ThetaScenarios::ThetaScenarios(const std::string &sketchesPath) : sketchesPath_(sketchesPath) {}
+
+void ThetaScenarios::addTo(BenchmarkRunner &runner) {
+    updateKeys_.resize(UPDATE_KEYS);
+    for (uint64_t i = 0; i < UPDATE_KEYS; i++) updateKeys_[i] = i;
+    for (uint8_t lgK : UPDATE_LG_KS) {
+        const std::string suffix = "/lg_k=" + std::to_string(lgK);
+        runner.add("update" + suffix, UPDATE_KEYS, 0, [lgK]() {
+            return makeUpdateSketch(lgK, UPDATE_KEYS).get_num_retained();
+        });
+        runner.add("update_batch" + suffix, UPDATE_KEYS, 0, [this, lgK]() {
+            return makeUpdateSketchBatched(lgK, updateKeys_).get_num_retained();
+        });
+        runner.add("update_direct" + suffix, UPDATE_KEYS, 0, [lgK]() {
+            return updateDirectSketch(lgK, UPDATE_KEYS);
+        });
+
+        // the sketches below are in estimation mode, the interesting case
+        updateSketches_.emplace_back(new update_theta_sketch(makeUpdateSketch(lgK, UPDATE_KEYS)));
+        const update_theta_sketch &updateSketch = *updateSketches_.back();
+        const uint64_t retained = updateSketch.get_num_retained();
+        runner.add("compact_ordered" + suffix, retained, 0, [&updateSketch]() {
+            return updateSketch.compact(true).get_num_retained();
+        });
+        runner.add("compact_unordered" + suffix, retained, 0, [&updateSketch]() {
+            return updateSketch.compact(false).get_num_retained();
+        });
+
+        compactSketches_.emplace_back(new compact_theta_sketch(updateSketch.compact()));
+        const compact_theta_sketch &compactSketch = *compactSketches_.back();
+        const auto bytes = compactSketch.serialize();
+        const uint8_t *begin = static_cast<const uint8_t *>(bytes.first.get());
+        serialized_.emplace_back(begin, begin + bytes.second);
+        // the buffer of the inner vector stays put when serialized_ grows
+        const uint8_t *data = serialized_.back().data();
+        const size_t size = bytes.second;
+        runner.add("serialize" + suffix, retained, size, [&compactSketch]() {
+            return static_cast<uint64_t>(compactSketch.serialize().second);
+        });
+        runner.add("deserialize" + suffix, retained, size, [data, size]() {
+            return compact_theta_sketch::deserialize(data, size, SEED_DEFAULT).get_num_retained();
+        });
+        // the keys read in place, where deserialize copies them
+        runner.add("view" + suffix, retained, size, [data, size]() {
+            const compact_theta_sketch_view view(data, size, SEED_DEFAULT);
+            uint64_t sum = 0;
+            for (uint64_t key : view) sum += key;
+            return sum;
+        });
+
+        // the same sketch delta-encoded, bytes are the compressed size
+        const auto packed = compactSketch.serialize_compressed();
+        const uint8_t *packedBegin = static_cast<const uint8_t *>(packed.first.get());
+        serialized_.emplace_back(packedBegin, packedBegin + packed.second);
+        const uint8_t *packedData = serialized_.back().data();
+        const size_t packedSize = packed.second;
+        runner.add("serialize_compressed" + suffix, retained, packedSize, [&compactSketch]() {
+            return static_cast<uint64_t>(compactSketch.serialize_compressed().second);
+        });
+        runner.add("deserialize_compressed" + suffix, retained, packedSize, [packedData, packedSize]() {
+            return compact_theta_sketch::deserialize(packedData, packedSize, SEED_DEFAULT).get_num_retained();
+        });
+    }
+
+    addResident(runner);
+    addConcurrent(runner);
+    addGenerated(runner);
+    addOrdered(runner);
+
+    if (sketchesPath_.empty()) return;
+    HexSketchReader reader(sketchesPath_);
+    const unsigned char *data;
+    size_t size;
+    uint64_t inputBytes = 0;
+    while (reader.next(data, size)) {
+        inputs_.emplace_back(new compact_theta_sketch(compact_theta_sketch::deserialize(data, size, SEED_DEFAULT)));
+        inputBytes += size;
+    }
+    if (inputs_.size() < 2) {
+        std::cerr << sketchesPath_ << ": set operations need at least two sketches, skipped" << std::endl;
+        return;
+    }
+    const auto &inputs = inputs_;
+    runner.add("intersection/sketches.txt", inputs.size(), inputBytes, [&inputs]() {
+        auto intersection = theta_intersection(SEED_DEFAULT);
+        for (const auto &sketch : inputs) intersection.update(*sketch);
+        return intersection.get_result().get_num_retained();
+    });
+    runner.add("union/sketches.txt", inputs.size(), inputBytes, [&inputs]() {
+        auto u = theta_union::builder().set_seed(SEED_DEFAULT).build();
+        for (const auto &sketch : inputs) u.update(*sketch);
+        return u.get_result().get_num_retained();
+    });
+    // the first sketch minus each of the others
+    runner.add("a_not_b/sketches.txt", inputs.size() - 1, inputBytes, [&inputs]() {
+        theta_a_not_b a_not_b(SEED_DEFAULT);
+        uint64_t retained = 0;
+        for (size_t i = 1; i < inputs.size(); i++) retained += a_not_b.compute(*inputs[0], *inputs[i]).get_num_retained();
+        return retained;
+    });
+}
+
+void ThetaScenarios::addResident(BenchmarkRunner &runner) {
+    // Updates of keys a full table already holds: every update probes the table
+    // and none changes it. The sketches take long to fill and up to 1 GiB, they
+    // are built by the warm-up call of the first scenario that needs them.
+    residentSketches_.resize(sizeof(RESIDENT_LG_KS));
+    for (size_t i = 0; i < sizeof(RESIDENT_LG_KS); i++) {
+        const uint8_t lgK = RESIDENT_LG_KS[i];
+        const uint64_t keys = std::min<uint64_t>(UPDATE_KEYS, 1ULL << lgK);
+        auto resident = [this, i, lgK]() -> update_theta_sketch & {
+            if (!residentSketches_[i]) {
+                residentSketches_[i].reset(new update_theta_sketch(makeUpdateSketch(lgK, 1ULL << lgK)));
+            }
+            return *residentSketches_[i];
+        };
+        const std::string suffix = "/lg_k=" + std::to_string(lgK);
+        runner.add("update_resident" + suffix, keys, 0, [this, resident, keys]() {
+            update_theta_sketch &sketch = resident();
+            for (uint64_t k = 0; k < keys; k++) sketch.update(updateKeys_[k]);
+            return static_cast<uint64_t>(sketch.get_num_retained());
+        });
+        runner.add("update_batch_resident" + suffix, keys, 0, [this, resident, keys]() {
+            update_theta_sketch &sketch = resident();
+            sketch.update_batch(updateKeys_.data(), keys);
+            return static_cast<uint64_t>(sketch.get_num_retained());
+        });
+    }
+}
+
+void ThetaScenarios::addConcurrent(BenchmarkRunner &runner) {
+    // one logical sketch fed by several threads: a concurrent sketch, against a
+    // sketch per thread that are united at the end
+    const unsigned threadCount = 4;
+    const uint64_t keysPerThread = UPDATE_KEYS / threadCount;
+    const std::string suffix = "/threads=" + std::to_string(threadCount);
+    runner.add("concurrent_update" + suffix, UPDATE_KEYS, 0, [threadCount, keysPerThread]() {
+        concurrent_theta_sketch shared(update_theta_sketch::builder().set_lg_k(LOGK_DEFAULT).set_seed(SEED_DEFAULT).build());
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < threadCount; t++) {
+            threads.emplace_back([&shared, t, keysPerThread]() {
+                concurrent_theta_sketch::local_buffer buffer(shared);
+                for (uint64_t i = t * keysPerThread; i < (t + 1) * keysPerThread; i++) buffer.update(i);
+            });
+        }
+        for (auto &thread : threads) thread.join();
+        return shared.compact().get_num_retained();
+    });
+    // low cardinality at a high rate: every thread repeats the same 4096 keys
+    runner.add("atomic_update" + suffix, UPDATE_KEYS, 0, [threadCount, keysPerThread]() {
+        atomic_update_theta_sketch shared(LOGK_DEFAULT, SEED_DEFAULT);
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < threadCount; t++) {
+            threads.emplace_back([&shared, keysPerThread]() {
+                for (uint64_t i = 0; i < keysPerThread; i++) shared.update(i % 4096);
+            });
+        }
+        for (auto &thread : threads) thread.join();
+        return static_cast<uint64_t>(shared.get_num_retained());
+    });
+    runner.add("per_thread_union" + suffix, UPDATE_KEYS, 0, [threadCount, keysPerThread]() {
+        std::vector<update_theta_sketch> sketches;
+        for (unsigned t = 0; t < threadCount; t++) {
+            sketches.push_back(update_theta_sketch::builder().set_lg_k(LOGK_DEFAULT).set_seed(SEED_DEFAULT).build());
+        }
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < threadCount; t++) {
+            threads.emplace_back([&sketches, t, keysPerThread]() {
+                for (uint64_t i = t * keysPerThread; i < (t + 1) * keysPerThread; i++) sketches[t].update(i);
+            });
+        }
+        for (auto &thread : threads) thread.join();
+        auto u = theta_union::builder().set_lg_k(LOGK_DEFAULT).set_seed(SEED_DEFAULT).build();
+        for (const auto &sketch : sketches) u.update(sketch);
+        return u.get_result().get_num_retained();
+    });
+}
+
+void ThetaScenarios::addOrdered(BenchmarkRunner &runner) {
+    // Two exact mode sketches of n keys sharing half of them, in both orderings,
+    // and one of n / 256 keys from the shared half. Built by the first warm-up call.
+    enum { A_ORDERED, B_ORDERED, A_UNORDERED, B_UNORDERED, SMALL_ORDERED };
+    orderedInputs_.resize(sizeof(ORDERED_LG_KEYS));
+    for (size_t i = 0; i < sizeof(ORDERED_LG_KEYS); i++) {
+        const uint8_t lgKeys = ORDERED_LG_KEYS[i];
+        const uint64_t n = 1ULL << lgKeys;
+        auto inputs = [this, i, lgKeys, n]() -> OrderedInputs & {
+            OrderedInputs &inputs = orderedInputs_[i];
+            if (inputs.sketches.empty()) {
+                const update_theta_sketch a = makeUpdateSketch(lgKeys, n);
+                auto b = update_theta_sketch::builder().set_lg_k(lgKeys).set_seed(SEED_DEFAULT).build();
+                for (uint64_t k = n / 2; k < n + n / 2; k++) b.update(k);
+                auto small = update_theta_sketch::builder().set_lg_k(lgKeys).set_seed(SEED_DEFAULT).build();
+                for (uint64_t k = n / 2; k < n / 2 + n / 256; k++) small.update(k);
+                inputs.sketches.push_back(a.compact(true));
+                inputs.sketches.push_back(b.compact(true));
+                inputs.sketches.push_back(a.compact(false));
+                inputs.sketches.push_back(b.compact(false));
+                inputs.sketches.push_back(small.compact(true));
+                inputs.keysA.assign(inputs.sketches[A_ORDERED].begin(), inputs.sketches[A_ORDERED].end());
+                inputs.keysB.assign(inputs.sketches[B_ORDERED].begin(), inputs.sketches[B_ORDERED].end());
+                inputs.out.resize(inputs.keysA.size());
+            }
+            return inputs;
+        };
+        auto intersect = [inputs](int first, int second) {
+            const std::vector<compact_theta_sketch> &sketches = inputs().sketches;
+            auto intersection = theta_intersection(SEED_DEFAULT);
+            intersection.update(sketches[first]);
+            intersection.update(sketches[second]);
+            return static_cast<uint64_t>(intersection.get_result().get_num_retained());
+        };
+        auto subtract = [inputs](int first, int second) {
+            const std::vector<compact_theta_sketch> &sketches = inputs().sketches;
+            return static_cast<uint64_t>(theta_a_not_b(SEED_DEFAULT).compute(sketches[first], sketches[second]).get_num_retained());
+        };
+        // the merge kernels alone, scalar and as dispatched for this CPU
+        typedef uint32_t (*Kernel)(const uint64_t *, uint32_t, const uint64_t *, uint32_t, uint64_t *);
+        auto merge = [inputs](Kernel kernel) {
+            OrderedInputs &in = inputs();
+            return static_cast<uint64_t>(kernel(in.keysA.data(), in.keysA.size(), in.keysB.data(), in.keysB.size(), in.out.data()));
+        };
+
+        const std::string suffix = "/keys=" + std::to_string(n);
+        runner.add("intersection_ordered" + suffix, 2 * n, 0, [intersect]() {
+            return intersect(A_ORDERED, B_ORDERED);
+        });
+        runner.add("intersection_unordered" + suffix, 2 * n, 0, [intersect]() {
+            return intersect(A_UNORDERED, B_UNORDERED);
+        });
+        runner.add("intersection_unbalanced" + suffix, n + n / 256, 0, [intersect]() {
+            return intersect(SMALL_ORDERED, A_ORDERED);
+        });
+        // the large ones first as given, and the same range planned by intersect()
+        runner.add("intersection_large_first" + suffix, 2 * n + n / 256, 0, [inputs]() {
+            const std::vector<compact_theta_sketch> &sketches = inputs().sketches;
+            auto intersection = theta_intersection(SEED_DEFAULT);
+            for (int k : {A_UNORDERED, B_ORDERED, SMALL_ORDERED}) intersection.update(sketches[k]);
+            return static_cast<uint64_t>(intersection.get_result().get_num_retained());
+        });
+        runner.add("intersect_planned" + suffix, 2 * n + n / 256, 0, [inputs]() {
+            const std::vector<compact_theta_sketch> &sketches = inputs().sketches;
+            const std::reference_wrapper<const compact_theta_sketch> range[] = {
+                sketches[A_UNORDERED], sketches[B_ORDERED], sketches[SMALL_ORDERED]
+            };
+            auto intersection = theta_intersection(SEED_DEFAULT);
+            intersection.intersect(range, range + 3);
+            return static_cast<uint64_t>(intersection.get_result().get_num_retained());
+        });
+        runner.add("a_not_b_ordered" + suffix, 2 * n, 0, [subtract]() {
+            return subtract(A_ORDERED, B_ORDERED);
+        });
+        runner.add("a_not_b_unordered" + suffix, 2 * n, 0, [subtract]() {
+            return subtract(A_UNORDERED, B_UNORDERED);
+        });
+        runner.add("sorted_intersection_scalar" + suffix, 2 * n, 0, [merge]() {
+            return merge(&sorted_set_merge_scalar<true>);
+        });
+        runner.add("sorted_intersection" + suffix, 2 * n, 0, [merge]() {
+            return merge(&sorted_set_merge<true>);
+        });
+        runner.add("sorted_difference_scalar" + suffix, 2 * n, 0, [merge]() {
+            return merge(&sorted_set_merge_scalar<false>);
+        });
+        runner.add("sorted_difference" + suffix, 2 * n, 0, [merge]() {
+            return merge(&sorted_set_merge<false>);
+        });
+    }
+}
+
+void ThetaScenarios::addGenerated(BenchmarkRunner &runner) {
+    WorkloadGenerator::Config config;
+    config.sketches = 16;
+    config.coreKeys = 200000;
+    config.pairwiseKeys = 10000;
+    config.uniqueKeys = 50000;
+    config.lgK = LOGK_DEFAULT;
+    config.seed = 0;
+    const WorkloadGenerator generator(config);
+    generated_ = generator.build(std::thread::hardware_concurrency());
+
+    const auto &sketches = generated_;
+    auto intersect = [&sketches]() {
+        auto intersection = theta_intersection(SEED_DEFAULT);
+        for (const auto &sketch : sketches) intersection.update(sketch);
+        return intersection.get_result();
+    };
+    runner.add("intersection/generated_16", sketches.size(), 0, [intersect]() {
+        return intersect().get_num_retained();
+    }, generator.intersection(), [intersect]() {
+        return intersect().get_estimate();
+    });
+    const uint8_t lgK = config.lgK;
+    auto unite = [&sketches, lgK]() {
+        auto u = theta_union::builder().set_lg_k(lgK).set_seed(SEED_DEFAULT).build();
+        for (const auto &sketch : sketches) u.update(sketch);
+        return u.get_result();
+    };
+    runner.add("union/generated_16", sketches.size(), 0, [unite]() {
+        return unite().get_num_retained();
+    }, generator.unionCardinality(), [unite]() {
+        return unite().get_estimate();
+    });
+    // the same ordered inputs as one range, merged without the hash table
+    auto merge = [&sketches, lgK]() {
+        auto u = theta_union::builder().set_lg_k(lgK).set_seed(SEED_DEFAULT).build();
+        u.update(sketches.begin(), sketches.end());
+        return u.get_result();
+    };
+    runner.add("union_merged/generated_16", sketches.size(), 0, [merge]() {
+        return merge().get_num_retained();
+    }, generator.unionCardinality(), [merge]() {
+        return merge().get_estimate();
+    });
+    const unsigned tasks = 4;
+    auto uniteParallel = [&sketches, lgK, tasks]() {
+        auto u = theta_union::builder().set_lg_k(lgK).set_seed(SEED_DEFAULT).build();
+        ThreadPerTask executor;
+        u.update(sketches.begin(), sketches.end(), executor, tasks);
+        return u.get_result();
+    };
+    runner.add("union_parallel/generated_16/tasks=" + std::to_string(tasks), sketches.size(), 0, [uniteParallel]() {
+        return uniteParallel().get_num_retained();
+    }, generator.unionCardinality(), [uniteParallel]() {
+        return uniteParallel().get_estimate();
+    });
+
+    // the same inputs read from a stream, deserialized first and as they are read
+    std::ostringstream os(std::ios::binary);
+    for (const auto &sketch : sketches) sketch.serialize(os);
+    generatedStream_ = os.str();
+    const std::string &stream = generatedStream_;
+    runner.add("union_deserialized/generated_16", sketches.size(), stream.size(), [&stream, lgK]() {
+        std::istringstream is(stream, std::ios::binary);
+        auto u = theta_union::builder().set_lg_k(lgK).set_seed(SEED_DEFAULT).build();
+        while (is.peek() != std::char_traits<char>::eof()) u.update(compact_theta_sketch::deserialize(is, SEED_DEFAULT));
+        return u.get_result().get_num_retained();
+    });
+    runner.add("union_streamed/generated_16", sketches.size(), stream.size(), [&stream, lgK]() {
+        std::istringstream is(stream, std::ios::binary);
+        auto u = theta_union::builder().set_lg_k(lgK).set_seed(SEED_DEFAULT).build();
+        while (is.peek() != std::char_traits<char>::eof()) u.update(is);
+        return u.get_result().get_num_retained();
+    });
+}
@@ -0,0 +1,52 @@
+//
+// The theta sketch scenarios of theta-bench. Inputs are deterministic: update
+// keys are consecutive integers and the set operations run over sketches.txt
+// and over a synthetic workload with known cardinalities.
+//
+
+#ifndef THETA_CLIENT_1_0_0_THETASCENARIOS_H
+#define THETA_CLIENT_1_0_0_THETASCENARIOS_H
+
+#include "BenchmarkRunner.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <theta_sketch.hpp>
+
+class ThetaScenarios {
+public:
+    // sketchesPath may be empty, the set operation scenarios are skipped then
+    explicit ThetaScenarios(const std::string &sketchesPath);
+
+    // the scenarios refer to this object, which must outlive the runs
+    void addTo(BenchmarkRunner &runner);
+
+private:
+    std::string sketchesPath_;
+    std::vector<uint64_t> updateKeys_;
+    std::vector<std::unique_ptr<datasketches::update_theta_sketch>> updateSketches_;
+    std::vector<std::unique_ptr<datasketches::compact_theta_sketch>> compactSketches_;
+    std::vector<std::unique_ptr<datasketches::update_theta_sketch>> residentSketches_;
+    std::vector<std::vector<uint8_t>> serialized_;
+    std::vector<std::unique_ptr<datasketches::compact_theta_sketch>> inputs_;
+    std::vector<datasketches::compact_theta_sketch> generated_;
+    // generated_ serialized one after the other
+    std::string generatedStream_;
+    struct OrderedInputs {
+        std::vector<datasketches::compact_theta_sketch> sketches;
+        // keys of the first two sketches, and room for a result
+        std::vector<uint64_t> keysA;
+        std::vector<uint64_t> keysB;
+        std::vector<uint64_t> out;
+    };
+    std::vector<OrderedInputs> orderedInputs_;
+
+    void addResident(BenchmarkRunner &runner);
+    void addConcurrent(BenchmarkRunner &runner);
+    void addGenerated(BenchmarkRunner &runner);
+    void addOrdered(BenchmarkRunner &runner);
+};
+
+#endif //THETA_CLIENT_1_0_0_THETASCENARIOS_H
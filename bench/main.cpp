@@ -0,0 +1,69 @@
+//
+// theta-bench: runs the benchmark scenarios and prints the results as JSON.
+//
+// theta-bench [--sketches <sketches.txt>] [--filter <substring>] [--min-time <seconds>]
+//             [--samples <n>] [--output <file>] [--baseline <file>] [--threshold <percent>]
+//
+// With --baseline, the run is compared with the results saved by an earlier
+// --output and the exit status is 1 if any scenario regressed.
+//
+
+#include "BenchmarkRunner.h"
+#include "ThetaScenarios.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+const char *SKETCHES_DEFAULT = "thirdparty/parquet/sketches.txt";
+
+int usage(const char *name) {
+    std::cerr << "Usage: " << name << " [--sketches <sketches.txt>] [--filter <substring>] [--min-time <seconds>]"
+              << " [--samples <n>] [--output <file>] [--baseline <file>] [--threshold <percent>]" << std::endl;
+    return 2;
+}
+
+}
+
+int main(int argc, char **argv) {
+    std::string sketches = std::ifstream(SKETCHES_DEFAULT) ? SKETCHES_DEFAULT : "";
+    std::string filter;
+    std::string output;
+    std::string baseline;
+    double minSeconds = 1;
+    int samples = 5;
+    double threshold = 10;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) return usage(argv[0]);
+        const char *value = argv[++i];
+        if (arg == "--sketches") sketches = value;
+        else if (arg == "--filter") filter = value;
+        else if (arg == "--min-time") minSeconds = std::atof(value);
+        else if (arg == "--samples") samples = std::atoi(value);
+        else if (arg == "--output") output = value;
+        else if (arg == "--baseline") baseline = value;
+        else if (arg == "--threshold") threshold = std::atof(value);
+        else return usage(argv[0]);
+    }
+    if (samples < 1) return usage(argv[0]);
+
+    BenchmarkRunner runner(minSeconds, samples);
+    ThetaScenarios scenarios(sketches);
+    scenarios.addTo(runner);
+    const auto results = runner.run(filter);
+
+    BenchmarkRunner::writeJson(std::cout, results);
+    if (!output.empty()) {
+        std::ofstream file(output);
+        BenchmarkRunner::writeJson(file, results);
+    }
+    if (baseline.empty()) return 0;
+    const int regressions = BenchmarkRunner::compare(std::cerr, BenchmarkRunner::readJson(baseline), results,
+                                                     threshold / 100);
+    std::cerr << regressions << " regression(s) above " << threshold << "%" << std::endl;
+    return regressions > 0 ? 1 : 0;
+}
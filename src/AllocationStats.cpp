@@ -0,0 +1,86 @@
+//
+// Process-wide allocation accounting for CountingAllocator: live bytes, peak
+// bytes and allocation counts per category. The category of an allocation is
+// taken from the innermost AllocationScope of the allocating thread.
+//
+
+#include "AllocationStats.h"
+
+#include <atomic>
+
+namespace {
+
+struct AtomicCounters {
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> allocatedBytes;
+    std::atomic<int64_t> liveBytes;
+    std::atomic<int64_t> peakBytes;
+};
+
+// zero initialized, being static
+AtomicCounters counters[AllocationStats::CATEGORIES + 1];
+AtomicCounters &total = counters[AllocationStats::CATEGORIES];
+
+thread_local AllocationCategory currentCategory = AllocationCategory::OTHER;
+
+void raisePeak(AtomicCounters &c, int64_t live) {
+    int64_t peak = c.peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !c.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+void add(AtomicCounters &c, size_t bytes) {
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    c.allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    raisePeak(c, c.liveBytes.fetch_add(bytes, std::memory_order_relaxed) + static_cast<int64_t>(bytes));
+}
+
+AllocationStats::Counters load(const AtomicCounters &c) {
+    return {c.allocations.load(std::memory_order_relaxed), c.allocatedBytes.load(std::memory_order_relaxed),
+            c.liveBytes.load(std::memory_order_relaxed), c.peakBytes.load(std::memory_order_relaxed)};
+}
+
+}
+
+void AllocationStats::allocated(AllocationCategory category, size_t bytes) {
+    add(counters[static_cast<int>(category)], bytes);
+    add(total, bytes);
+}
+
+void AllocationStats::deallocated(AllocationCategory category, size_t bytes) {
+    counters[static_cast<int>(category)].liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    total.liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+AllocationStats::Snapshot AllocationStats::snapshot() {
+    Snapshot snapshot;
+    for (int i = 0; i < CATEGORIES; i++) snapshot.categories[i] = load(counters[i]);
+    snapshot.total = load(total);
+    return snapshot;
+}
+
+void AllocationStats::resetPeaks() {
+    for (AtomicCounters &c : counters) c.peakBytes.store(c.liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+const char *AllocationStats::name(AllocationCategory category) {
+    switch (category) {
+        case AllocationCategory::TABLE: return "table";
+        case AllocationCategory::COMPACT_KEYS: return "compact keys";
+        case AllocationCategory::INTERSECTION_SCRATCH: return "intersection scratch";
+        case AllocationCategory::SERIALIZED: return "serialized";
+        case AllocationCategory::OTHER: return "other";
+    }
+    return "?";
+}
+
+AllocationCategory AllocationStats::current() {
+    return currentCategory;
+}
+
+AllocationScope::AllocationScope(AllocationCategory category) : previous_(currentCategory) {
+    currentCategory = category;
+}
+
+AllocationScope::~AllocationScope() {
+    currentCategory = previous_;
+}
@@ -0,0 +1,66 @@
+//
+// Process-wide allocation accounting for CountingAllocator: live bytes, peak
+// bytes and allocation counts per category. The category of an allocation is
+// taken from the innermost AllocationScope of the allocating thread.
+//
+
+#ifndef THETA_CLIENT_1_0_0_ALLOCATIONSTATS_H
+#define THETA_CLIENT_1_0_0_ALLOCATIONSTATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+enum class AllocationCategory {
+    TABLE,                  // hash tables of update sketches
+    COMPACT_KEYS,           // key arrays of compact sketches
+    INTERSECTION_SCRATCH,   // hash table and match buffer of intersections
+    SERIALIZED,             // serialization buffers
+    OTHER                   // anything allocated outside of a scope
+};
+
+class AllocationStats {
+public:
+    static const int CATEGORIES = static_cast<int>(AllocationCategory::OTHER) + 1;
+
+    struct Counters {
+        uint64_t allocations;
+        uint64_t allocatedBytes;    // cumulative
+        int64_t liveBytes;
+        int64_t peakBytes;          // since the last resetPeaks()
+    };
+
+    struct Snapshot {
+        Counters categories[CATEGORIES];
+        Counters total;
+    };
+
+    static void allocated(AllocationCategory category, size_t bytes);
+    static void deallocated(AllocationCategory category, size_t bytes);
+
+    static Snapshot snapshot();
+    // starts a new peak measurement from the current live bytes
+    static void resetPeaks();
+
+    static const char *name(AllocationCategory category);
+    // category of the allocations made by the calling thread right now
+    static AllocationCategory current();
+
+private:
+    friend class AllocationScope;
+};
+
+// Attributes the allocations of the current thread to a category while alive
+class AllocationScope {
+public:
+    explicit AllocationScope(AllocationCategory category);
+    ~AllocationScope();
+
+    AllocationScope(const AllocationScope &) = delete;
+    AllocationScope &operator=(const AllocationScope &) = delete;
+
+private:
+    AllocationCategory previous_;
+};
+
+#endif //THETA_CLIENT_1_0_0_ALLOCATIONSTATS_H
@@ -0,0 +1,91 @@
+//
+// Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's
+// sequence-numbered ring buffer). The capacity is rounded up to a power of two.
+//
+
+#ifndef THETA_CLIENT_1_0_0_BOUNDEDQUEUE_H
+#define THETA_CLIENT_1_0_0_BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : cells_(roundUp(capacity)), mask_(cells_.size() - 1),
+                                             enqueuePos_(0), dequeuePos_(0) {
+        for (size_t i = 0; i < cells_.size(); i++) cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    // returns false if the queue is full, value is left untouched then
+    bool tryPush(T &value) {
+        Cell *cell;
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // returns false if the queue is empty
+    bool tryPop(T &value) {
+        Cell *cell;
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return cells_.size(); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+
+        Cell() : sequence(0), value() {}
+    };
+
+    static size_t roundUp(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        return size;
+    }
+
+    std::vector<Cell> cells_;
+    const size_t mask_;
+    // producers and consumers on separate cache lines
+    alignas(64) std::atomic<size_t> enqueuePos_;
+    alignas(64) std::atomic<size_t> dequeuePos_;
+};
+
+#endif //THETA_CLIENT_1_0_0_BOUNDEDQUEUE_H
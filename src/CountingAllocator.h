@@ -0,0 +1,64 @@
+//
+// Thread-safe allocator for the templated theta classes that reports every
+// allocation to AllocationStats. Each block carries its category in a small
+// header, so that it is credited back to the right category when freed from
+// another scope or thread.
+//
+
+#ifndef THETA_CLIENT_1_0_0_COUNTINGALLOCATOR_H
+#define THETA_CLIENT_1_0_0_COUNTINGALLOCATOR_H
+
+#include "AllocationStats.h"
+
+#include <cstdlib>
+#include <new>
+#include <theta_a_not_b.hpp>
+#include <theta_intersection.hpp>
+#include <theta_union.hpp>
+
+template<typename T>
+class CountingAllocator {
+public:
+    typedef T value_type;
+
+    CountingAllocator() {}
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        const size_t bytes = n * sizeof(T);
+        // char buffers are not only serialized sketches (packed keys are decoded
+        // through them too), so only the scope tells what a block is for
+        const AllocationCategory category = AllocationStats::current();
+        void *block = std::malloc(HEADER + bytes);
+        if (block == nullptr) throw std::bad_alloc();
+        *static_cast<AllocationCategory *>(block) = category;
+        AllocationStats::allocated(category, bytes);
+        return reinterpret_cast<T *>(static_cast<char *>(block) + HEADER);
+    }
+
+    void deallocate(T *p, size_t n) {
+        if (p == nullptr) return;
+        void *block = reinterpret_cast<char *>(p) - HEADER;
+        AllocationStats::deallocated(*static_cast<AllocationCategory *>(block), n * sizeof(T));
+        std::free(block);
+    }
+
+private:
+    // keeps the blocks aligned like malloc does
+    static const size_t HEADER = alignof(std::max_align_t);
+};
+
+template<typename T, typename U>
+bool operator==(const CountingAllocator<T> &, const CountingAllocator<U> &) { return true; }
+
+template<typename T, typename U>
+bool operator!=(const CountingAllocator<T> &, const CountingAllocator<U> &) { return false; }
+
+typedef datasketches::update_theta_sketch_alloc<CountingAllocator<void>> CountedUpdateSketch;
+typedef datasketches::compact_theta_sketch_alloc<CountingAllocator<void>> CountedCompactSketch;
+typedef datasketches::theta_intersection_alloc<CountingAllocator<void>> CountedIntersection;
+typedef datasketches::theta_union_alloc<CountingAllocator<void>> CountedUnion;
+typedef datasketches::theta_a_not_b_alloc<CountingAllocator<void>> CountedANotB;
+
+#endif //THETA_CLIENT_1_0_0_COUNTINGALLOCATOR_H
@@ -0,0 +1,83 @@
+//
+// Compares the throughput of SketchFromTextTest::fromHex with the HexDecoder kernels.
+//
+
+#include "HexDecodeBenchmark.h"
+#include "HexDecoder.h"
+#include "HexSketchReader.h"
+#include "SketchFromTextTest.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Line {
+    const char *data;
+    size_t length;
+};
+
+void report(const char *name, size_t bytes, double seconds) {
+    std::cout << name << ": " << (bytes / seconds / 1e6) << " MB/s of hex" << std::endl;
+}
+
+}
+
+void HexDecodeBenchmark::run(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <path to sketches.txt> [repetitions]" << std::endl;
+        return;
+    }
+    const int repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    HexSketchReader reader(argv[1]);
+    std::vector<Line> lines;
+    size_t total = 0;
+    size_t longest = 0;
+    const char *data;
+    size_t length;
+    while (reader.nextLine(data, length)) {
+        lines.push_back({data, length});
+        total += length;
+        if (length > longest) longest = length;
+    }
+    std::cout << "Lines: " << lines.size() << ", hex bytes: " << total << std::endl;
+
+    // reference output, one decoded line after another
+    std::vector<unsigned char> expected;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++) {
+        expected.clear();
+        for (const Line &line : lines) {
+            const std::string str(line.data, line.length);
+            std::vector<unsigned char> bytes(str.length() / 2);
+            SketchFromTextTest::fromHex(str, bytes.data());
+            expected.insert(expected.end(), bytes.begin(), bytes.end());
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    report("fromHex", total * repetitions, elapsed.count());
+
+    const HexDecoder::Kernel kernels[] = {HexDecoder::SCALAR, HexDecoder::SSE2, HexDecoder::AVX2};
+    std::vector<unsigned char> buffer(longest / 2);
+    for (HexDecoder::Kernel kernel : kernels) {
+        if (!HexDecoder::isSupported(kernel)) continue;
+        bool matches = true;
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; r++) {
+            size_t offset = 0;
+            for (const Line &line : lines) {
+                HexDecoder::decode(kernel, line.data, line.length, buffer.data());
+                if (r == 0) matches &= std::memcmp(buffer.data(), &expected[offset], line.length / 2) == 0;
+                offset += line.length / 2;
+            }
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+        report(HexDecoder::name(kernel), total * repetitions, elapsed.count());
+        if (!matches) std::cerr << HexDecoder::name(kernel) << ": output differs from fromHex" << std::endl;
+    }
+}
@@ -0,0 +1,13 @@
+//
+// Compares the throughput of SketchFromTextTest::fromHex with the HexDecoder kernels.
+//
+
+#ifndef THETA_CLIENT_1_0_0_HEXDECODEBENCHMARK_H
+#define THETA_CLIENT_1_0_0_HEXDECODEBENCHMARK_H
+
+class HexDecodeBenchmark {
+public:
+    void run(int argc, char **argv);
+};
+
+#endif //THETA_CLIENT_1_0_0_HEXDECODEBENCHMARK_H
@@ -0,0 +1,184 @@
+//
+// Hex text to bytes decoding with SIMD kernels (AVX2, SSE2) and a scalar fallback.
+//
+
+#include "HexDecoder.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HEX_DECODER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// value of each hex digit, -1 for anything else
+struct NibbleTable {
+    int8_t values[256];
+
+    NibbleTable() {
+        for (int i = 0; i < 256; i++) values[i] = -1;
+        for (int i = 0; i < 10; i++) values['0' + i] = static_cast<int8_t>(i);
+        for (int i = 0; i < 6; i++) {
+            values['a' + i] = static_cast<int8_t>(10 + i);
+            values['A' + i] = static_cast<int8_t>(10 + i);
+        }
+    }
+};
+
+const NibbleTable NIBBLES;
+
+void throwInvalid(const char *in, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (NIBBLES.values[static_cast<unsigned char>(in[i])] < 0) {
+            throw std::invalid_argument("invalid hex character at offset " + std::to_string(i));
+        }
+    }
+    throw std::invalid_argument("invalid hex input");
+}
+
+void decodeScalar(const char *in, size_t length, unsigned char *out) {
+    int bad = 0;
+    for (size_t i = 0; i < length; i += 2) {
+        const int hi = NIBBLES.values[static_cast<unsigned char>(in[i])];
+        const int lo = NIBBLES.values[static_cast<unsigned char>(in[i + 1])];
+        bad |= hi | lo;
+        *out++ = static_cast<unsigned char>((hi << 4) | lo);
+    }
+    if (bad < 0) throwInvalid(in, length);
+}
+
+#ifdef HEX_DECODER_X86
+
+// Each 16-bit lane of the nibble vector holds (hi | lo << 8) for one output byte.
+// Non-hex characters (including bytes >= 0x80, which compare as negative) set bits in 'bad'.
+
+inline __m128i nibblesSse2(__m128i c, __m128i &bad) {
+    const __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                        _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                        _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    bad = _mm_or_si128(bad, _mm_andnot_si128(_mm_or_si128(digit, alpha), _mm_set1_epi8(-1)));
+    return _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+                        _mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+}
+
+inline __m128i combineSse2(__m128i n) {
+    return _mm_or_si128(_mm_and_si128(_mm_slli_epi16(n, 4), _mm_set1_epi16(0x00f0)),
+                        _mm_srli_epi16(n, 8));
+}
+
+void decodeSse2(const char *in, size_t length, unsigned char *out) {
+    __m128i bad = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 16));
+        const __m128i bytes = _mm_packus_epi16(combineSse2(nibblesSse2(a, bad)),
+                                               combineSse2(nibblesSse2(b, bad)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i / 2), bytes);
+    }
+    if (_mm_movemask_epi8(bad) != 0) throwInvalid(in, length);
+    decodeScalar(in + i, length - i, out + i / 2);
+}
+
+__attribute__((target("avx2")))
+inline __m256i nibblesAvx2(__m256i c, __m256i &bad) {
+    const __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+    const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+    const __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+    bad = _mm256_or_si256(bad, _mm256_andnot_si256(_mm256_or_si256(digit, alpha), _mm256_set1_epi8(-1)));
+    return _mm256_or_si256(_mm256_and_si256(digit, _mm256_sub_epi8(c, _mm256_set1_epi8('0'))),
+                           _mm256_and_si256(alpha, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+}
+
+__attribute__((target("avx2")))
+inline __m256i combineAvx2(__m256i n) {
+    return _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(n, 4), _mm256_set1_epi16(0x00f0)),
+                           _mm256_srli_epi16(n, 8));
+}
+
+__attribute__((target("avx2")))
+void decodeAvx2(const char *in, size_t length, unsigned char *out) {
+    __m256i bad = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i + 32));
+        // packus works within 128-bit lanes, restore the order of the 64-bit quarters
+        const __m256i bytes = _mm256_permute4x64_epi64(
+                _mm256_packus_epi16(combineAvx2(nibblesAvx2(a, bad)), combineAvx2(nibblesAvx2(b, bad))),
+                0xd8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i / 2), bytes);
+    }
+    if (_mm256_movemask_epi8(bad) != 0) throwInvalid(in, length);
+    decodeSse2(in + i, length - i, out + i / 2);
+}
+
+#endif // HEX_DECODER_X86
+
+} // namespace
+
+void HexDecoder::decode(const char *in, size_t length, unsigned char *out) {
+    static const Kernel kernel = bestKernel();
+    decode(kernel, in, length, out);
+}
+
+void HexDecoder::decode(Kernel kernel, const char *in, size_t length, unsigned char *out) {
+    if (length % 2 != 0) {
+        throw std::invalid_argument("hex input has odd length " + std::to_string(length));
+    }
+    if (!isSupported(kernel)) {
+        throw std::invalid_argument(std::string("hex kernel not supported on this CPU: ") + name(kernel));
+    }
+    switch (kernel) {
+#ifdef HEX_DECODER_X86
+        case AVX2:
+            decodeAvx2(in, length, out);
+            return;
+        case SSE2:
+            decodeSse2(in, length, out);
+            return;
+#endif
+        default:
+            decodeScalar(in, length, out);
+    }
+}
+
+bool HexDecoder::isSupported(Kernel kernel) {
+    switch (kernel) {
+#ifdef HEX_DECODER_X86
+        case AVX2:
+            return __builtin_cpu_supports("avx2");
+        case SSE2:
+            return __builtin_cpu_supports("sse2");
+#endif
+        case SCALAR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+HexDecoder::Kernel HexDecoder::bestKernel() {
+    if (isSupported(AVX2)) return AVX2;
+    if (isSupported(SSE2)) return SSE2;
+    return SCALAR;
+}
+
+const char *HexDecoder::name(Kernel kernel) {
+    switch (kernel) {
+        case AVX2:
+            return "avx2";
+        case SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
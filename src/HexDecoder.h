@@ -0,0 +1,25 @@
+//
+// Hex text to bytes decoding with SIMD kernels (AVX2, SSE2) and a scalar fallback.
+//
+
+#ifndef THETA_CLIENT_1_0_0_HEXDECODER_H
+#define THETA_CLIENT_1_0_0_HEXDECODER_H
+
+#include <cstddef>
+
+class HexDecoder {
+public:
+    enum Kernel { SCALAR, SSE2, AVX2 };
+
+    // Decodes length hex digits (upper or lower case) into length / 2 bytes
+    // using the best kernel supported by the running CPU.
+    // Throws std::invalid_argument on odd length or on a non-hex character.
+    static void decode(const char *in, size_t length, unsigned char *out);
+    static void decode(Kernel kernel, const char *in, size_t length, unsigned char *out);
+
+    static bool isSupported(Kernel kernel);
+    static Kernel bestKernel();
+    static const char *name(Kernel kernel);
+};
+
+#endif //THETA_CLIENT_1_0_0_HEXDECODER_H
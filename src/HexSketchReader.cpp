@@ -0,0 +1,58 @@
+//
+// Iterates the sketches of a hex text dump (one serialized sketch per line,
+// as produced by thirdparty/parquet/extract.py) over a memory mapping.
+//
+
+#include "HexSketchReader.h"
+#include "HexDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+HexSketchReader::HexSketchReader(const std::string &path) :
+        file_(new MappedFile(path)), data_(file_->data()), size_(file_->size()), offset_(0) {}
+
+HexSketchReader::HexSketchReader(const char *data, size_t size) : data_(data), size_(size), offset_(0) {}
+
+std::vector<size_t> HexSketchReader::split(const char *data, size_t size, size_t parts) {
+    std::vector<size_t> bounds(1, 0);
+    for (size_t i = 1; i < parts; i++) {
+        size_t offset = std::max(bounds.back(), size * i / parts);
+        if (offset == 0 || offset >= size) continue;
+        const void *newline = std::memchr(data + offset - 1, '\n', size - offset + 1);
+        if (newline == nullptr) break;
+        offset = static_cast<const char *>(newline) - data + 1;
+        if (offset > bounds.back() && offset < size) bounds.push_back(offset);
+    }
+    bounds.push_back(size);
+    return bounds;
+}
+
+bool HexSketchReader::nextLine(const char *&line, size_t &length) {
+    const char *data = data_;
+    const size_t size = size_;
+    while (offset_ < size) {
+        const char *start = data + offset_;
+        const char *newline = static_cast<const char *>(std::memchr(start, '\n', size - offset_));
+        const char *end = newline != nullptr ? newline : data + size;
+        offset_ = (end - data) + (newline != nullptr ? 1 : 0);
+        if (end > start && end[-1] == '\r') --end;
+        if (end > start) {
+            line = start;
+            length = end - start;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HexSketchReader::next(const unsigned char *&bytes, size_t &size) {
+    const char *line;
+    size_t length;
+    if (!nextLine(line, length)) return false;
+    size = length / 2;
+    if (buffer_.size() < size) buffer_.resize(size);
+    HexDecoder::decode(line, length, buffer_.data());
+    bytes = buffer_.data();
+    return true;
+}
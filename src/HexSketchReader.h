@@ -0,0 +1,41 @@
+//
+// Iterates the sketches of a hex text dump (one serialized sketch per line,
+// as produced by thirdparty/parquet/extract.py) over a memory mapping.
+//
+
+#ifndef THETA_CLIENT_1_0_0_HEXSKETCHREADER_H
+#define THETA_CLIENT_1_0_0_HEXSKETCHREADER_H
+
+#include "MappedFile.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class HexSketchReader {
+public:
+    explicit HexSketchReader(const std::string &path);
+    // reads the lines of [data, data + size), which the caller keeps mapped
+    HexSketchReader(const char *data, size_t size);
+
+    // Decodes the next non-empty line into an internal buffer that is reused
+    // between calls. The returned span is valid until the next call.
+    // Returns false at the end of the file.
+    bool next(const unsigned char *&bytes, size_t &size);
+
+    // Returns the next non-empty line without decoding it
+    bool nextLine(const char *&line, size_t &length);
+
+    // Splits [data, data + size) into at most 'parts' ranges that start at line
+    // boundaries; returns the start offsets followed by 'size'
+    static std::vector<size_t> split(const char *data, size_t size, size_t parts);
+
+private:
+    std::unique_ptr<MappedFile> file_;
+    const char *data_;
+    size_t size_;
+    size_t offset_;
+    std::vector<unsigned char> buffer_;
+};
+
+#endif //THETA_CLIENT_1_0_0_HEXSKETCHREADER_H
@@ -0,0 +1,41 @@
+//
+// Read-only memory mapping of a whole file.
+//
+
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path, Access access) : data_(nullptr), size_(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot stat " + path + ": " + std::strerror(errno));
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("cannot mmap " + path + ": " + std::strerror(errno));
+        }
+        // dumps are consumed front to back exactly once, archives are also read by index
+        madvise(addr, size_, access == SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+        data_ = static_cast<const char *>(addr);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) munmap(const_cast<char *>(data_), size_);
+}
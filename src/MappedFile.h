@@ -0,0 +1,30 @@
+//
+// Read-only memory mapping of a whole file.
+//
+
+#ifndef THETA_CLIENT_1_0_0_MAPPEDFILE_H
+#define THETA_CLIENT_1_0_0_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+class MappedFile {
+public:
+    // tells the kernel how the mapping is going to be read
+    enum Access { SEQUENTIAL, RANDOM };
+
+    explicit MappedFile(const std::string &path, Access access = SEQUENTIAL);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char *data_;
+    size_t size_;
+};
+
+#endif //THETA_CLIENT_1_0_0_MAPPEDFILE_H
@@ -4,34 +4,105 @@
 
 #include "MemoryGenerationTest.h"
 #include "common.h"
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
-#include <random>
-#include <theta_intersection.hpp>
 
 using namespace datasketches;
 
 void MemoryGenerationTest::run() {
-    auto intersection = theta_intersection(SEED_DEFAULT);
-    for (int i = 0; i < 10; i++) {
-        auto sketch = this->make_update_sketch();
-        auto ser = sketch.compact().serialize();
-        auto second_sketch = compact_theta_sketch::deserialize(ser.first.get(),
-                                                               ser.second,
-                                                               SEED_DEFAULT);
-        intersection.update(second_sketch);
+    // about as many distinct keys per sketch as 999999 draws out of 999999 values
+    WorkloadGenerator::Config config;
+    config.sketches = 10;
+    config.coreKeys = 400000;
+    config.pairwiseKeys = 0;
+    config.uniqueKeys = 232000;
+    config.lgK = LOGK_DEFAULT;
+    config.seed = 0;
+    const WorkloadGenerator generator(config);
+
+    auto intersection = CountedIntersection(SEED_DEFAULT);
+    for (uint32_t i = 0; i < config.sketches; i++) {
+        auto sketch = measure("generate", AllocationCategory::TABLE, [this, &generator, i]() {
+            return this->make_update_sketch(generator, i);
+        });
+        auto compact = measure("compact", AllocationCategory::COMPACT_KEYS, [&sketch]() {
+            return sketch.compact();
+        });
+        auto ser = measure("serialize", AllocationCategory::SERIALIZED, [&compact]() {
+            return compact.serialize();
+        });
+        auto second_sketch = measure("deserialize", AllocationCategory::COMPACT_KEYS, [&ser]() {
+            return CountedCompactSketch::deserialize(ser.first.get(), ser.second, SEED_DEFAULT);
+        });
+        measure("intersect", AllocationCategory::INTERSECTION_SCRATCH, [&intersection, &second_sketch]() {
+            intersection.update(second_sketch);
+            return 0;
+        });
     }
 
-    std::cout << "Done: " << intersection.get_result().get_estimate() << std::endl;
+    auto result = measure("result", AllocationCategory::COMPACT_KEYS, [&intersection]() {
+        return intersection.get_result();
+    });
+    std::cout << "Done: " << result.get_estimate() << " (exact " << generator.intersection() << ")" << std::endl;
+    report();
+}
+
+CountedUpdateSketch MemoryGenerationTest::make_update_sketch(const WorkloadGenerator &generator, uint32_t index) {
+    auto sketch = CountedUpdateSketch::builder().set_lg_k(generator.config().lgK).set_seed(SEED_DEFAULT).build();
+    generator.forEachKey(index, [&sketch](uint64_t key) { sketch.update(key); });
+    return sketch;
 }
 
-update_theta_sketch MemoryGenerationTest::make_update_sketch() {
-    auto sketch = update_theta_sketch::builder().set_lg_k(LOGK_DEFAULT).set_seed(SEED_DEFAULT).build();
-    std::random_device dev;
-    std::mt19937 rng(dev());
-    std::uniform_int_distribution<std::mt19937::result_type> dist(1, 999999);
+// Runs f with its allocations attributed to category and adds what it
+// allocated to the totals of phase. Live bytes are taken at the end of the
+// phase, the peak is the highest seen over the iterations.
+template<typename F>
+auto MemoryGenerationTest::measure(const char *phase, AllocationCategory category, F f) -> decltype(f()) {
+    auto it = std::find_if(phases_.begin(), phases_.end(), [phase](const Phase &p) { return p.name == phase; });
+    if (it == phases_.end()) {
+        phases_.push_back(Phase());
+        phases_.back().name = phase;
+        it = phases_.end() - 1;
+    }
+    Phase &totals = *it;
 
-    for (uint64_t i = 0; i < 999999LL; i++) {
-        sketch.update(dist(rng));
+    AllocationStats::resetPeaks();
+    const AllocationStats::Snapshot before = AllocationStats::snapshot();
+    AllocationScope scope(category);
+    auto result = f();
+    const AllocationStats::Snapshot after = AllocationStats::snapshot();
+    for (int i = 0; i < AllocationStats::CATEGORIES; i++) {
+        accumulate(totals.categories[i], before.categories[i], after.categories[i]);
+    }
+    accumulate(totals.total, before.total, after.total);
+    return result;
+}
+
+void MemoryGenerationTest::accumulate(AllocationStats::Counters &totals, const AllocationStats::Counters &before,
+                                      const AllocationStats::Counters &after) {
+    totals.allocations += after.allocations - before.allocations;
+    totals.allocatedBytes += after.allocatedBytes - before.allocatedBytes;
+    totals.liveBytes = after.liveBytes;
+    totals.peakBytes = std::max(totals.peakBytes, after.peakBytes);
+}
+
+void MemoryGenerationTest::report() const {
+    std::cout << std::left << std::setw(12) << "phase" << std::setw(22) << "category" << std::right
+              << std::setw(12) << "allocations" << std::setw(14) << "allocated" << std::setw(14) << "live"
+              << std::setw(14) << "peak" << std::endl;
+    auto row = [](const std::string &phase, const char *category, const AllocationStats::Counters &c) {
+        std::cout << std::left << std::setw(12) << phase << std::setw(22) << category << std::right
+                  << std::setw(12) << c.allocations << std::setw(14) << c.allocatedBytes
+                  << std::setw(14) << c.liveBytes << std::setw(14) << c.peakBytes << std::endl;
+    };
+    // categories the phase did not allocate from are left out, the total
+    // row has the live and peak bytes of all categories together
+    for (const Phase &phase : phases_) {
+        for (int i = 0; i < AllocationStats::CATEGORIES; i++) {
+            if (phase.categories[i].allocations == 0) continue;
+            row(phase.name, AllocationStats::name(static_cast<AllocationCategory>(i)), phase.categories[i]);
+        }
+        row(phase.name, "total", phase.total);
     }
-    return sketch;
 }
@@ -5,13 +5,33 @@
 #ifndef THETA_CLIENT_1_0_0_MEMORYGENERATIONTEST_H
 #define THETA_CLIENT_1_0_0_MEMORYGENERATIONTEST_H
 
-#include <theta_sketch.hpp>
+#include "AllocationStats.h"
+#include "CountingAllocator.h"
+#include "WorkloadGenerator.h"
+
+#include <string>
+#include <vector>
 
 class MemoryGenerationTest {
 public:
     void run();
 private:
-    datasketches::update_theta_sketch make_update_sketch();
+    // allocations of one phase, summed over the iterations
+    struct Phase {
+        std::string name;
+        AllocationStats::Counters categories[AllocationStats::CATEGORIES];
+        AllocationStats::Counters total;
+    };
+
+    std::vector<Phase> phases_;
+
+    CountedUpdateSketch make_update_sketch(const WorkloadGenerator &generator, uint32_t index);
+
+    template<typename F>
+    auto measure(const char *phase, AllocationCategory category, F f) -> decltype(f());
+    static void accumulate(AllocationStats::Counters &totals, const AllocationStats::Counters &before,
+                           const AllocationStats::Counters &after);
+    void report() const;
 };
 
 
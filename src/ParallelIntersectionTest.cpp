@@ -0,0 +1,107 @@
+//
+// Intersects a hex text dump with one theta_intersection per worker thread,
+// each over its own chunk of lines, then intersects the partial results.
+//
+
+#include "ParallelIntersectionTest.h"
+#include "HexSketchReader.h"
+#include "common.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <theta_intersection.hpp>
+
+using namespace datasketches;
+
+namespace {
+
+void intersectLines(HexSketchReader &reader, theta_intersection &intersection) {
+    const unsigned char *bytes;
+    size_t size;
+    while (reader.next(bytes, size)) {
+        intersection.update(bytes, size);
+    }
+}
+
+bool sameBytes(const compact_theta_sketch &a, const compact_theta_sketch &b) {
+    const auto serializedA = a.serialize();
+    const auto serializedB = b.serialize();
+    return serializedA.second == serializedB.second &&
+           std::memcmp(serializedA.first.get(), serializedB.first.get(), serializedA.second) == 0;
+}
+
+}
+
+compact_theta_sketch ParallelIntersectionTest::intersectSerial(const std::string &path) {
+    auto intersection = theta_intersection(SEED_DEFAULT);
+    HexSketchReader reader(path);
+    intersectLines(reader, intersection);
+    if (!intersection.has_result()) throw std::runtime_error("no sketches in " + path);
+    return intersection.get_result();
+}
+
+compact_theta_sketch ParallelIntersectionTest::intersectParallel(const std::string &path, unsigned threads) {
+    MappedFile file(path);
+    const std::vector<size_t> bounds = HexSketchReader::split(file.data(), file.size(), threads);
+    const size_t chunks = bounds.size() - 1;
+
+    std::vector<theta_intersection> partials(chunks, theta_intersection(SEED_DEFAULT));
+    std::vector<std::exception_ptr> errors(chunks);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < chunks; i++) {
+        workers.emplace_back([&, i]() {
+            try {
+                HexSketchReader reader(file.data() + bounds[i], bounds[i + 1] - bounds[i]);
+                intersectLines(reader, partials[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto &worker : workers) worker.join();
+    for (auto &error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+
+    // intersection is associative; combining in chunk order keeps the state
+    // transitions of the serial driver, including when the result turns empty
+    auto intersection = theta_intersection(SEED_DEFAULT);
+    for (const auto &partial : partials) {
+        if (partial.has_result()) intersection.update(partial.get_result());
+    }
+    if (!intersection.has_result()) throw std::runtime_error("no sketches in " + path);
+    return intersection.get_result();
+}
+
+void ParallelIntersectionTest::run(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <path to sketches.txt> [threads, default all cores] [verify]" << std::endl;
+        return;
+    }
+    unsigned threads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    const bool verify = argc > 3 && std::string(argv[3]) == "verify";
+
+    auto start = std::chrono::steady_clock::now();
+    const compact_theta_sketch result = intersectParallel(argv[1], threads);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Parallel (" << threads << " threads): " << (elapsed.count() * 1e3) << " ms" << std::endl;
+
+    if (verify) {
+        start = std::chrono::steady_clock::now();
+        const compact_theta_sketch serial = intersectSerial(argv[1]);
+        elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Serial: " << (elapsed.count() * 1e3) << " ms" << std::endl;
+        if (!sameBytes(result, serial)) {
+            std::cerr << "parallel result differs from the serial one" << std::endl;
+        }
+    }
+
+    std::cout << "Done: " << result.get_estimate() << std::endl;
+}
@@ -0,0 +1,21 @@
+//
+// Intersects a hex text dump with one theta_intersection per worker thread,
+// each over its own chunk of lines, then intersects the partial results.
+//
+
+#ifndef THETA_CLIENT_1_0_0_PARALLELINTERSECTIONTEST_H
+#define THETA_CLIENT_1_0_0_PARALLELINTERSECTIONTEST_H
+
+#include <theta_sketch.hpp>
+
+#include <string>
+
+class ParallelIntersectionTest {
+public:
+    void run(int argc, char **argv);
+
+    static datasketches::compact_theta_sketch intersectSerial(const std::string &path);
+    static datasketches::compact_theta_sketch intersectParallel(const std::string &path, unsigned threads);
+};
+
+#endif //THETA_CLIENT_1_0_0_PARALLELINTERSECTIONTEST_H
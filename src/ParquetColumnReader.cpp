@@ -0,0 +1,575 @@
+//
+// Reads one BYTE_ARRAY column of a local Parquet file page by page, handing out
+// the raw values without any text conversion.
+//
+
+#include "ParquetColumnReader.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef THETA_CLIENT_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+// parquet.thrift enums, only the values used here
+enum Type { BYTE_ARRAY = 6 };
+enum Repetition { REQUIRED = 0, OPTIONAL = 1 };
+enum Codec { UNCOMPRESSED = 0, SNAPPY = 1, GZIP = 2 };
+enum PageType { DATA_PAGE = 0, DICTIONARY_PAGE = 2, DATA_PAGE_V2 = 3 };
+enum Encoding { PLAIN = 0, PLAIN_DICTIONARY = 2, RLE = 3, RLE_DICTIONARY = 8 };
+
+const char MAGIC[] = "PAR1";
+
+void corrupted(const std::string &what) {
+    throw std::runtime_error("corrupted parquet file: " + what);
+}
+
+uint32_t readLe32(const unsigned char *p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Thrift compact protocol, just enough to walk the footer and the page headers
+class ThriftReader {
+public:
+    enum FieldType {
+        STOP = 0, BOOL_TRUE = 1, BOOL_FALSE = 2, BYTE = 3, I16 = 4, I32 = 5, I64 = 6,
+        DOUBLE = 7, BINARY = 8, LIST = 9, SET = 10, MAP = 11, STRUCT = 12
+    };
+
+    ThriftReader(const unsigned char *data, size_t size) : pos_(data), end_(data + size), bool_(false) {}
+
+    const unsigned char *position() const { return pos_; }
+
+    uint8_t byte() {
+        if (pos_ >= end_) corrupted("truncated thrift data");
+        return *pos_++;
+    }
+
+    uint64_t varint() {
+        uint64_t result = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t b = byte();
+            result |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) return result;
+        }
+        corrupted("varint too long");
+        return 0;
+    }
+
+    int64_t i64() {
+        const uint64_t n = varint();
+        return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1);
+    }
+
+    int32_t i32() { return static_cast<int32_t>(i64()); }
+
+    // value of the last boolean struct field, which is carried by its type
+    bool boolean() const { return bool_; }
+
+    std::string string() {
+        const uint64_t length = varint();
+        if (length > static_cast<uint64_t>(end_ - pos_)) corrupted("truncated thrift string");
+        std::string result(reinterpret_cast<const char *>(pos_), length);
+        pos_ += length;
+        return result;
+    }
+
+    // Calls onField(id, type) for each field; it returns false for fields it did not read
+    template<typename F>
+    void readStruct(F onField) {
+        int16_t lastId = 0;
+        for (;;) {
+            const uint8_t header = byte();
+            const uint8_t type = header & 0x0f;
+            if (type == STOP) return;
+            const int16_t delta = header >> 4;
+            const int16_t id = delta != 0 ? static_cast<int16_t>(lastId + delta) : static_cast<int16_t>(i64());
+            lastId = id;
+            bool_ = type == BOOL_TRUE;
+            if (!onField(id, type)) skip(type, false);
+        }
+    }
+
+    // Calls onElement(type) for each element; it returns false for elements it did not read
+    template<typename F>
+    void readList(F onElement) {
+        const uint8_t header = byte();
+        const uint8_t type = header & 0x0f;
+        uint64_t size = header >> 4;
+        if (size == 15) size = varint();
+        for (uint64_t i = 0; i < size; i++) {
+            if (!onElement(type)) skip(type, true);
+        }
+    }
+
+    void skip(uint8_t type, bool inList) {
+        switch (type) {
+            case BOOL_TRUE:
+            case BOOL_FALSE:
+                if (inList) byte(); // struct fields carry the value in the type
+                return;
+            case BYTE:
+                byte();
+                return;
+            case I16:
+            case I32:
+            case I64:
+                varint();
+                return;
+            case DOUBLE:
+                for (int i = 0; i < 8; i++) byte();
+                return;
+            case BINARY: {
+                const uint64_t length = varint();
+                if (length > static_cast<uint64_t>(end_ - pos_)) corrupted("truncated thrift binary");
+                pos_ += length;
+                return;
+            }
+            case LIST:
+            case SET:
+                readList([this](uint8_t elementType) { skip(elementType, true); return true; });
+                return;
+            case MAP: {
+                const uint64_t size = varint();
+                if (size == 0) return;
+                const uint8_t types = byte();
+                for (uint64_t i = 0; i < size; i++) {
+                    skip(types >> 4, true);
+                    skip(types & 0x0f, true);
+                }
+                return;
+            }
+            case STRUCT:
+                readStruct([](int16_t, uint8_t) { return false; });
+                return;
+            default:
+                corrupted("unknown thrift type " + std::to_string(type));
+        }
+    }
+
+private:
+    const unsigned char *pos_;
+    const unsigned char *end_;
+    bool bool_;
+};
+
+void snappyUncompress(const unsigned char *in, size_t size, unsigned char *out, size_t outSize) {
+    const unsigned char *end = in + size;
+    ThriftReader lengthReader(in, size); // same varint encoding
+    if (lengthReader.varint() != outSize) corrupted("snappy length mismatch");
+    in = lengthReader.position();
+    size_t written = 0;
+    while (in < end) {
+        const uint8_t tag = *in++;
+        size_t length;
+        size_t offset = 0;
+        switch (tag & 3) {
+            case 0: // literal
+                length = tag >> 2;
+                if (length >= 60) {
+                    const size_t lengthBytes = length - 59;
+                    if (static_cast<size_t>(end - in) < lengthBytes) corrupted("truncated snappy literal");
+                    length = 0;
+                    for (size_t i = 0; i < lengthBytes; i++) length |= static_cast<size_t>(in[i]) << (8 * i);
+                    in += lengthBytes;
+                }
+                length += 1;
+                if (static_cast<size_t>(end - in) < length || outSize - written < length) {
+                    corrupted("snappy literal out of bounds");
+                }
+                std::memcpy(out + written, in, length);
+                in += length;
+                written += length;
+                continue;
+            case 1:
+                if (end - in < 1) corrupted("truncated snappy copy");
+                length = 4 + ((tag >> 2) & 7);
+                offset = (static_cast<size_t>(tag >> 5) << 8) | in[0];
+                in += 1;
+                break;
+            case 2:
+                if (end - in < 2) corrupted("truncated snappy copy");
+                length = (tag >> 2) + 1;
+                offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+                in += 2;
+                break;
+            default:
+                if (end - in < 4) corrupted("truncated snappy copy");
+                length = (tag >> 2) + 1;
+                offset = readLe32(in);
+                in += 4;
+        }
+        if (offset == 0 || offset > written || outSize - written < length) corrupted("snappy copy out of bounds");
+        // the source may overlap the destination, copy forward byte by byte
+        for (size_t i = 0; i < length; i++, written++) out[written] = out[written - offset];
+    }
+    if (written != outSize) corrupted("snappy output too short");
+}
+
+// RLE / bit-packed hybrid encoding of definition levels and dictionary indices
+template<typename T>
+void decodeHybrid(const unsigned char *data, size_t size, int bitWidth, size_t count, std::vector<T> &out) {
+    out.clear();
+    out.reserve(count);
+    ThriftReader reader(data, size); // same varint encoding for run headers
+    const size_t valueBytes = (bitWidth + 7) / 8;
+    while (out.size() < count) {
+        const uint64_t header = reader.varint();
+        if (header & 1) { // bit-packed groups of 8 values
+            const size_t numValues = (header >> 1) * 8;
+            uint64_t buffer = 0;
+            int bits = 0;
+            for (size_t i = 0; i < numValues; i++) {
+                while (bits < bitWidth) {
+                    buffer |= static_cast<uint64_t>(reader.byte()) << bits;
+                    bits += 8;
+                }
+                if (out.size() < count) out.push_back(static_cast<T>(buffer & ((1ULL << bitWidth) - 1)));
+                buffer >>= bitWidth;
+                bits -= bitWidth;
+            }
+        } else { // run of one repeated value
+            const size_t runLength = header >> 1;
+            uint32_t value = 0;
+            for (size_t i = 0; i < valueBytes; i++) value |= static_cast<uint32_t>(reader.byte()) << (8 * i);
+            if (runLength > count - out.size()) corrupted("RLE run too long");
+            out.insert(out.end(), runLength, static_cast<T>(value));
+        }
+    }
+}
+
+} // namespace
+
+ParquetColumnReader::ParquetColumnReader(const std::string &path, const std::string &column) :
+        file_(path),
+        numRows_(0),
+        optional_(false),
+        chunkIndex_(0),
+        pageOffset_(0),
+        chunkEnd_(0),
+        chunkValuesLeft_(0),
+        values_(nullptr),
+        valuesEnd_(nullptr),
+        pageValues_(0),
+        pageIndex_(0),
+        dictionaryEncoded_(false),
+        nonNullIndex_(0) {
+    readFooter(column);
+    if (!chunks_.empty()) {
+        pageOffset_ = chunks_[0].offset;
+        chunkEnd_ = chunks_[0].offset + chunks_[0].size;
+        chunkValuesLeft_ = chunks_[0].numValues;
+    }
+}
+
+void ParquetColumnReader::readFooter(const std::string &column) {
+    const auto *data = reinterpret_cast<const unsigned char *>(file_.data());
+    const size_t size = file_.size();
+    if (size < 12 || std::memcmp(data, MAGIC, 4) != 0 || std::memcmp(data + size - 4, MAGIC, 4) != 0) {
+        corrupted("missing PAR1 magic");
+    }
+    const uint32_t footerLength = readLe32(data + size - 8);
+    if (footerLength > size - 12) corrupted("footer length " + std::to_string(footerLength));
+
+    bool found = false;
+    ThriftReader reader(data + size - 8 - footerLength, footerLength);
+    reader.readStruct([&](int16_t id, uint8_t) {
+        switch (id) {
+            case 2: // schema, flattened depth first; the first element is the root
+                reader.readList([&](uint8_t) {
+                    std::string name;
+                    int32_t type = -1;
+                    int32_t repetition = REQUIRED;
+                    int32_t children = 0;
+                    reader.readStruct([&](int16_t field, uint8_t) {
+                        if (field == 1) type = reader.i32();
+                        else if (field == 3) repetition = reader.i32();
+                        else if (field == 4) name = reader.string();
+                        else if (field == 5) children = reader.i32();
+                        else return false;
+                        return true;
+                    });
+                    // nested columns have a dotted path and never match a plain name
+                    if (name == column && children == 0 && !found) {
+                        if (type != BYTE_ARRAY) throw std::runtime_error("column " + column + " is not BYTE_ARRAY");
+                        if (repetition != REQUIRED && repetition != OPTIONAL) {
+                            throw std::runtime_error("repeated column " + column + " is not supported");
+                        }
+                        optional_ = repetition == OPTIONAL;
+                        found = true;
+                    }
+                    return true;
+                });
+                return true;
+            case 3:
+                numRows_ = reader.i64();
+                return true;
+            case 4: // row groups
+                reader.readList([&](uint8_t) {
+                    reader.readStruct([&](int16_t field, uint8_t) {
+                        if (field != 1) return false;
+                        reader.readList([&](uint8_t) { // column chunks
+                            Chunk chunk = {0, 0, 0, UNCOMPRESSED};
+                            bool matches = false;
+                            int64_t dataPageOffset = 0;
+                            int64_t dictionaryPageOffset = 0;
+                            reader.readStruct([&](int16_t chunkField, uint8_t) {
+                                if (chunkField == 1) throw std::runtime_error("external column chunks are not supported");
+                                if (chunkField != 3) return false;
+                                reader.readStruct([&](int16_t metaField, uint8_t) {
+                                    switch (metaField) {
+                                        case 3: {
+                                            std::vector<std::string> path;
+                                            reader.readList([&](uint8_t) {
+                                                path.push_back(reader.string());
+                                                return true;
+                                            });
+                                            matches = path.size() == 1 && path[0] == column;
+                                            return true;
+                                        }
+                                        case 4:
+                                            chunk.codec = reader.i32();
+                                            return true;
+                                        case 5:
+                                            chunk.numValues = reader.i64();
+                                            return true;
+                                        case 7:
+                                            chunk.size = reader.i64();
+                                            return true;
+                                        case 9:
+                                            dataPageOffset = reader.i64();
+                                            return true;
+                                        case 11:
+                                            dictionaryPageOffset = reader.i64();
+                                            return true;
+                                        default:
+                                            return false;
+                                    }
+                                });
+                                return true;
+                            });
+                            if (matches) {
+                                chunk.offset = dictionaryPageOffset > 0 && dictionaryPageOffset < dataPageOffset
+                                               ? dictionaryPageOffset : dataPageOffset;
+                                if (chunk.offset < 4 || chunk.size < 0 ||
+                                    static_cast<uint64_t>(chunk.offset + chunk.size) > size - 8 - footerLength) {
+                                    corrupted("column chunk out of bounds");
+                                }
+                                chunks_.push_back(chunk);
+                            }
+                            return true;
+                        });
+                        return true;
+                    });
+                    return true;
+                });
+                return true;
+            default:
+                return false;
+        }
+    });
+    if (!found) throw std::runtime_error("column " + column + " not found");
+}
+
+const unsigned char *ParquetColumnReader::decompress(int32_t codec, const unsigned char *data, size_t size,
+                                                     size_t uncompressedSize, std::vector<unsigned char> &buffer) {
+    if (codec == UNCOMPRESSED) {
+        if (size != uncompressedSize) corrupted("uncompressed page size");
+        return data;
+    }
+    if (buffer.size() < uncompressedSize) buffer.resize(uncompressedSize);
+    if (codec == SNAPPY) {
+        snappyUncompress(data, size, buffer.data(), uncompressedSize);
+        return buffer.data();
+    }
+#ifdef THETA_CLIENT_WITH_ZLIB
+    if (codec == GZIP) {
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) throw std::runtime_error("inflateInit2 failed");
+        stream.next_in = const_cast<unsigned char *>(data);
+        stream.avail_in = static_cast<uInt>(size);
+        stream.next_out = buffer.data();
+        stream.avail_out = static_cast<uInt>(uncompressedSize);
+        const int status = inflate(&stream, Z_FINISH);
+        inflateEnd(&stream);
+        if (status != Z_STREAM_END || stream.total_out != uncompressedSize) corrupted("gzip page");
+        return buffer.data();
+    }
+#endif
+    throw std::runtime_error("unsupported parquet compression codec " + std::to_string(codec));
+}
+
+void ParquetColumnReader::readDictionary(const unsigned char *data, size_t size, int32_t numValues) {
+    dictionary_.clear();
+    const unsigned char *end = data + size;
+    for (int32_t i = 0; i < numValues; i++) {
+        if (end - data < 4) corrupted("truncated dictionary");
+        const uint32_t length = readLe32(data);
+        if (static_cast<size_t>(end - data - 4) < length) corrupted("truncated dictionary value");
+        dictionary_.push_back({data + 4, length});
+        data += 4 + length;
+    }
+}
+
+bool ParquetColumnReader::nextPage() {
+    const auto *file = reinterpret_cast<const unsigned char *>(file_.data());
+    for (;;) {
+        if (chunkValuesLeft_ <= 0 || pageOffset_ >= chunkEnd_) {
+            if (++chunkIndex_ >= chunks_.size()) return false;
+            const Chunk &chunk = chunks_[chunkIndex_];
+            pageOffset_ = chunk.offset;
+            chunkEnd_ = chunk.offset + chunk.size;
+            chunkValuesLeft_ = chunk.numValues;
+            dictionary_.clear();
+            continue;
+        }
+        const int32_t codec = chunks_[chunkIndex_].codec;
+
+        int32_t pageType = -1;
+        int32_t uncompressedSize = 0;
+        int32_t compressedSize = 0;
+        int32_t numValues = 0;
+        int32_t encoding = PLAIN;
+        int32_t defLevelsEncoding = RLE;
+        int32_t defLevelsLength = 0;
+        int32_t repLevelsLength = 0;
+        bool isCompressed = true;
+        ThriftReader reader(file + pageOffset_, chunkEnd_ - pageOffset_);
+        reader.readStruct([&](int16_t id, uint8_t) {
+            switch (id) {
+                case 1:
+                    pageType = reader.i32();
+                    return true;
+                case 2:
+                    uncompressedSize = reader.i32();
+                    return true;
+                case 3:
+                    compressedSize = reader.i32();
+                    return true;
+                case 5: // data page header
+                case 7: // dictionary page header
+                    reader.readStruct([&](int16_t field, uint8_t) {
+                        if (field == 1) numValues = reader.i32();
+                        else if (field == 2) encoding = reader.i32();
+                        else if (field == 3 && id == 5) defLevelsEncoding = reader.i32();
+                        else return false;
+                        return true;
+                    });
+                    return true;
+                case 8: // data page header v2
+                    reader.readStruct([&](int16_t field, uint8_t) {
+                        if (field == 1) numValues = reader.i32();
+                        else if (field == 4) encoding = reader.i32();
+                        else if (field == 5) defLevelsLength = reader.i32();
+                        else if (field == 6) repLevelsLength = reader.i32();
+                        else if (field == 7) isCompressed = reader.boolean();
+                        else return false;
+                        return true;
+                    });
+                    return true;
+                default:
+                    return false;
+            }
+        });
+        const unsigned char *page = reader.position();
+        if (compressedSize < 0 || uncompressedSize < 0 || compressedSize > file + chunkEnd_ - page) {
+            corrupted("page out of bounds");
+        }
+        pageOffset_ = (page - file) + compressedSize;
+
+        if (pageType == DICTIONARY_PAGE) {
+            const unsigned char *plain = decompress(codec, page, compressedSize, uncompressedSize, dictionaryBuffer_);
+            readDictionary(plain, uncompressedSize, numValues);
+            continue;
+        }
+        if (pageType != DATA_PAGE && pageType != DATA_PAGE_V2) continue; // index pages
+        chunkValuesLeft_ -= numValues;
+
+        const unsigned char *levels;
+        size_t levelsSize;
+        const unsigned char *body;
+        size_t bodySize;
+        if (pageType == DATA_PAGE) {
+            body = decompress(codec, page, compressedSize, uncompressedSize, pageBuffer_);
+            bodySize = uncompressedSize;
+            levels = body;
+            levelsSize = 0;
+            if (optional_) {
+                if (defLevelsEncoding != RLE) throw std::runtime_error("unsupported definition level encoding");
+                if (bodySize < 4 || readLe32(body) > bodySize - 4) corrupted("definition levels");
+                levels = body + 4;
+                levelsSize = readLe32(body);
+                body += 4 + levelsSize;
+                bodySize -= 4 + levelsSize;
+            }
+        } else {
+            // v2 keeps the levels uncompressed in front of the values
+            if (repLevelsLength != 0) throw std::runtime_error("repeated columns are not supported");
+            if (defLevelsLength < 0 || defLevelsLength > compressedSize || defLevelsLength > uncompressedSize ||
+                (!isCompressed && uncompressedSize != compressedSize)) {
+                corrupted("definition levels");
+            }
+            levels = page;
+            levelsSize = defLevelsLength;
+            bodySize = uncompressedSize - defLevelsLength;
+            body = isCompressed
+                   ? decompress(codec, page + defLevelsLength, compressedSize - defLevelsLength, bodySize, pageBuffer_)
+                   : page + defLevelsLength;
+        }
+
+        size_t nonNull = numValues;
+        if (optional_) {
+            decodeHybrid(levels, levelsSize, 1, numValues, defLevels_);
+            nonNull = 0;
+            for (uint8_t level : defLevels_) nonNull += level;
+        }
+
+        if (encoding == PLAIN) {
+            dictionaryEncoded_ = false;
+            values_ = body;
+            valuesEnd_ = body + bodySize;
+        } else if (encoding == PLAIN_DICTIONARY || encoding == RLE_DICTIONARY) {
+            if (bodySize < 1) corrupted("dictionary indices");
+            // indices are uint32_t, and decodeHybrid() shifts by the width
+            if (body[0] > 32) corrupted("dictionary index bit width");
+            dictionaryEncoded_ = true;
+            decodeHybrid(body + 1, bodySize - 1, body[0], nonNull, indices_);
+        } else {
+            throw std::runtime_error("unsupported parquet encoding " + std::to_string(encoding));
+        }
+        pageValues_ = numValues;
+        pageIndex_ = 0;
+        nonNullIndex_ = 0;
+        return true;
+    }
+}
+
+bool ParquetColumnReader::next(const unsigned char *&bytes, size_t &size) {
+    for (;;) {
+        while (pageIndex_ < pageValues_) {
+            const bool present = !optional_ || defLevels_[pageIndex_] != 0;
+            pageIndex_++;
+            if (!present) continue;
+            if (dictionaryEncoded_) {
+                const uint32_t index = indices_[nonNullIndex_++];
+                if (index >= dictionary_.size()) corrupted("dictionary index out of range");
+                bytes = dictionary_[index].bytes;
+                size = dictionary_[index].size;
+            } else {
+                if (valuesEnd_ - values_ < 4) corrupted("truncated value");
+                const uint32_t length = readLe32(values_);
+                if (static_cast<size_t>(valuesEnd_ - values_ - 4) < length) corrupted("truncated value");
+                bytes = values_ + 4;
+                size = length;
+                values_ += 4 + length;
+            }
+            return true;
+        }
+        if (!nextPage()) return false;
+    }
+}
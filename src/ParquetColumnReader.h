@@ -0,0 +1,74 @@
+//
+// Reads one BYTE_ARRAY column of a local Parquet file page by page, handing out
+// the raw values without any text conversion.
+//
+// Supported: flat REQUIRED or OPTIONAL columns, PLAIN and dictionary encodings,
+// data pages v1 and v2, UNCOMPRESSED, SNAPPY and (when built with zlib) GZIP.
+//
+
+#ifndef THETA_CLIENT_1_0_0_PARQUETCOLUMNREADER_H
+#define THETA_CLIENT_1_0_0_PARQUETCOLUMNREADER_H
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ParquetColumnReader {
+public:
+    ParquetColumnReader(const std::string &path, const std::string &column);
+
+    // Returns the next non-null value of the column. The span points either into
+    // the mapped file or into a page buffer; it is valid until the next call.
+    // Returns false after the last value of the last row group.
+    bool next(const unsigned char *&bytes, size_t &size);
+
+    int64_t numRows() const { return numRows_; }
+
+private:
+    struct Chunk {
+        int64_t offset;       // first page, dictionary page included
+        int64_t size;         // total compressed size of the pages
+        int64_t numValues;
+        int32_t codec;
+    };
+
+    struct Value {
+        const unsigned char *bytes;
+        uint32_t size;
+    };
+
+    MappedFile file_;
+    int64_t numRows_;
+    bool optional_;
+    std::vector<Chunk> chunks_;
+
+    size_t chunkIndex_;
+    int64_t pageOffset_;        // next page header in the current chunk
+    int64_t chunkEnd_;
+    int64_t chunkValuesLeft_;
+
+    // current data page
+    std::vector<unsigned char> pageBuffer_;
+    std::vector<uint8_t> defLevels_;
+    const unsigned char *values_;
+    const unsigned char *valuesEnd_;
+    int32_t pageValues_;        // slots, nulls included
+    int32_t pageIndex_;
+    bool dictionaryEncoded_;
+    std::vector<uint32_t> indices_;
+    size_t nonNullIndex_;
+
+    // dictionary of the current chunk
+    std::vector<unsigned char> dictionaryBuffer_;
+    std::vector<Value> dictionary_;
+
+    void readFooter(const std::string &column);
+    bool nextPage();
+    const unsigned char *decompress(int32_t codec, const unsigned char *data, size_t size,
+                                    size_t uncompressedSize, std::vector<unsigned char> &buffer);
+    void readDictionary(const unsigned char *data, size_t size, int32_t numValues);
+};
+
+#endif //THETA_CLIENT_1_0_0_PARQUETCOLUMNREADER_H
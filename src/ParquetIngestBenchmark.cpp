@@ -0,0 +1,68 @@
+//
+// Compares ingesting the same sketches from Parquet and from the hex text extract.
+//
+
+#include "ParquetIngestBenchmark.h"
+#include "HexSketchReader.h"
+#include "ParquetColumnReader.h"
+#include "common.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <theta_sketch.hpp>
+#include <theta_intersection.hpp>
+
+namespace {
+
+struct IngestResult {
+    size_t sketches;
+    size_t bytes;
+    double estimate;
+    double seconds;
+};
+
+// reader is anything with next(const unsigned char *&, size_t &)
+template<typename Reader>
+IngestResult ingest(Reader &reader) {
+    const auto start = std::chrono::steady_clock::now();
+    auto intersection = datasketches::theta_intersection(SEED_DEFAULT);
+    IngestResult result = {0, 0, 0, 0};
+    const unsigned char *bytes;
+    size_t size;
+    while (reader.next(bytes, size)) {
+        intersection.update(bytes, size);
+        result.sketches++;
+        result.bytes += size;
+    }
+    result.estimate = intersection.has_result() ? intersection.get_result().get_estimate() : 0;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void report(const char *name, const IngestResult &result) {
+    std::cout << name << ": " << result.sketches << " sketches, "
+              << (result.bytes / result.seconds / 1e6) << " MB/s of sketch bytes, "
+              << (result.seconds * 1e3) << " ms, estimate " << result.estimate << std::endl;
+}
+
+}
+
+void ParquetIngestBenchmark::run(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <events.parquet> <sketches.txt> [repetitions]" << std::endl;
+        return;
+    }
+    const int repetitions = argc > 3 ? std::atoi(argv[3]) : 5;
+    for (int r = 0; r < repetitions; r++) {
+        ParquetColumnReader parquet(argv[1], SKETCH_COLUMN_DEFAULT);
+        const IngestResult fromParquet = ingest(parquet);
+        HexSketchReader text(argv[2]);
+        const IngestResult fromText = ingest(text);
+        report("parquet", fromParquet);
+        report("text", fromText);
+        if (fromParquet.sketches != fromText.sketches || fromParquet.estimate != fromText.estimate) {
+            std::cerr << "parquet and text inputs differ" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,13 @@
+//
+// Compares ingesting the same sketches from Parquet and from the hex text extract.
+//
+
+#ifndef THETA_CLIENT_1_0_0_PARQUETINGESTBENCHMARK_H
+#define THETA_CLIENT_1_0_0_PARQUETINGESTBENCHMARK_H
+
+class ParquetIngestBenchmark {
+public:
+    void run(int argc, char **argv);
+};
+
+#endif //THETA_CLIENT_1_0_0_PARQUETINGESTBENCHMARK_H
@@ -0,0 +1,204 @@
+//
+// Intersects a hex text dump through overlapping stages:
+// reader -> decoder pool (hex decoding + deserialization) -> intersection,
+// connected by bounded lock-free queues.
+//
+
+#include "PipelinedIntersectionTest.h"
+#include "BoundedQueue.h"
+#include "HexDecoder.h"
+#include "HexSketchReader.h"
+#include "common.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <theta_intersection.hpp>
+
+using namespace datasketches;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Line {
+    const char *data;
+    size_t length;
+};
+
+typedef std::unique_ptr<compact_theta_sketch> SketchPtr;
+
+// time spent working and waiting on queues, summed over the threads of a stage
+struct StageTiming {
+    std::atomic<long long> busyNanos;
+    std::atomic<long long> waitNanos;
+    std::atomic<long long> items;
+
+    StageTiming() : busyNanos(0), waitNanos(0), items(0) {}
+
+    void add(long long busy, long long wait, long long count) {
+        busyNanos += busy;
+        waitNanos += wait;
+        items += count;
+    }
+};
+
+long long nanosSince(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+// Pushes, yielding while the queue is full; gives up once another stage failed.
+// The time spent waiting is added to wait.
+template<typename T>
+bool push(BoundedQueue<T> &queue, T &value, const std::atomic<bool> &failed, long long &wait) {
+    if (queue.tryPush(value)) return true;
+    const auto start = Clock::now();
+    bool pushed;
+    while (!(pushed = queue.tryPush(value)) && !failed) std::this_thread::yield();
+    wait += nanosSince(start);
+    return pushed;
+}
+
+void report(const char *name, unsigned threads, const StageTiming &timing) {
+    std::cout << "  " << name << " (" << threads << " thread" << (threads > 1 ? "s" : "") << "): "
+              << timing.items << " items, busy " << (timing.busyNanos / 1e6) << " ms, waiting "
+              << (timing.waitNanos / 1e6) << " ms" << std::endl;
+}
+
+}
+
+void PipelinedIntersectionTest::run(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <path to sketches.txt> [decoder threads] [queue depth, default 64]" << std::endl;
+        return;
+    }
+    const unsigned cores = std::thread::hardware_concurrency();
+    unsigned decoders = argc > 2 ? std::atoi(argv[2]) : (cores > 2 ? cores - 2 : 1);
+    if (decoders == 0) decoders = 1;
+    const size_t depth = argc > 3 ? std::atoi(argv[3]) : 64;
+
+    // memory in flight is bounded by the two queues: lines are spans of the
+    // mapping, sketches are owned by the queue until the consumer takes them
+    BoundedQueue<Line> lines(depth);
+    BoundedQueue<SketchPtr> sketches(depth);
+    std::atomic<bool> readerDone(false);
+    std::atomic<unsigned> decodersLeft(decoders);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto fail = [&]() {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) error = std::current_exception();
+        failed = true;
+    };
+
+    // the lines handed to the decoders point into this mapping, it must outlive every stage
+    HexSketchReader text(argv[1]);
+    StageTiming readTiming, decodeTiming, deserializeTiming, intersectTiming;
+    const auto start = Clock::now();
+
+    // scanning for line ends faults the mapped pages in, this is the I/O stage
+    std::thread reader([&]() {
+        try {
+            long long busy = 0, wait = 0, count = 0;
+            auto begin = Clock::now();
+            Line line;
+            while (text.nextLine(line.data, line.length)) {
+                busy += nanosSince(begin);
+                if (!push(lines, line, failed, wait)) break;
+                count++;
+                begin = Clock::now();
+            }
+            readTiming.add(busy, wait, count);
+        } catch (...) {
+            fail();
+        }
+        readerDone = true;
+    });
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < decoders; i++) {
+        pool.emplace_back([&]() {
+            try {
+                std::vector<unsigned char> buffer;
+                long long decodeBusy = 0, deserializeBusy = 0, wait = 0, count = 0;
+                Line line;
+                for (;;) {
+                    auto begin = Clock::now();
+                    if (!lines.tryPop(line)) {
+                        // the reader may have pushed its last line right before finishing
+                        const bool done = readerDone;
+                        if (failed) break;
+                        if (!lines.tryPop(line)) {
+                            if (done) break;
+                            std::this_thread::yield();
+                            wait += nanosSince(begin);
+                            continue;
+                        }
+                    }
+                    begin = Clock::now();
+                    const size_t size = line.length / 2;
+                    if (buffer.size() < size) buffer.resize(size);
+                    HexDecoder::decode(line.data, line.length, buffer.data());
+                    decodeBusy += nanosSince(begin);
+
+                    begin = Clock::now();
+                    SketchPtr sketch(new compact_theta_sketch(
+                            compact_theta_sketch::deserialize(buffer.data(), size, SEED_DEFAULT)));
+                    deserializeBusy += nanosSince(begin);
+                    if (!push(sketches, sketch, failed, wait)) break;
+                    count++;
+                }
+                decodeTiming.add(decodeBusy, wait, count);
+                deserializeTiming.add(deserializeBusy, 0, count);
+            } catch (...) {
+                fail();
+            }
+            decodersLeft--;
+        });
+    }
+
+    auto intersection = theta_intersection(SEED_DEFAULT);
+    try {
+        long long busy = 0, wait = 0, count = 0;
+        SketchPtr sketch;
+        for (;;) {
+            auto begin = Clock::now();
+            if (!sketches.tryPop(sketch)) {
+                const bool done = decodersLeft == 0;
+                if (!sketches.tryPop(sketch)) {
+                    if (done) break;
+                    std::this_thread::yield();
+                    wait += nanosSince(begin);
+                    continue;
+                }
+            }
+            begin = Clock::now();
+            if (!failed) intersection.update(*sketch);
+            sketch.reset();
+            busy += nanosSince(begin);
+            count++;
+        }
+        intersectTiming.add(busy, wait, count);
+    } catch (...) {
+        fail();
+    }
+    reader.join();
+    for (auto &thread : pool) thread.join();
+    if (error) std::rethrow_exception(error);
+
+    const double elapsed = nanosSince(start) / 1e6;
+    std::cout << "Pipeline: " << elapsed << " ms, queue depth " << lines.capacity() << std::endl;
+    report("read", 1, readTiming);
+    report("decode", decoders, decodeTiming);
+    report("deserialize", decoders, deserializeTiming);
+    report("intersect", 1, intersectTiming);
+    std::cout << "Done: " << (intersection.has_result() ? intersection.get_result().get_estimate() : 0) << std::endl;
+}
@@ -0,0 +1,15 @@
+//
+// Intersects a hex text dump through overlapping stages:
+// reader -> decoder pool (hex decoding + deserialization) -> intersection,
+// connected by bounded lock-free queues.
+//
+
+#ifndef THETA_CLIENT_1_0_0_PIPELINEDINTERSECTIONTEST_H
+#define THETA_CLIENT_1_0_0_PIPELINEDINTERSECTIONTEST_H
+
+class PipelinedIntersectionTest {
+public:
+    void run(int argc, char **argv);
+};
+
+#endif //THETA_CLIENT_1_0_0_PIPELINEDINTERSECTIONTEST_H
@@ -0,0 +1,111 @@
+//
+// Binary archive of serialized sketches, read through a memory mapping with
+// no parsing.
+//
+
+#include "SketchArchive.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+uint64_t load64(const unsigned char *p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+void store64(unsigned char *p, uint64_t value) {
+    std::memcpy(p, &value, sizeof(value));
+}
+
+}
+
+const char SketchArchive::MAGIC[8] = {'T', 'H', 'S', 'K', 'A', 'R', 'C', '1'};
+
+SketchArchive::SketchArchive(const std::string &path) : file_(path, MappedFile::RANDOM), count_(0), index_(nullptr) {
+    const unsigned char *base = reinterpret_cast<const unsigned char *>(file_.data());
+    const uint64_t size = file_.size();
+    if (size < HEADER_SIZE || std::memcmp(base, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(path + " is not a sketch archive");
+    }
+    uint32_t version;
+    std::memcpy(&version, base + 8, sizeof(version));
+    if (version != VERSION) {
+        throw std::runtime_error(path + ": unsupported archive version " + std::to_string(version));
+    }
+    const uint64_t count = load64(base + 16);
+    const uint64_t indexOffset = load64(base + 24);
+    if (indexOffset < HEADER_SIZE || indexOffset > size || count > (size - indexOffset) / 16) {
+        throw std::runtime_error(path + ": truncated archive index");
+    }
+    count_ = count;
+    index_ = base + indexOffset;
+}
+
+// Entries are checked when they are read rather than when the archive is
+// opened, so opening does not touch the index
+void SketchArchive::entry(size_t i, uint64_t &offset, uint64_t &length) const {
+    if (i >= count_) throw std::out_of_range("sketch " + std::to_string(i) + " out of " + std::to_string(count_));
+    offset = load64(index_ + 16 * i);
+    length = load64(index_ + 16 * i + 8);
+    const uint64_t blobsEnd = index_ - reinterpret_cast<const unsigned char *>(file_.data());
+    if (offset < HEADER_SIZE || offset % ALIGNMENT != 0 || offset > blobsEnd || length > blobsEnd - offset) {
+        throw std::runtime_error("corrupt archive index entry " + std::to_string(i));
+    }
+}
+
+const unsigned char *SketchArchive::data(size_t i) const {
+    uint64_t offset, length;
+    entry(i, offset, length);
+    return reinterpret_cast<const unsigned char *>(file_.data()) + offset;
+}
+
+size_t SketchArchive::length(size_t i) const {
+    uint64_t offset, length;
+    entry(i, offset, length);
+    return length;
+}
+
+SketchArchiveWriter::SketchArchiveWriter(const std::string &path)
+        : path_(path), out_(path, std::ios::binary | std::ios::trunc), offset_(SketchArchive::HEADER_SIZE) {
+    if (!out_) throw std::runtime_error("cannot open " + path);
+    // placeholder, rewritten by close() once the count and the index offset are known
+    const char header[SketchArchive::HEADER_SIZE] = {};
+    out_.write(header, sizeof(header));
+}
+
+SketchArchiveWriter::~SketchArchiveWriter() {
+    try {
+        if (out_.is_open()) close();
+    } catch (...) {
+        // destructors must not throw, call close() to see errors
+    }
+}
+
+void SketchArchiveWriter::add(const void *bytes, size_t size) {
+    index_.push_back(offset_);
+    index_.push_back(size);
+    out_.write(static_cast<const char *>(bytes), size);
+    const size_t padding = (SketchArchive::ALIGNMENT - size % SketchArchive::ALIGNMENT) % SketchArchive::ALIGNMENT;
+    const char zeros[SketchArchive::ALIGNMENT] = {};
+    out_.write(zeros, padding);
+    offset_ += size + padding;
+    if (!out_) throw std::runtime_error("cannot write " + path_);
+}
+
+void SketchArchiveWriter::close() {
+    out_.write(reinterpret_cast<const char *>(index_.data()), index_.size() * sizeof(uint64_t));
+
+    unsigned char header[SketchArchive::HEADER_SIZE] = {};
+    std::memcpy(header, SketchArchive::MAGIC, sizeof(SketchArchive::MAGIC));
+    const uint32_t version = SketchArchive::VERSION;
+    std::memcpy(header + 8, &version, sizeof(version));
+    store64(header + 16, index_.size() / 2);
+    store64(header + 24, offset_);
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char *>(header), sizeof(header));
+    out_.close();
+    if (!out_) throw std::runtime_error("cannot write " + path_);
+}
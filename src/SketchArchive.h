@@ -0,0 +1,66 @@
+//
+// Binary archive of serialized sketches, read through a memory mapping with
+// no parsing. Layout, little endian:
+//
+//   header   magic "THSKARC1", uint32 version, uint32 reserved,
+//            uint64 sketch count, uint64 index offset
+//   blobs    the serialized sketches, each starting on an 8 byte boundary
+//   index    uint64 offset and uint64 length of every sketch, in order
+//
+// The index comes last so that the writer can stream the blobs.
+//
+
+#ifndef THETA_CLIENT_1_0_0_SKETCHARCHIVE_H
+#define THETA_CLIENT_1_0_0_SKETCHARCHIVE_H
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class SketchArchive {
+public:
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_SIZE = 32;
+    static const size_t ALIGNMENT = 8;
+
+    // Maps the archive and checks the header; throws std::runtime_error if
+    // the file is not an archive. Opening is O(1), whatever the sketch count.
+    explicit SketchArchive(const std::string &path);
+
+    size_t size() const { return count_; }
+
+    // Serialized sketch i, pointing into the mapping, 8 byte aligned.
+    // Throws std::out_of_range for a bad index, std::runtime_error for a corrupt entry.
+    const unsigned char *data(size_t i) const;
+    size_t length(size_t i) const;
+
+private:
+    MappedFile file_;
+    size_t count_;
+    const unsigned char *index_;
+
+    void entry(size_t i, uint64_t &offset, uint64_t &length) const;
+};
+
+class SketchArchiveWriter {
+public:
+    explicit SketchArchiveWriter(const std::string &path);
+    // finishes the archive if close() was not called
+    ~SketchArchiveWriter();
+
+    void add(const void *bytes, size_t size);
+    // writes the index and the final header
+    void close();
+
+private:
+    std::string path_;
+    std::ofstream out_;
+    uint64_t offset_;
+    std::vector<uint64_t> index_;
+};
+
+#endif //THETA_CLIENT_1_0_0_SKETCHARCHIVE_H
@@ -0,0 +1,69 @@
+//
+// Converts a hex text dump into a SketchArchive, and intersects a range of
+// the sketches of an archive.
+//
+
+#include "SketchFromArchiveTest.h"
+#include "HexSketchReader.h"
+#include "SketchArchive.h"
+#include "common.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <theta_intersection.hpp>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+}
+
+void SketchFromArchiveTest::run(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <archive> [first sketch] [sketch count]" << std::endl;
+        return;
+    }
+    auto start = Clock::now();
+    SketchArchive archive(argv[1]);
+    const double openMs = msSince(start);
+
+    const size_t first = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+    size_t count = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : archive.size();
+    if (first > archive.size()) count = 0;
+    else if (count > archive.size() - first) count = archive.size() - first;
+
+    start = Clock::now();
+    auto intersection = datasketches::theta_intersection(SEED_DEFAULT);
+    for (size_t i = first; i < first + count; i++) {
+        intersection.update(archive.data(i), archive.length(i));
+    }
+    const double intersectMs = msSince(start);
+
+    std::cout << "Archive: " << archive.size() << " sketches, opened in " << openMs << " ms" << std::endl;
+    std::cout << "Sketches: " << count << " from " << first << ", intersected in " << intersectMs << " ms" << std::endl;
+    std::cout << "Done: " << (intersection.has_result() ? intersection.get_result().get_estimate() : 0) << std::endl;
+}
+
+void SketchFromArchiveTest::convert(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <path to sketches.txt> <archive>" << std::endl;
+        return;
+    }
+    const auto start = Clock::now();
+    HexSketchReader reader(argv[1]);
+    SketchArchiveWriter writer(argv[2]);
+    const unsigned char *bytes;
+    size_t size;
+    size_t count = 0;
+    while (reader.next(bytes, size)) {
+        writer.add(bytes, size);
+        count++;
+    }
+    writer.close();
+    std::cout << "Archived " << count << " sketches in " << msSince(start) << " ms" << std::endl;
+}
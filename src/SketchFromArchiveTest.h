@@ -0,0 +1,15 @@
+//
+// Converts a hex text dump into a SketchArchive, and intersects a range of
+// the sketches of an archive.
+//
+
+#ifndef THETA_CLIENT_1_0_0_SKETCHFROMARCHIVETEST_H
+#define THETA_CLIENT_1_0_0_SKETCHFROMARCHIVETEST_H
+
+class SketchFromArchiveTest {
+public:
+    void run(int argc, char **argv);
+    void convert(int argc, char **argv);
+};
+
+#endif //THETA_CLIENT_1_0_0_SKETCHFROMARCHIVETEST_H
@@ -0,0 +1,34 @@
+//
+// Intersects the theta_sketch column of a Parquet file, without the hex text step.
+//
+
+#include "SketchFromParquetTest.h"
+#include "ParquetColumnReader.h"
+#include "common.h"
+
+#include <iostream>
+#include <theta_sketch.hpp>
+#include <theta_intersection.hpp>
+
+void SketchFromParquetTest::run(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: "
+                  << argv[0]
+                  << " <path to events.parquet> [column, default " << SKETCH_COLUMN_DEFAULT << "]"
+                  << std::endl;
+        return;
+    }
+
+    auto intersection = datasketches::theta_intersection(SEED_DEFAULT);
+    ParquetColumnReader reader(argv[1], argc > 2 ? argv[2] : SKETCH_COLUMN_DEFAULT);
+    const unsigned char *bytes;
+    size_t size;
+    size_t count = 0;
+    while (reader.next(bytes, size)) {
+        intersection.update(bytes, size);
+        count++;
+    }
+
+    std::cout << "Sketches: " << count << std::endl;
+    std::cout << "Done: " << intersection.get_result().get_estimate() << std::endl;
+}
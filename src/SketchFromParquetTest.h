@@ -0,0 +1,13 @@
+//
+// Intersects the theta_sketch column of a Parquet file, without the hex text step.
+//
+
+#ifndef THETA_CLIENT_1_0_0_SKETCHFROMPARQUETTEST_H
+#define THETA_CLIENT_1_0_0_SKETCHFROMPARQUETTEST_H
+
+class SketchFromParquetTest {
+public:
+    void run(int argc, char **argv);
+};
+
+#endif //THETA_CLIENT_1_0_0_SKETCHFROMPARQUETTEST_H
@@ -3,9 +3,9 @@
 //
 
 #include "SketchFromTextTest.h"
+#include "HexSketchReader.h"
 #include "common.h"
 
-#include <fstream>
 #include <sstream>
 #include <theta_sketch.hpp>
 #include <theta_intersection.hpp>
@@ -21,24 +21,21 @@ void SketchFromTextTest::run(int argc, char **argv) {
 
     auto intersection = datasketches::theta_intersection(SEED_DEFAULT);
     // Read sketches from parquet extract
-    std::ifstream file(argv[1]);
-    std::string str;
-    while (std::getline(file, str)) {
-        std::cout << "add More: " << str.length() << std::endl;
-        // Add them in the intersection
-        unsigned char bytes[str.length() / 2];
-        fromHex(str, bytes);
-        auto second_sketch = datasketches::compact_theta_sketch::deserialize(bytes,
-                                                               str.length() / 2,
-                                                               SEED_DEFAULT);
-        std::cout << second_sketch.get_num_retained() << std::endl;
-        intersection.update(second_sketch);
+    HexSketchReader reader(argv[1]);
+    const unsigned char *bytes;
+    size_t size;
+    size_t count = 0;
+    while (reader.next(bytes, size)) {
+        // Add them in the intersection, which only deserializes them while it can still keep keys
+        intersection.update(bytes, size);
+        count++;
     }
 
     // force serialization of intersection
     auto data = intersection.get_result().serialize();
 
 
+    std::cout << "Sketches: " << count << std::endl;
     std::cout << "Done: " << intersection.get_result().get_estimate() << std::endl;
 }
 
@@ -10,8 +10,9 @@
 class SketchFromTextTest {
 public:
     void run(int argc, char **argvs);
-private:
-    void fromHex(const std::string &in, void *const data);
+
+    // stringstream based decoder, kept as the reference for HexDecodeBenchmark
+    static void fromHex(const std::string &in, void *const data);
 };
 
 #endif //THETA_CLIENT_1_0_0_SKETCHFROMTEXTTEST_H
@@ -0,0 +1,89 @@
+//
+// Builds a synthetic workload with WorkloadGenerator and compares the set
+// operation estimates with the exact cardinalities.
+//
+
+#include "SyntheticWorkloadTest.h"
+#include "WorkloadGenerator.h"
+#include "common.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <theta_intersection.hpp>
+#include <theta_union.hpp>
+
+using namespace datasketches;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void report(const char *name, double estimate, uint64_t exact, double ms) {
+    std::cout << name << ": estimate " << estimate << ", exact " << exact << ", error "
+              << (exact == 0 ? 0 : (estimate - exact) / exact * 100) << "%, " << ms << " ms" << std::endl;
+}
+
+bool endsWith(const std::string &s, const std::string &suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}
+
+void SyntheticWorkloadTest::run(int argc, char **argv) {
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <sketches> <core keys> <pairwise keys> <unique keys> [lg_k] [threads] [seed]"
+                  << " [output: .txt for hex lines, otherwise a prefix for .bin files]" << std::endl;
+        return;
+    }
+    WorkloadGenerator::Config config;
+    config.sketches = std::strtoul(argv[1], nullptr, 10);
+    config.coreKeys = std::strtoull(argv[2], nullptr, 10);
+    config.pairwiseKeys = std::strtoull(argv[3], nullptr, 10);
+    config.uniqueKeys = std::strtoull(argv[4], nullptr, 10);
+    config.lgK = argc > 5 ? std::atoi(argv[5]) : LOGK_DEFAULT;
+    unsigned threads = argc > 6 ? std::atoi(argv[6]) : std::thread::hardware_concurrency();
+    config.seed = argc > 7 ? std::strtoull(argv[7], nullptr, 10) : 0;
+    WorkloadGenerator generator(config);
+
+    auto start = Clock::now();
+    const auto sketches = generator.build(threads);
+    std::cout << "Built " << sketches.size() << " sketches of " << generator.sketchCardinality() << " keys in "
+              << msSince(start) << " ms" << std::endl;
+
+    report("Sketch 0", sketches[0].get_estimate(), generator.sketchCardinality(), 0);
+    if (sketches.size() > 1) {
+        start = Clock::now();
+        auto pair = theta_intersection(SEED_DEFAULT);
+        pair.update(sketches[0]);
+        pair.update(sketches[1]);
+        report("Intersection of 0 and 1", pair.get_result().get_estimate(), generator.pairIntersection(), msSince(start));
+    }
+
+    start = Clock::now();
+    auto intersection = theta_intersection(SEED_DEFAULT);
+    for (const auto &sketch : sketches) intersection.update(sketch);
+    report("Intersection", intersection.get_result().get_estimate(), generator.intersection(), msSince(start));
+
+    start = Clock::now();
+    auto u = theta_union::builder().set_lg_k(config.lgK).set_seed(SEED_DEFAULT).build();
+    for (const auto &sketch : sketches) u.update(sketch);
+    report("Union", u.get_result().get_estimate(), generator.unionCardinality(), msSince(start));
+
+    if (argc > 8) {
+        const std::string output = argv[8];
+        if (endsWith(output, ".txt")) {
+            WorkloadGenerator::writeHex(output, sketches);
+        } else {
+            WorkloadGenerator::writeBinary(output, sketches);
+        }
+        std::cout << "Written to " << output << std::endl;
+    }
+}
@@ -0,0 +1,14 @@
+//
+// Builds a synthetic workload with WorkloadGenerator and compares the set
+// operation estimates with the exact cardinalities.
+//
+
+#ifndef THETA_CLIENT_1_0_0_SYNTHETICWORKLOADTEST_H
+#define THETA_CLIENT_1_0_0_SYNTHETICWORKLOADTEST_H
+
+class SyntheticWorkloadTest {
+public:
+    void run(int argc, char **argv);
+};
+
+#endif //THETA_CLIENT_1_0_0_SYNTHETICWORKLOADTEST_H
@@ -0,0 +1,112 @@
+//
+// Deterministic synthetic workloads with known set overlaps.
+//
+
+#include "WorkloadGenerator.h"
+#include "common.h"
+
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+using namespace datasketches;
+
+WorkloadGenerator::WorkloadGenerator(const Config &config) : config_(config) {
+    if (config.sketches == 0) throw std::invalid_argument("a workload needs at least one sketch");
+}
+
+uint64_t WorkloadGenerator::key(uint64_t counter) const {
+    // splitmix64 finalizer: every step is invertible, so is the whole
+    uint64_t z = counter + config_.seed * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t WorkloadGenerator::pairIndex(uint32_t i, uint32_t j) const {
+    const uint64_t n = config_.sketches;
+    return uint64_t(i) * (2 * n - i - 1) / 2 + (j - i - 1);
+}
+
+std::vector<compact_theta_sketch> WorkloadGenerator::build(unsigned threads) const {
+    if (threads == 0) threads = 1;
+    std::vector<std::unique_ptr<compact_theta_sketch>> built(config_.sketches);
+    std::atomic<uint32_t> next(0);
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            try {
+                for (uint32_t i = next++; i < config_.sketches; i = next++) {
+                    auto sketch = update_theta_sketch::builder().set_lg_k(config_.lgK).set_seed(SEED_DEFAULT).build();
+                    forEachKey(i, [&sketch](uint64_t key) { sketch.update(key); });
+                    built[i].reset(new compact_theta_sketch(sketch.compact()));
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto &worker : workers) worker.join();
+    for (auto &error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+
+    std::vector<compact_theta_sketch> sketches;
+    sketches.reserve(built.size());
+    for (auto &sketch : built) sketches.push_back(std::move(*sketch));
+    return sketches;
+}
+
+uint64_t WorkloadGenerator::sketchCardinality() const {
+    return config_.coreKeys + uint64_t(config_.sketches - 1) * config_.pairwiseKeys + config_.uniqueKeys;
+}
+
+uint64_t WorkloadGenerator::pairIntersection() const {
+    return config_.coreKeys + config_.pairwiseKeys;
+}
+
+uint64_t WorkloadGenerator::intersection() const {
+    // with two sketches their pairwise keys are shared by all of them
+    switch (config_.sketches) {
+        case 1: return sketchCardinality();
+        case 2: return pairIntersection();
+        default: return config_.coreKeys;
+    }
+}
+
+uint64_t WorkloadGenerator::unionCardinality() const {
+    return config_.coreKeys + pairs() * config_.pairwiseKeys + uint64_t(config_.sketches) * config_.uniqueKeys;
+}
+
+void WorkloadGenerator::writeHex(const std::string &path, const std::vector<compact_theta_sketch> &sketches) {
+    static const char digits[] = "0123456789abcdef";
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("cannot open " + path);
+    std::string line;
+    for (const auto &sketch : sketches) {
+        const auto bytes = sketch.serialize();
+        const unsigned char *data = static_cast<const unsigned char *>(bytes.first.get());
+        line.resize(bytes.second * 2 + 1);
+        for (size_t i = 0; i < bytes.second; i++) {
+            line[2 * i] = digits[data[i] >> 4];
+            line[2 * i + 1] = digits[data[i] & 0xf];
+        }
+        line[bytes.second * 2] = '\n';
+        out.write(line.data(), line.size());
+    }
+    if (!out) throw std::runtime_error("cannot write " + path);
+}
+
+void WorkloadGenerator::writeBinary(const std::string &prefix, const std::vector<compact_theta_sketch> &sketches) {
+    for (size_t i = 0; i < sketches.size(); i++) {
+        const std::string path = prefix + std::to_string(i) + ".bin";
+        std::ofstream out(path, std::ios::binary);
+        if (!out) throw std::runtime_error("cannot open " + path);
+        sketches[i].serialize(out);
+        if (!out) throw std::runtime_error("cannot write " + path);
+    }
+}
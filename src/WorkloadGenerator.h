@@ -0,0 +1,80 @@
+//
+// Deterministic synthetic workloads with known set overlaps.
+//
+// Sketch i of n receives the union of three kinds of key ranges:
+//  - core keys, shared by all n sketches
+//  - pairwise keys, one range per pair {i, j}, shared by exactly those two
+//  - unique keys, only in sketch i
+// Each range is a disjoint block of counters, and a key is a bijective mix of
+// its counter and the seed, so different counters never collide and the
+// exact cardinalities follow from the configuration alone.
+//
+
+#ifndef THETA_CLIENT_1_0_0_WORKLOADGENERATOR_H
+#define THETA_CLIENT_1_0_0_WORKLOADGENERATOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <theta_sketch.hpp>
+
+class WorkloadGenerator {
+public:
+    struct Config {
+        uint32_t sketches;
+        uint64_t coreKeys;
+        uint64_t pairwiseKeys;      // per pair of sketches
+        uint64_t uniqueKeys;        // per sketch
+        uint8_t lgK;
+        uint64_t seed;              // of the key streams, not of the sketches
+    };
+
+    explicit WorkloadGenerator(const Config &config);
+
+    const Config &config() const { return config_; }
+
+    // the key of a counter; bijective for a given seed
+    uint64_t key(uint64_t counter) const;
+
+    // Calls f(key) for every key of sketch i: core, then pairwise in order
+    // of the other sketch, then unique keys
+    template<typename F>
+    void forEachKey(uint32_t i, F f) const;
+
+    // Builds the sketches, each one on a single thread
+    std::vector<datasketches::compact_theta_sketch> build(unsigned threads) const;
+
+    // exact cardinalities
+    uint64_t sketchCardinality() const;
+    uint64_t pairIntersection() const;
+    uint64_t intersection() const;
+    uint64_t unionCardinality() const;
+
+    // one hex line per sketch, the format of thirdparty/parquet/sketches.txt
+    static void writeHex(const std::string &path, const std::vector<datasketches::compact_theta_sketch> &sketches);
+    // one serialized sketch per file, <prefix><index>.bin
+    static void writeBinary(const std::string &prefix, const std::vector<datasketches::compact_theta_sketch> &sketches);
+
+private:
+    Config config_;
+
+    uint64_t pairs() const { return uint64_t(config_.sketches) * (config_.sketches - 1) / 2; }
+    // index of the pair {i, j} with i < j among all pairs
+    uint64_t pairIndex(uint32_t i, uint32_t j) const;
+};
+
+template<typename F>
+void WorkloadGenerator::forEachKey(uint32_t i, F f) const {
+    for (uint64_t c = 0; c < config_.coreKeys; c++) f(key(c));
+    const uint64_t pairBase = config_.coreKeys;
+    for (uint32_t j = 0; config_.pairwiseKeys > 0 && j < config_.sketches; j++) {
+        if (j == i) continue;
+        const uint64_t base = pairBase + pairIndex(std::min(i, j), std::max(i, j)) * config_.pairwiseKeys;
+        for (uint64_t c = 0; c < config_.pairwiseKeys; c++) f(key(base + c));
+    }
+    const uint64_t base = pairBase + pairs() * config_.pairwiseKeys + uint64_t(i) * config_.uniqueKeys;
+    for (uint64_t c = 0; c < config_.uniqueKeys; c++) f(key(base + c));
+}
+
+#endif //THETA_CLIENT_1_0_0_WORKLOADGENERATOR_H
@@ -7,5 +7,6 @@
 
 #define LOGK_DEFAULT 12
 #define SEED_DEFAULT 9001
+#define SKETCH_COLUMN_DEFAULT "theta_sketch"
 
 #endif //THETA_CLIENT_1_0_0_COMMON_H
@@ -1,7 +1,47 @@
+#include "HexDecodeBenchmark.h"
 #include "MemoryGenerationTest.h"
+#include "ParallelIntersectionTest.h"
+#include "ParquetIngestBenchmark.h"
+#include "PipelinedIntersectionTest.h"
+#include "SketchFromArchiveTest.h"
+#include "SketchFromParquetTest.h"
 #include "SketchFromTextTest.h"
+#include "SyntheticWorkloadTest.h"
+
+#include <string>
 
 int main(int argc, char **argv) {
-    MemoryGenerationTest test;
-    test.run();
+    // optional mode as the first argument, the remaining ones are passed along
+    const std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "text") {
+        SketchFromTextTest test;
+        test.run(argc - 1, argv + 1);
+    } else if (mode == "parquet") {
+        SketchFromParquetTest test;
+        test.run(argc - 1, argv + 1);
+    } else if (mode == "parallel") {
+        ParallelIntersectionTest test;
+        test.run(argc - 1, argv + 1);
+    } else if (mode == "pipeline") {
+        PipelinedIntersectionTest test;
+        test.run(argc - 1, argv + 1);
+    } else if (mode == "archive") {
+        SketchFromArchiveTest test;
+        test.run(argc - 1, argv + 1);
+    } else if (mode == "to-archive") {
+        SketchFromArchiveTest test;
+        test.convert(argc - 1, argv + 1);
+    } else if (mode == "generate") {
+        SyntheticWorkloadTest test;
+        test.run(argc - 1, argv + 1);
+    } else if (mode == "bench-hex") {
+        HexDecodeBenchmark benchmark;
+        benchmark.run(argc - 1, argv + 1);
+    } else if (mode == "bench-parquet") {
+        ParquetIngestBenchmark benchmark;
+        benchmark.run(argc - 1, argv + 1);
+    } else {
+        MemoryGenerationTest test;
+        test.run();
+    }
 }
@@ -23,5 +23,6 @@ namespace datasketches {
 
 // global variable to keep track of allocated size
 long long test_allocator_total_bytes = 0;
+long long test_allocator_allocations = 0;
 
 } /* namespace datasketches */
@@ -28,6 +28,8 @@
 namespace datasketches {
 
 extern long long test_allocator_total_bytes;
+// number of allocate() calls, never decremented
+extern long long test_allocator_allocations;
 
 template <class T> class test_allocator {
 public:
@@ -57,6 +59,7 @@ public:
     void* p = new char[n * sizeof(value_type)];
     if (!p) throw std::bad_alloc();
     test_allocator_total_bytes += n * sizeof(value_type);
+    test_allocator_allocations++;
     return static_cast<pointer>(p);
   }
 
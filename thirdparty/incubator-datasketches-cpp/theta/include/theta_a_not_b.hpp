@@ -25,6 +25,7 @@
 #include <climits>
 
 #include <theta_sketch.hpp>
+#include <theta_sorted_set.hpp>
 
 namespace datasketches {
 
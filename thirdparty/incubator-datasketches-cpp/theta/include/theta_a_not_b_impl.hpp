@@ -62,8 +62,8 @@ compact_theta_sketch_alloc<A> theta_a_not_b_alloc<A>::compute(const theta_sketch
   keys = AllocU64().allocate(keys_size);
 
   if (a.is_ordered() and b.is_ordered()) { // sort-based
-    const auto end = std::set_difference(a.begin(), a.end(), b.begin(), b.end(), keys);
-    count = end - keys;
+    count = sorted_set_difference(theta_sketch_alloc<A>::get_ordered_keys(a), a.get_num_retained(),
+        theta_sketch_alloc<A>::get_ordered_keys(b), b.get_num_retained(), theta, keys);
   } else { // hash-based
     const uint8_t lg_size = lg_size_from_count(b.get_num_retained(), update_theta_sketch_alloc<A>::REBUILD_THRESHOLD);
     uint64_t* b_hash_table = AllocU64().allocate(1 << lg_size);
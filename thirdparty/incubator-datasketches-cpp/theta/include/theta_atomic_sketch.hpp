@@ -0,0 +1,132 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THETA_ATOMIC_SKETCH_HPP_
+#define THETA_ATOMIC_SKETCH_HPP_
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <theta_sketch.hpp>
+
+namespace datasketches {
+
+/*
+ * Update sketch that any number of threads update directly, without locks or
+ * buffering, for streams of few distinct values at a high rate.
+ *
+ * The hash table is the one of update_theta_sketch, with the same probe sequence,
+ * but a new key claims an empty slot with compare-and-swap. Hashes at or above
+ * theta and keys already in the table are rejected by plain loads, without
+ * writing anything shared, which is what most updates of such a stream are.
+ *
+ * Resizes and rebuilds, which need the whole table, are the exception. The thread
+ * that pushes the count over the capacity raises a maintenance flag, waits until
+ * the inserts in flight have left the table, and then works alone. Inserts that
+ * arrive meanwhile wait for it to finish. Tables outgrown by a resize are kept
+ * until the sketch is destroyed (at most 1/7 more memory), so that lookups never
+ * need to announce themselves.
+ */
+
+template<typename A>
+class atomic_update_theta_sketch_alloc {
+public:
+  typedef typename update_theta_sketch_alloc<A>::builder builder_type;
+
+  explicit atomic_update_theta_sketch_alloc(uint8_t lg_k = builder_type::DEFAULT_LG_K, uint64_t seed = builder_type::DEFAULT_SEED);
+  ~atomic_update_theta_sketch_alloc();
+
+  atomic_update_theta_sketch_alloc(const atomic_update_theta_sketch_alloc&) = delete;
+  atomic_update_theta_sketch_alloc& operator=(const atomic_update_theta_sketch_alloc&) = delete;
+
+  // safe to call from any number of threads at once, same hashes as update_theta_sketch
+  void update(const std::string& value);
+  void update(uint64_t value);
+  void update(int64_t value);
+  void update(uint32_t value);
+  void update(int32_t value);
+  void update(double value);
+  void update(const void* data, unsigned length);
+
+  // lock free, may miss the updates in flight
+  bool is_empty() const;
+  // the retained keys and theta of the same moment: waits for a rebuild in progress,
+  // which changes both, may miss the updates in flight
+  double get_estimate() const;
+  double get_theta() const;
+  uint64_t get_theta64() const;
+  uint32_t get_num_retained() const;
+
+  uint16_t get_seed_hash() const;
+
+  // the keys present while the table is scanned, the updates go on meanwhile
+  compact_theta_sketch_alloc<A> compact(bool ordered = true) const;
+
+private:
+  typedef update_theta_sketch_alloc<A> update_sketch;
+  typedef typename std::allocator_traits<A>::template rebind_alloc<uint64_t> AllocU64;
+  typedef typename std::allocator_traits<A>::template rebind_alloc<std::atomic<uint64_t>> AllocAtomicU64;
+  enum insert_result { INSERTED, INSERTED_OVER_CAPACITY, DUPLICATE, NO_EMPTY_SLOT };
+  // resize factor of the table while it grows to its final size
+  static const uint8_t LG_RESIZE_FACTOR = 3;
+
+  struct table {
+    uint8_t lg_size;
+    std::atomic<uint64_t>* keys;
+    table* outgrown;
+  };
+  typedef typename std::allocator_traits<A>::template rebind_alloc<table> AllocTable;
+
+  const uint8_t lg_nom_size_;
+  const uint64_t seed_;
+  std::atomic<table*> table_;
+  std::atomic<uint32_t> num_keys_;
+  std::atomic<uint64_t> theta_;
+  std::atomic<bool> is_empty_;
+  // a seqlock over num_keys_ and theta_: odd while a rebuild changes them together
+  std::atomic<uint32_t> rebuild_version_;
+  // inserts in the table at the moment
+  mutable std::atomic<uint32_t> active_;
+  // set while one thread resizes or rebuilds the table
+  mutable std::atomic<bool> maintenance_;
+
+  void insert(uint64_t hash);
+  insert_result try_insert(uint64_t hash);
+  static bool contains(const table* t, uint64_t hash);
+  void enter() const;
+  void leave() const;
+  void maintain();
+  void resize();
+  void rebuild();
+  static uint8_t starting_lg_size(uint8_t lg_nom_size);
+  static table* allocate_table(uint8_t lg_size, table* outgrown);
+  static void deallocate_table(table* t);
+  // single threaded, for maintenance
+  static void table_insert(uint64_t hash, table* t);
+};
+
+// alias with default allocator for convenience
+typedef atomic_update_theta_sketch_alloc<std::allocator<void>> atomic_update_theta_sketch;
+
+} /* namespace datasketches */
+
+#include "theta_atomic_sketch_impl.hpp"
+
+# endif
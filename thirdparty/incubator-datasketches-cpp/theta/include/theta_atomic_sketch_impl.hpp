@@ -0,0 +1,327 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THETA_ATOMIC_SKETCH_IMPL_HPP_
+#define THETA_ATOMIC_SKETCH_IMPL_HPP_
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace datasketches {
+
+template<typename A>
+atomic_update_theta_sketch_alloc<A>::atomic_update_theta_sketch_alloc(uint8_t lg_k, uint64_t seed):
+lg_nom_size_(lg_k),
+seed_(seed),
+table_(nullptr),
+num_keys_(0),
+theta_(theta_sketch_alloc<A>::MAX_THETA),
+is_empty_(true),
+rebuild_version_(0),
+active_(0),
+maintenance_(false)
+{
+  if (lg_k < builder_type::MIN_LG_K) {
+    throw std::invalid_argument("lg_k must not be less than " + std::to_string(builder_type::MIN_LG_K) + ": " + std::to_string(lg_k));
+  }
+  table_.store(allocate_table(starting_lg_size(lg_k), nullptr));
+}
+
+template<typename A>
+atomic_update_theta_sketch_alloc<A>::~atomic_update_theta_sketch_alloc() {
+  deallocate_table(table_.load());
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::update(const std::string& value) {
+  if (value.empty()) return;
+  update(value.c_str(), value.length());
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::update(uint64_t value) {
+  update(&value, sizeof(value));
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::update(int64_t value) {
+  update(&value, sizeof(value));
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::update(uint32_t value) {
+  update(static_cast<int32_t>(value));
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::update(int32_t value) {
+  update(static_cast<int64_t>(value));
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::update(double value) {
+  update(update_sketch::canonical_double(value));
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::update(const void* data, unsigned length) {
+  insert(update_sketch::compute_hash(data, length, seed_));
+}
+
+template<typename A>
+bool atomic_update_theta_sketch_alloc<A>::is_empty() const {
+  return is_empty_.load(std::memory_order_relaxed);
+}
+
+template<typename A>
+double atomic_update_theta_sketch_alloc<A>::get_estimate() const {
+  for (;;) {
+    const uint32_t version = rebuild_version_.load(std::memory_order_acquire);
+    if (version & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    const uint32_t num_keys = num_keys_.load(std::memory_order_relaxed);
+    const uint64_t theta = theta_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (rebuild_version_.load(std::memory_order_relaxed) == version) {
+      return num_keys / (static_cast<double>(theta) / theta_sketch_alloc<A>::MAX_THETA);
+    }
+  }
+}
+
+template<typename A>
+double atomic_update_theta_sketch_alloc<A>::get_theta() const {
+  return static_cast<double>(get_theta64()) / theta_sketch_alloc<A>::MAX_THETA;
+}
+
+template<typename A>
+uint64_t atomic_update_theta_sketch_alloc<A>::get_theta64() const {
+  return theta_.load(std::memory_order_relaxed);
+}
+
+template<typename A>
+uint32_t atomic_update_theta_sketch_alloc<A>::get_num_retained() const {
+  return num_keys_.load(std::memory_order_relaxed);
+}
+
+template<typename A>
+uint16_t atomic_update_theta_sketch_alloc<A>::get_seed_hash() const {
+  return theta_sketch_alloc<A>::get_seed_hash(seed_);
+}
+
+template<typename A>
+compact_theta_sketch_alloc<A> atomic_update_theta_sketch_alloc<A>::compact(bool ordered) const {
+  enter();
+  const bool is_empty = is_empty_.load(std::memory_order_relaxed);
+  const uint64_t theta = theta_.load(std::memory_order_relaxed);
+  const table* t = table_.load(std::memory_order_relaxed);
+  const uint32_t size = 1 << t->lg_size;
+  uint32_t num_keys = 0;
+  for (uint32_t i = 0; i < size; i++) {
+    if (t->keys[i].load(std::memory_order_relaxed) != 0) num_keys++;
+  }
+  // keys inserted after the first pass are left out, none can disappear
+  uint64_t* keys = AllocU64().allocate(num_keys);
+  uint32_t i = 0;
+  for (uint32_t j = 0; j < size and i < num_keys; j++) {
+    const uint64_t key = t->keys[j].load(std::memory_order_relaxed);
+    if (key != 0) keys[i++] = key;
+  }
+  leave();
+  if (ordered) std::sort(keys, &keys[num_keys]);
+  return compact_theta_sketch_alloc<A>(is_empty, theta, keys, num_keys, get_seed_hash(), ordered);
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::insert(uint64_t hash) {
+  // written once, reading first keeps the cache line shared
+  if (is_empty_.load(std::memory_order_relaxed)) is_empty_.store(false, std::memory_order_relaxed);
+  for (;;) {
+    if (hash >= theta_.load(std::memory_order_relaxed) or hash == 0) return;
+    // Lock free lookup, even while the table is maintained. A key seen in an
+    // outgrown table is in the current one too, or was dropped by a rebuild.
+    if (contains(table_.load(std::memory_order_acquire), hash)) return;
+    enter();
+    // theta only changes during maintenance, which waits for us
+    const insert_result result = hash < theta_.load(std::memory_order_relaxed) ? try_insert(hash) : DUPLICATE;
+    leave();
+    if (result == INSERTED or result == DUPLICATE) return;
+    maintain();
+    if (result == INSERTED_OVER_CAPACITY) return;
+    // no empty slot, try again in the maintained table
+  }
+}
+
+template<typename A>
+typename atomic_update_theta_sketch_alloc<A>::insert_result atomic_update_theta_sketch_alloc<A>::try_insert(uint64_t hash) {
+  table* t = table_.load(std::memory_order_relaxed);
+  const uint32_t mask = (1 << t->lg_size) - 1;
+  const uint32_t stride = update_sketch::get_stride(hash, t->lg_size);
+  uint32_t cur_probe = static_cast<uint32_t>(hash) & mask;
+
+  // same probe sequence as update_theta_sketch, slots are only ever claimed
+  const uint32_t loop_index = cur_probe;
+  do {
+    uint64_t value = t->keys[cur_probe].load(std::memory_order_relaxed);
+    if (value == 0) {
+      if (t->keys[cur_probe].compare_exchange_strong(value, hash, std::memory_order_relaxed)) {
+        const uint32_t num_keys = num_keys_.fetch_add(1, std::memory_order_relaxed) + 1;
+        return num_keys > update_sketch::get_capacity(t->lg_size, lg_nom_size_) ? INSERTED_OVER_CAPACITY : INSERTED;
+      }
+      // lost the race, value is what the winner put there
+    }
+    if (value == hash) return DUPLICATE;
+    cur_probe = (cur_probe + stride) & mask;
+  } while (cur_probe != loop_index);
+  return NO_EMPTY_SLOT;
+}
+
+template<typename A>
+bool atomic_update_theta_sketch_alloc<A>::contains(const table* t, uint64_t hash) {
+  const uint32_t mask = (1 << t->lg_size) - 1;
+  const uint32_t stride = update_sketch::get_stride(hash, t->lg_size);
+  uint32_t cur_probe = static_cast<uint32_t>(hash) & mask;
+  const uint32_t loop_index = cur_probe;
+  do {
+    const uint64_t value = t->keys[cur_probe].load(std::memory_order_relaxed);
+    if (value == hash) return true;
+    if (value == 0) return false;
+    cur_probe = (cur_probe + stride) & mask;
+  } while (cur_probe != loop_index);
+  return false;
+}
+
+// Entering and maintenance are a Dekker handshake: an update announces itself in
+// active_ before it looks at maintenance_, the maintaining thread raises
+// maintenance_ before it looks at active_. Sequentially consistent operations
+// guarantee that at least one of them sees the other.
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::enter() const {
+  for (;;) {
+    active_.fetch_add(1);
+    if (!maintenance_.load()) return;
+    active_.fetch_sub(1);
+    while (maintenance_.load()) std::this_thread::yield();
+  }
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::leave() const {
+  active_.fetch_sub(1);
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::maintain() {
+  bool expected = false;
+  // somebody else is at it, the next enter() waits for them
+  if (!maintenance_.compare_exchange_strong(expected, true)) return;
+  while (active_.load() != 0) std::this_thread::yield();
+  for (;;) {
+    const uint8_t lg_size = table_.load(std::memory_order_relaxed)->lg_size;
+    if (num_keys_.load(std::memory_order_relaxed) <= update_sketch::get_capacity(lg_size, lg_nom_size_)) break;
+    if (lg_size <= lg_nom_size_) {
+      resize();
+    } else {
+      rebuild();
+    }
+  }
+  maintenance_.store(false);
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::resize() {
+  table* t = table_.load(std::memory_order_relaxed);
+  const uint32_t cur_size = 1 << t->lg_size;
+  table* new_table = allocate_table(std::min(t->lg_size + LG_RESIZE_FACTOR, lg_nom_size_ + 1), t);
+  for (uint32_t i = 0; i < cur_size; i++) {
+    const uint64_t key = t->keys[i].load(std::memory_order_relaxed);
+    if (key != 0) table_insert(key, new_table);
+  }
+  table_.store(new_table, std::memory_order_release);
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::rebuild() {
+  table* t = table_.load(std::memory_order_relaxed);
+  const uint32_t cur_size = 1 << t->lg_size;
+  const uint32_t nom_size = 1 << lg_nom_size_;
+  std::vector<uint64_t, AllocU64> keys;
+  keys.reserve(num_keys_.load(std::memory_order_relaxed));
+  for (uint32_t i = 0; i < cur_size; i++) {
+    const uint64_t key = t->keys[i].load(std::memory_order_relaxed);
+    if (key != 0) keys.push_back(key);
+  }
+  std::nth_element(keys.begin(), keys.begin() + nom_size, keys.end());
+  // only this thread writes the version, readers retry while it is odd
+  const uint32_t version = rebuild_version_.load(std::memory_order_relaxed);
+  rebuild_version_.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  theta_.store(keys[nom_size], std::memory_order_relaxed);
+  // lookups may run meanwhile, a key missed by them is inserted after maintenance
+  for (uint32_t i = 0; i < cur_size; i++) t->keys[i].store(0, std::memory_order_relaxed);
+  for (uint32_t i = 0; i < nom_size; i++) table_insert(keys[i], t);
+  num_keys_.store(nom_size, std::memory_order_relaxed);
+  rebuild_version_.store(version + 2, std::memory_order_release);
+}
+
+template<typename A>
+uint8_t atomic_update_theta_sketch_alloc<A>::starting_lg_size(uint8_t lg_nom_size) {
+  // as update_theta_sketch::builder does, so that the growth ends at lg_nom_size + 1
+  const uint8_t lg_tgt = lg_nom_size + 1;
+  const uint8_t lg_min = builder_type::MIN_LG_K;
+  return lg_tgt <= lg_min ? lg_min : ((lg_tgt - lg_min) % LG_RESIZE_FACTOR) + lg_min;
+}
+
+template<typename A>
+typename atomic_update_theta_sketch_alloc<A>::table* atomic_update_theta_sketch_alloc<A>::allocate_table(uint8_t lg_size, table* outgrown) {
+  const uint32_t size = 1 << lg_size;
+  table* t = AllocTable().allocate(1);
+  t->lg_size = lg_size;
+  t->keys = AllocAtomicU64().allocate(size);
+  for (uint32_t i = 0; i < size; i++) new (&t->keys[i]) std::atomic<uint64_t>(0);
+  t->outgrown = outgrown;
+  return t;
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::deallocate_table(table* t) {
+  while (t != nullptr) {
+    table* outgrown = t->outgrown;
+    // std::atomic<uint64_t> is trivially destructible
+    AllocAtomicU64().deallocate(t->keys, 1 << t->lg_size);
+    AllocTable().deallocate(t, 1);
+    t = outgrown;
+  }
+}
+
+template<typename A>
+void atomic_update_theta_sketch_alloc<A>::table_insert(uint64_t hash, table* t) {
+  const uint32_t mask = (1 << t->lg_size) - 1;
+  const uint32_t stride = update_sketch::get_stride(hash, t->lg_size);
+  uint32_t cur_probe = static_cast<uint32_t>(hash) & mask;
+  while (t->keys[cur_probe].load(std::memory_order_relaxed) != 0) cur_probe = (cur_probe + stride) & mask;
+  t->keys[cur_probe].store(hash, std::memory_order_relaxed);
+}
+
+} /* namespace datasketches */
+
+# endif
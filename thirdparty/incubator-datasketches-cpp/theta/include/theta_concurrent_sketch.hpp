@@ -0,0 +1,121 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THETA_CONCURRENT_SKETCH_HPP_
+#define THETA_CONCURRENT_SKETCH_HPP_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <theta_sketch.hpp>
+
+namespace datasketches {
+
+/*
+ * One update sketch shared by many writer threads.
+ *
+ * Each writer owns a local_buffer. The buffer hashes its updates and drops the
+ * hashes at or above its snapshot of the shared theta. It keeps the rest until
+ * buffer_size of them are collected, then flushes them into the shared sketch
+ * under a lock and takes a new theta snapshot. Once the sketch is in estimation
+ * mode, most updates never touch shared state.
+ *
+ * The lock free readers see what has been flushed so far. Each local buffer
+ * holds back at most buffer_size hashes.
+ */
+
+template<typename A>
+class concurrent_theta_sketch_alloc {
+public:
+  static const uint32_t DEFAULT_BUFFER_SIZE = 256;
+  class local_buffer;
+
+  // takes over a sketch made by update_theta_sketch_alloc<A>::builder, empty or not
+  explicit concurrent_theta_sketch_alloc(update_theta_sketch_alloc<A>&& sketch, uint32_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+  // lock free, as of the last flush
+  bool is_empty() const;
+  double get_estimate() const;
+  double get_theta() const;
+  uint64_t get_theta64() const;
+
+  uint16_t get_seed_hash() const;
+
+  // what the local buffers flushed so far; holds off flushes while copying
+  compact_theta_sketch_alloc<A> compact(bool ordered = true) const;
+
+private:
+  typedef typename std::allocator_traits<A>::template rebind_alloc<uint64_t> AllocU64;
+
+  mutable std::mutex mutex_;
+  update_theta_sketch_alloc<A> sketch_;
+  const uint32_t buffer_size_;
+  const uint64_t seed_;
+  std::atomic<bool> is_empty_;
+  std::atomic<uint64_t> theta_;
+  std::atomic<double> estimate_;
+
+  void flush(const uint64_t* hashes, size_t n);
+};
+
+// Buffers the updates of one thread, must not be shared between threads.
+// Flushes what is left when destroyed.
+template<typename A>
+class concurrent_theta_sketch_alloc<A>::local_buffer {
+public:
+  explicit local_buffer(concurrent_theta_sketch_alloc<A>& shared);
+  local_buffer(local_buffer&& other) noexcept;
+  ~local_buffer();
+
+  local_buffer(const local_buffer&) = delete;
+  local_buffer& operator=(const local_buffer&) = delete;
+
+  // same hashes as the update() methods of the update sketch with the same argument
+  void update(const std::string& value);
+  void update(uint64_t value);
+  void update(int64_t value);
+  void update(uint32_t value);
+  void update(int32_t value);
+  void update(double value);
+  void update(const void* data, unsigned length);
+
+  // hands the buffered hashes to the shared sketch and refreshes the theta snapshot
+  void flush();
+
+private:
+  concurrent_theta_sketch_alloc<A>* shared_;
+  uint64_t theta_;
+  // until the shared sketch is not empty, every update must reach it
+  bool shared_is_empty_;
+  std::vector<uint64_t, AllocU64> hashes_;
+
+  void insert(uint64_t hash);
+};
+
+// alias with default allocator for convenience
+typedef concurrent_theta_sketch_alloc<std::allocator<void>> concurrent_theta_sketch;
+
+} /* namespace datasketches */
+
+#include "theta_concurrent_sketch_impl.hpp"
+
+# endif
@@ -0,0 +1,158 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THETA_CONCURRENT_SKETCH_IMPL_HPP_
+#define THETA_CONCURRENT_SKETCH_IMPL_HPP_
+
+namespace datasketches {
+
+template<typename A>
+concurrent_theta_sketch_alloc<A>::concurrent_theta_sketch_alloc(update_theta_sketch_alloc<A>&& sketch, uint32_t buffer_size):
+sketch_(std::move(sketch)),
+buffer_size_(buffer_size),
+seed_(sketch_.seed_),
+is_empty_(sketch_.is_empty()),
+theta_(sketch_.get_theta64()),
+estimate_(sketch_.get_estimate())
+{
+  if (buffer_size == 0) throw std::invalid_argument("buffer size must be positive");
+}
+
+template<typename A>
+bool concurrent_theta_sketch_alloc<A>::is_empty() const {
+  return is_empty_.load(std::memory_order_acquire);
+}
+
+template<typename A>
+double concurrent_theta_sketch_alloc<A>::get_estimate() const {
+  return estimate_.load(std::memory_order_acquire);
+}
+
+template<typename A>
+double concurrent_theta_sketch_alloc<A>::get_theta() const {
+  return static_cast<double>(get_theta64()) / theta_sketch_alloc<A>::MAX_THETA;
+}
+
+template<typename A>
+uint64_t concurrent_theta_sketch_alloc<A>::get_theta64() const {
+  return theta_.load(std::memory_order_acquire);
+}
+
+template<typename A>
+uint16_t concurrent_theta_sketch_alloc<A>::get_seed_hash() const {
+  return sketch_.get_seed_hash();
+}
+
+template<typename A>
+compact_theta_sketch_alloc<A> concurrent_theta_sketch_alloc<A>::compact(bool ordered) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sketch_.compact(ordered);
+}
+
+template<typename A>
+void concurrent_theta_sketch_alloc<A>::flush(const uint64_t* hashes, size_t n) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sketch_.internal_update(hashes, n);
+  is_empty_.store(sketch_.is_empty(), std::memory_order_release);
+  theta_.store(sketch_.get_theta64(), std::memory_order_release);
+  estimate_.store(sketch_.get_estimate(), std::memory_order_release);
+}
+
+// local buffer
+
+template<typename A>
+concurrent_theta_sketch_alloc<A>::local_buffer::local_buffer(concurrent_theta_sketch_alloc<A>& shared):
+shared_(&shared),
+theta_(shared.get_theta64()),
+shared_is_empty_(shared.is_empty()),
+hashes_()
+{
+  hashes_.reserve(shared.buffer_size_);
+}
+
+template<typename A>
+concurrent_theta_sketch_alloc<A>::local_buffer::local_buffer(local_buffer&& other) noexcept:
+shared_(other.shared_),
+theta_(other.theta_),
+shared_is_empty_(other.shared_is_empty_),
+hashes_(std::move(other.hashes_))
+{
+  other.hashes_.clear();
+}
+
+template<typename A>
+concurrent_theta_sketch_alloc<A>::local_buffer::~local_buffer() {
+  flush();
+}
+
+template<typename A>
+void concurrent_theta_sketch_alloc<A>::local_buffer::update(const std::string& value) {
+  if (value.empty()) return;
+  update(value.c_str(), value.length());
+}
+
+template<typename A>
+void concurrent_theta_sketch_alloc<A>::local_buffer::update(uint64_t value) {
+  update(&value, sizeof(value));
+}
+
+template<typename A>
+void concurrent_theta_sketch_alloc<A>::local_buffer::update(int64_t value) {
+  update(&value, sizeof(value));
+}
+
+template<typename A>
+void concurrent_theta_sketch_alloc<A>::local_buffer::update(uint32_t value) {
+  update(static_cast<int32_t>(value));
+}
+
+template<typename A>
+void concurrent_theta_sketch_alloc<A>::local_buffer::update(int32_t value) {
+  update(static_cast<int64_t>(value));
+}
+
+template<typename A>
+void concurrent_theta_sketch_alloc<A>::local_buffer::update(double value) {
+  update(update_theta_sketch_alloc<A>::canonical_double(value));
+}
+
+template<typename A>
+void concurrent_theta_sketch_alloc<A>::local_buffer::update(const void* data, unsigned length) {
+  insert(update_theta_sketch_alloc<A>::compute_hash(data, length, shared_->seed_));
+}
+
+template<typename A>
+void concurrent_theta_sketch_alloc<A>::local_buffer::insert(uint64_t hash) {
+  if (hash >= theta_ and !shared_is_empty_) return;
+  hashes_.push_back(hash);
+  if (hashes_.size() >= shared_->buffer_size_) flush();
+}
+
+template<typename A>
+void concurrent_theta_sketch_alloc<A>::local_buffer::flush() {
+  if (hashes_.empty()) return;
+  shared_->flush(hashes_.data(), hashes_.size());
+  hashes_.clear();
+  theta_ = shared_->get_theta64();
+  shared_is_empty_ = shared_->is_empty();
+}
+
+} /* namespace datasketches */
+
+# endif
@@ -0,0 +1,147 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THETA_DIRECT_SKETCH_HPP_
+#define THETA_DIRECT_SKETCH_HPP_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <theta_sketch.hpp>
+
+namespace datasketches {
+
+/*
+ * Update sketch that lives in memory owned by the caller, such as a mapped file.
+ *
+ * The memory holds the serialized form of update_theta_sketch (three preamble
+ * longs followed by the whole hash table), which is also the layout the table
+ * needs for updates. So the sketch is updated in place, and the preamble is kept
+ * current after every update: the memory can be wrapped again later, or read by
+ * update_theta_sketch::deserialize(), without any conversion.
+ *
+ * When the table outgrows the memory, the sketch asks the memory_request callback
+ * for more. The callback gets the current memory, its size and the size needed,
+ * and returns memory of at least that size, 8-byte aligned, beginning with the
+ * contents of the current memory, as realloc() or mremap() do. The sketch does not
+ * use the old memory after that. Without a callback, growing past the given size
+ * throws std::runtime_error; get_max_serialized_size_bytes() is the size that
+ * never needs to grow.
+ *
+ * Resizes and rebuilds move the keys within the table itself, so updates allocate
+ * nothing besides what the callback does. The table ends up with the same keys as
+ * in update_theta_sketch, though not necessarily in the same slots.
+ *
+ * The memory is consistent between calls, not within one, including after an
+ * update that throws because the memory could not grow. It must not be updated
+ * by anything else while the sketch is alive.
+ */
+
+template<typename A>
+class direct_update_theta_sketch_alloc {
+public:
+  typedef update_theta_sketch_alloc<A> update_sketch;
+  typedef typename update_sketch::builder builder_type;
+  typedef typename update_sketch::resize_factor resize_factor;
+  typedef std::function<void*(void* mem, size_t size, size_t new_size)> memory_request;
+  // largest lg_k accepted, so sizes read from a foreign preamble cannot overflow
+  static const uint8_t MAX_LG_K = 26;
+
+  // Writes an empty sketch configured by the builder to the memory, which must be
+  // 8-byte aligned and large enough for the starting table. lg_k must not exceed MAX_LG_K.
+  static direct_update_theta_sketch_alloc<A> initialize(void* mem, size_t size, const builder_type& builder = builder_type(), memory_request request = nullptr);
+  // Takes over memory holding a serialized update sketch, from a previous instance
+  // or update_theta_sketch::serialize(). Checks the preamble and the size.
+  static direct_update_theta_sketch_alloc<A> wrap(void* mem, size_t size, uint64_t seed = builder_type::DEFAULT_SEED, memory_request request = nullptr);
+
+  direct_update_theta_sketch_alloc(direct_update_theta_sketch_alloc&&) = default;
+  direct_update_theta_sketch_alloc(const direct_update_theta_sketch_alloc&) = delete;
+  direct_update_theta_sketch_alloc& operator=(const direct_update_theta_sketch_alloc&) = delete;
+
+  // same hashes as update_theta_sketch
+  void update(const std::string& value);
+  void update(uint64_t value);
+  void update(int64_t value);
+  void update(uint32_t value);
+  void update(int32_t value);
+  void update(double value);
+  void update(const void* data, unsigned length);
+
+  bool is_empty() const;
+  double get_estimate() const;
+  double get_theta() const;
+  uint64_t get_theta64() const;
+  uint32_t get_num_retained() const;
+  uint16_t get_seed_hash() const;
+
+  compact_theta_sketch_alloc<A> compact(bool ordered = true) const;
+
+  // the memory in use, which moves when the callback returns another one
+  const void* get_memory() const;
+  // bytes of the serialized sketch, which may be less than the size of the memory
+  size_t get_serialized_size_bytes() const;
+  // bytes of the sketch once the table has reached its final size
+  static size_t get_max_serialized_size_bytes(uint8_t lg_k);
+
+private:
+  typedef typename std::allocator_traits<A>::template rebind_alloc<uint64_t> AllocU64;
+  static const uint8_t PREAMBLE_LONGS = 3;
+  // offsets of the preamble fields read or updated in place
+  static const size_t LG_NOM_SIZE_BYTE = 3;
+  static const size_t LG_CUR_SIZE_BYTE = 4;
+  static const size_t FLAGS_BYTE = 5;
+  static const size_t NUM_KEYS_INT = 8;
+  static const size_t THETA_LONG = 16;
+  // marks keys still to be moved by rehash(); keys are below theta, so this bit is free
+  static const uint64_t PENDING_BIT = static_cast<uint64_t>(1) << 63;
+
+  char* mem_;
+  size_t size_;
+  memory_request request_;
+  uint64_t* keys_;
+  uint8_t lg_cur_size_;
+  uint8_t lg_nom_size_;
+  resize_factor rf_;
+  bool is_empty_;
+  uint32_t num_keys_;
+  uint32_t capacity_;
+  uint64_t theta_;
+  uint64_t seed_;
+
+  direct_update_theta_sketch_alloc(char* mem, size_t size, memory_request request, uint64_t seed);
+
+  void internal_update(uint64_t hash);
+  void resize();
+  void rebuild();
+  void grow_memory(size_t new_size);
+  static void rehash(uint64_t* keys, uint8_t lg_size);
+  void set_lg_cur_size(uint8_t lg_cur_size);
+  static void check_alignment(const void* mem);
+  static size_t get_size_bytes(uint8_t lg_size);
+};
+
+// alias with default allocator for convenience
+typedef direct_update_theta_sketch_alloc<std::allocator<void>> direct_update_theta_sketch;
+
+} /* namespace datasketches */
+
+#include "theta_direct_sketch_impl.hpp"
+
+# endif
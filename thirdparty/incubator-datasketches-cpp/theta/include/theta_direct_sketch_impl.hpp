@@ -0,0 +1,324 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THETA_DIRECT_SKETCH_IMPL_HPP_
+#define THETA_DIRECT_SKETCH_IMPL_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "serde.hpp"
+
+namespace datasketches {
+
+template<typename A>
+direct_update_theta_sketch_alloc<A> direct_update_theta_sketch_alloc<A>::initialize(void* mem, size_t size, const builder_type& builder, memory_request request) {
+  check_alignment(mem);
+  if (builder.lg_k_ > MAX_LG_K) {
+    throw std::invalid_argument("lg_k must not be greater than " + std::to_string(MAX_LG_K) + ": " + std::to_string(builder.lg_k_));
+  }
+  const uint8_t lg_cur_size = builder_type::starting_sub_multiple(builder.lg_k_ + 1, builder_type::MIN_LG_K, static_cast<uint8_t>(builder.rf_));
+  theta_sketch_alloc<A>::check_size(size, get_size_bytes(lg_cur_size));
+
+  // the layout of update_theta_sketch::serialize()
+  char* ptr = static_cast<char*>(mem);
+  const uint8_t preamble_longs_and_rf = PREAMBLE_LONGS | (builder.rf_ << 6);
+  copy_to_mem(&preamble_longs_and_rf, &ptr, sizeof(preamble_longs_and_rf));
+  const uint8_t serial_version = theta_sketch_alloc<A>::SERIAL_VERSION;
+  copy_to_mem(&serial_version, &ptr, sizeof(serial_version));
+  const uint8_t type = update_sketch::SKETCH_TYPE;
+  copy_to_mem(&type, &ptr, sizeof(type));
+  copy_to_mem(&builder.lg_k_, &ptr, sizeof(builder.lg_k_));
+  copy_to_mem(&lg_cur_size, &ptr, sizeof(lg_cur_size));
+  const uint8_t flags_byte = 1 << theta_sketch_alloc<A>::flags::IS_EMPTY;
+  copy_to_mem(&flags_byte, &ptr, sizeof(flags_byte));
+  const uint16_t seed_hash = theta_sketch_alloc<A>::get_seed_hash(builder.seed_);
+  copy_to_mem(&seed_hash, &ptr, sizeof(seed_hash));
+  const uint32_t num_keys = 0;
+  copy_to_mem(&num_keys, &ptr, sizeof(num_keys));
+  copy_to_mem(&builder.p_, &ptr, sizeof(builder.p_));
+  uint64_t theta = theta_sketch_alloc<A>::MAX_THETA;
+  if (builder.p_ < 1) theta *= builder.p_;
+  copy_to_mem(&theta, &ptr, sizeof(theta));
+  std::fill(reinterpret_cast<uint64_t*>(ptr), reinterpret_cast<uint64_t*>(ptr) + (1 << lg_cur_size), 0);
+
+  return direct_update_theta_sketch_alloc<A>(static_cast<char*>(mem), size, std::move(request), builder.seed_);
+}
+
+template<typename A>
+direct_update_theta_sketch_alloc<A> direct_update_theta_sketch_alloc<A>::wrap(void* mem, size_t size, uint64_t seed, memory_request request) {
+  check_alignment(mem);
+  theta_sketch_alloc<A>::check_size(size, PREAMBLE_LONGS * sizeof(uint64_t));
+  const char* ptr = static_cast<const char*>(mem);
+  uint8_t preamble_longs;
+  copy_from_mem(&ptr, &preamble_longs, sizeof(preamble_longs));
+  preamble_longs &= 0x3f; // remove resize factor
+  uint8_t serial_version;
+  copy_from_mem(&ptr, &serial_version, sizeof(serial_version));
+  uint8_t type;
+  copy_from_mem(&ptr, &type, sizeof(type));
+  uint8_t lg_nom_size;
+  copy_from_mem(&ptr, &lg_nom_size, sizeof(lg_nom_size));
+  uint8_t lg_cur_size;
+  copy_from_mem(&ptr, &lg_cur_size, sizeof(lg_cur_size));
+  uint8_t flags_byte;
+  copy_from_mem(&ptr, &flags_byte, sizeof(flags_byte));
+  uint16_t seed_hash;
+  copy_from_mem(&ptr, &seed_hash, sizeof(seed_hash));
+  theta_sketch_alloc<A>::check_sketch_type(type, update_sketch::SKETCH_TYPE);
+  theta_sketch_alloc<A>::check_serial_version(serial_version, theta_sketch_alloc<A>::SERIAL_VERSION);
+  theta_sketch_alloc<A>::check_seed_hash(seed_hash, theta_sketch_alloc<A>::get_seed_hash(seed));
+  if (preamble_longs != PREAMBLE_LONGS) {
+    throw std::invalid_argument("Possible corruption: preamble longs must be " + std::to_string(PREAMBLE_LONGS) + ": " + std::to_string(preamble_longs));
+  }
+  // checked before any size is computed from them
+  if (lg_nom_size < builder_type::MIN_LG_K or lg_nom_size > MAX_LG_K or lg_cur_size < builder_type::MIN_LG_K or lg_cur_size > lg_nom_size + 1) {
+    throw std::invalid_argument("Possible corruption: lg_nom_size " + std::to_string(lg_nom_size) + ", lg_cur_size " + std::to_string(lg_cur_size));
+  }
+  theta_sketch_alloc<A>::check_size(size, get_size_bytes(lg_cur_size));
+  return direct_update_theta_sketch_alloc<A>(static_cast<char*>(mem), size, std::move(request), seed);
+}
+
+template<typename A>
+direct_update_theta_sketch_alloc<A>::direct_update_theta_sketch_alloc(char* mem, size_t size, memory_request request, uint64_t seed):
+mem_(mem),
+size_(size),
+request_(std::move(request)),
+keys_(reinterpret_cast<uint64_t*>(mem + PREAMBLE_LONGS * sizeof(uint64_t))),
+lg_cur_size_(mem[LG_CUR_SIZE_BYTE]),
+lg_nom_size_(mem[LG_NOM_SIZE_BYTE]),
+rf_(static_cast<resize_factor>(static_cast<uint8_t>(mem[0]) >> 6)),
+is_empty_(mem[FLAGS_BYTE] & (1 << theta_sketch_alloc<A>::flags::IS_EMPTY)),
+num_keys_(0),
+capacity_(update_sketch::get_capacity(lg_cur_size_, lg_nom_size_)),
+theta_(0),
+seed_(seed)
+{
+  std::memcpy(&num_keys_, mem + NUM_KEYS_INT, sizeof(num_keys_));
+  std::memcpy(&theta_, mem + THETA_LONG, sizeof(theta_));
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::update(const std::string& value) {
+  if (value.empty()) return;
+  update(value.c_str(), value.length());
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::update(uint64_t value) {
+  update(&value, sizeof(value));
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::update(int64_t value) {
+  update(&value, sizeof(value));
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::update(uint32_t value) {
+  update(static_cast<int32_t>(value));
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::update(int32_t value) {
+  update(static_cast<int64_t>(value));
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::update(double value) {
+  update(update_sketch::canonical_double(value));
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::update(const void* data, unsigned length) {
+  internal_update(update_sketch::compute_hash(data, length, seed_));
+}
+
+template<typename A>
+bool direct_update_theta_sketch_alloc<A>::is_empty() const {
+  return is_empty_;
+}
+
+template<typename A>
+double direct_update_theta_sketch_alloc<A>::get_estimate() const {
+  return num_keys_ / get_theta();
+}
+
+template<typename A>
+double direct_update_theta_sketch_alloc<A>::get_theta() const {
+  return static_cast<double>(theta_) / theta_sketch_alloc<A>::MAX_THETA;
+}
+
+template<typename A>
+uint64_t direct_update_theta_sketch_alloc<A>::get_theta64() const {
+  return theta_;
+}
+
+template<typename A>
+uint32_t direct_update_theta_sketch_alloc<A>::get_num_retained() const {
+  return num_keys_;
+}
+
+template<typename A>
+uint16_t direct_update_theta_sketch_alloc<A>::get_seed_hash() const {
+  return theta_sketch_alloc<A>::get_seed_hash(seed_);
+}
+
+template<typename A>
+compact_theta_sketch_alloc<A> direct_update_theta_sketch_alloc<A>::compact(bool ordered) const {
+  uint64_t* keys = AllocU64().allocate(num_keys_);
+  std::copy_if(keys_, &keys_[1 << lg_cur_size_], keys, [](uint64_t key) { return key != 0; });
+  if (ordered) std::sort(keys, &keys[num_keys_]);
+  return compact_theta_sketch_alloc<A>(is_empty_, theta_, keys, num_keys_, get_seed_hash(), ordered);
+}
+
+template<typename A>
+const void* direct_update_theta_sketch_alloc<A>::get_memory() const {
+  return mem_;
+}
+
+template<typename A>
+size_t direct_update_theta_sketch_alloc<A>::get_serialized_size_bytes() const {
+  return get_size_bytes(lg_cur_size_);
+}
+
+template<typename A>
+size_t direct_update_theta_sketch_alloc<A>::get_max_serialized_size_bytes(uint8_t lg_k) {
+  return get_size_bytes(lg_k + 1);
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::internal_update(uint64_t hash) {
+  if (is_empty_) {
+    is_empty_ = false;
+    mem_[FLAGS_BYTE] &= ~(1 << theta_sketch_alloc<A>::flags::IS_EMPTY);
+  }
+  if (hash >= theta_ or hash == 0) return; // hash == 0 is reserved to mark empty slots in the table
+  if (update_sketch::hash_search_or_insert(hash, keys_, lg_cur_size_)) {
+    num_keys_++;
+    // written before resize() can throw, so the count always matches the table
+    std::memcpy(mem_ + NUM_KEYS_INT, &num_keys_, sizeof(num_keys_));
+    if (num_keys_ > capacity_) {
+      if (lg_cur_size_ <= lg_nom_size_) {
+        resize();
+      } else {
+        rebuild();
+      }
+    }
+  }
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::resize() {
+  const uint32_t cur_size = 1 << lg_cur_size_;
+  const uint8_t lg_tgt_size = lg_nom_size_ + 1;
+  const uint8_t factor = std::max(1, std::min(static_cast<int>(rf_), lg_tgt_size - lg_cur_size_));
+  const uint8_t lg_new_size = lg_cur_size_ + factor;
+  // grow before touching the table, which stays as it is if the request fails
+  if (get_size_bytes(lg_new_size) > size_) grow_memory(get_size_bytes(lg_new_size));
+  // the new table starts where the old one does and extends it
+  for (uint32_t i = 0; i < cur_size; i++) {
+    if (keys_[i] != 0) keys_[i] |= PENDING_BIT;
+  }
+  std::fill(&keys_[cur_size], &keys_[1 << lg_new_size], 0);
+  rehash(keys_, lg_new_size);
+  set_lg_cur_size(lg_new_size);
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::rebuild() {
+  const uint32_t cur_size = 1 << lg_cur_size_;
+  const uint32_t nom_size = 1 << lg_nom_size_;
+  // same steps as update_theta_sketch::rebuild()
+  uint32_t num_keys = 0;
+  for (uint32_t i = 0; i < cur_size; i++) {
+    if (keys_[i] != 0) keys_[num_keys++] = keys_[i];
+  }
+  std::nth_element(&keys_[0], &keys_[nom_size], &keys_[num_keys]);
+  theta_ = keys_[nom_size];
+  for (uint32_t i = 0; i < nom_size; i++) keys_[i] |= PENDING_BIT;
+  std::fill(&keys_[nom_size], &keys_[cur_size], 0);
+  rehash(keys_, lg_cur_size_);
+  num_keys_ = nom_size;
+  std::memcpy(mem_ + NUM_KEYS_INT, &num_keys_, sizeof(num_keys_));
+  std::memcpy(mem_ + THETA_LONG, &theta_, sizeof(theta_));
+}
+
+// Moves every pending key to a slot of its own probe sequence in the table.
+// A key takes the first slot that is empty or holds another pending key, which
+// then moves in turn. Slots before that one on the sequence hold keys already
+// moved, which stay put, so every moved key is found where hash_search() looks.
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::rehash(uint64_t* keys, uint8_t lg_size) {
+  const uint32_t size = 1 << lg_size;
+  const uint32_t mask = size - 1;
+  for (uint32_t i = 0; i < size; i++) {
+    if (!(keys[i] & PENDING_BIT)) continue;
+    uint64_t key = keys[i] & ~PENDING_BIT;
+    keys[i] = 0;
+    while (key != 0) {
+      const uint32_t stride = update_sketch::get_stride(key, lg_size);
+      uint32_t cur_probe = static_cast<uint32_t>(key) & mask;
+      while (keys[cur_probe] != 0 and !(keys[cur_probe] & PENDING_BIT)) cur_probe = (cur_probe + stride) & mask;
+      const uint64_t displaced = keys[cur_probe] & ~PENDING_BIT;
+      keys[cur_probe] = key;
+      key = displaced;
+    }
+  }
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::grow_memory(size_t new_size) {
+  if (!request_) {
+    throw std::runtime_error("Sketch memory is full: " + std::to_string(size_) + " bytes, " + std::to_string(new_size) + " needed");
+  }
+  void* mem = request_(mem_, size_, new_size);
+  if (mem == nullptr) {
+    throw std::runtime_error("Memory request of " + std::to_string(new_size) + " bytes failed");
+  }
+  check_alignment(mem);
+  mem_ = static_cast<char*>(mem);
+  size_ = new_size;
+  keys_ = reinterpret_cast<uint64_t*>(mem_ + PREAMBLE_LONGS * sizeof(uint64_t));
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::set_lg_cur_size(uint8_t lg_cur_size) {
+  lg_cur_size_ = lg_cur_size;
+  capacity_ = update_sketch::get_capacity(lg_cur_size_, lg_nom_size_);
+  mem_[LG_CUR_SIZE_BYTE] = lg_cur_size_;
+}
+
+template<typename A>
+void direct_update_theta_sketch_alloc<A>::check_alignment(const void* mem) {
+  if (reinterpret_cast<uintptr_t>(mem) % sizeof(uint64_t) != 0) {
+    throw std::invalid_argument("Sketch memory must be 8-byte aligned");
+  }
+}
+
+template<typename A>
+size_t direct_update_theta_sketch_alloc<A>::get_size_bytes(uint8_t lg_size) {
+  return sizeof(uint64_t) * (PREAMBLE_LONGS + (static_cast<size_t>(1) << lg_size));
+}
+
+} /* namespace datasketches */
+
+# endif
@@ -23,8 +23,11 @@
 #include <memory>
 #include <functional>
 #include <climits>
+#include <istream>
+#include <mutex>
 
 #include <theta_sketch.hpp>
+#include <theta_sorted_set.hpp>
 
 namespace datasketches {
 
@@ -46,7 +49,46 @@ public:
   theta_intersection_alloc<A>& operator=(theta_intersection_alloc<A>&& other);
 
   void update(const theta_sketch_alloc<A>& sketch);
-  compact_theta_sketch_alloc<A> get_result(bool ordered = true) const;
+
+  /**
+   * Updates the intersection with a serialized sketch without deserializing it up front.
+   * Once the intersection holds no keys, only the preamble (theta, empty flag, seed hash) is read.
+   * Otherwise 8-byte aligned compact sketches are read in place through a compact_theta_sketch_view,
+   * and compressed compact sketches are decoded a block at a time while they are merged with
+   * or probe the state. Anything else, and the first sketch, is deserialized.
+   * @param bytes serialized compact or update sketch
+   * @param size size of the serialized sketch in bytes
+   */
+  void update(const void* bytes, size_t size);
+
+  /**
+   * Updates the intersection with a sketch read from a stream, without deserializing it:
+   * the keys go through a buffer of a block and are merged with or probe the state as they
+   * are read, and the keys of an ordered sketch from theta on are skipped without being
+   * decoded. The stream is left past the end of the sketch.
+   * @param is stream at the start of a serialized compact or update sketch
+   */
+  void update(std::istream& is);
+  /**
+   * Updates the intersection with a range of sketches or views, in the order that
+   * costs least rather than the given one. The preambles are checked first: the
+   * lowest theta applies before any key is read, and an empty input ends it there.
+   * The sketches then go smallest first, so that the state is as small as it gets
+   * from the first step on, and the rest is skipped once it has no keys left.
+   * Ordered inputs are merged with the state, the others probe it.
+   * @param first, last range of objects usable as const theta_sketch_alloc<A>&
+   */
+  template<typename InputIt>
+  void intersect(InputIt first, InputIt last);
+  /**
+   * The result is built on the first call and kept until the next update,
+   * so that repeated calls neither copy nor allocate. Each ordering has its own
+   * result, asking for the other ordering does not change one already returned.
+   * Concurrent calls to get_result() and has_result() are safe, but not concurrently
+   * with an update, copy or assignment of the intersection.
+   * @return reference to the result, valid until the next update or until the intersection is destroyed
+   */
+  const compact_theta_sketch_alloc<A>& get_result(bool ordered = true) const;
   bool has_result() const;
 
 private:
@@ -54,10 +96,34 @@ private:
   bool is_valid_;
   bool is_empty_;
   uint64_t theta_;
+  // While the inputs are ordered, keys_ holds num_keys_ ascending keys and each
+  // update is a merge. Otherwise it is a hash table of 1 << lg_size_ slots.
+  bool is_ordered_;
   uint8_t lg_size_;
   uint64_t* keys_;
+  // slots allocated in keys_
+  uint32_t capacity_;
   uint32_t num_keys_;
   uint16_t seed_hash_;
+  uint64_t seed_;
+  // results of get_result(), by ordering, built under result_mutex_
+  mutable compact_theta_sketch_alloc<A> ordered_result_;
+  mutable compact_theta_sketch_alloc<A> unordered_result_;
+  mutable bool is_ordered_result_cached_;
+  mutable bool is_unordered_result_cached_;
+  mutable std::mutex result_mutex_;
+
+  void deallocate_keys();
+  void reset_results();
+  void build_result(compact_theta_sketch_alloc<A>& result, bool ordered) const;
+  void to_hash_table();
+  // the state becomes a hash table of the given keys, reusing the table if it has the right size
+  void rebuild_hash_table(const uint64_t* keys, uint32_t num_keys);
+  // intersects with a serialized compressed compact sketch, from the second long of its preamble on
+  void update_packed(const char* ptr, size_t size, uint8_t preamble_longs, uint8_t flags_byte);
+  // intersects with the keys that reader.next() returns a block at a time, ascending if ordered
+  template<typename Reader>
+  void intersect_blocks(Reader& reader, uint32_t num_keys, bool ordered);
 };
 
 // alias with default allocator for convenience
@@ -21,6 +21,7 @@
 #define THETA_INTERSECTION_IMPL_HPP_
 
 #include <algorithm>
+#include <vector>
 
 namespace datasketches {
 
@@ -35,10 +36,18 @@ theta_intersection_alloc<A>::theta_intersection_alloc(uint64_t seed):
 is_valid_(false),
 is_empty_(false),
 theta_(theta_sketch_alloc<A>::MAX_THETA),
+is_ordered_(false),
 lg_size_(0),
 keys_(nullptr),
+capacity_(0),
 num_keys_(0),
-seed_hash_(theta_sketch_alloc<A>::get_seed_hash(seed))
+seed_hash_(theta_sketch_alloc<A>::get_seed_hash(seed)),
+seed_(seed),
+ordered_result_(false, theta_sketch_alloc<A>::MAX_THETA, nullptr, 0, seed_hash_, true),
+unordered_result_(false, theta_sketch_alloc<A>::MAX_THETA, nullptr, 0, seed_hash_, false),
+is_ordered_result_cached_(false),
+is_unordered_result_cached_(false),
+result_mutex_()
 {}
 
 template<typename A>
@@ -46,12 +55,20 @@ theta_intersection_alloc<A>::theta_intersection_alloc(const theta_intersection_a
 is_valid_(other.is_valid_),
 is_empty_(other.is_empty_),
 theta_(other.theta_),
+is_ordered_(other.is_ordered_),
 lg_size_(other.lg_size_),
-keys_(other.keys_ == nullptr ? nullptr : AllocU64().allocate(1 << lg_size_)),
+keys_(other.keys_ == nullptr ? nullptr : AllocU64().allocate(other.capacity_)),
+capacity_(other.capacity_),
 num_keys_(other.num_keys_),
-seed_hash_(other.seed_hash_)
+seed_hash_(other.seed_hash_),
+seed_(other.seed_),
+ordered_result_(other.ordered_result_),
+unordered_result_(other.unordered_result_),
+is_ordered_result_cached_(other.is_ordered_result_cached_),
+is_unordered_result_cached_(other.is_unordered_result_cached_),
+result_mutex_()
 {
-  if (keys_ != nullptr) std::copy(other.keys_, &other.keys_[1 << lg_size_], keys_);
+  if (keys_ != nullptr) std::copy(other.keys_, &other.keys_[capacity_], keys_);
 }
 
 template<typename A>
@@ -59,24 +76,34 @@ theta_intersection_alloc<A>::theta_intersection_alloc(theta_intersection_alloc<A
 is_valid_(false),
 is_empty_(false),
 theta_(theta_sketch_alloc<A>::MAX_THETA),
+is_ordered_(false),
 lg_size_(0),
 keys_(nullptr),
+capacity_(0),
 num_keys_(0),
-seed_hash_(other.seed_hash_)
+seed_hash_(other.seed_hash_),
+seed_(other.seed_),
+ordered_result_(std::move(other.ordered_result_)),
+unordered_result_(std::move(other.unordered_result_)),
+is_ordered_result_cached_(false),
+is_unordered_result_cached_(false),
+result_mutex_()
 {
+  std::swap(is_ordered_result_cached_, other.is_ordered_result_cached_);
+  std::swap(is_unordered_result_cached_, other.is_unordered_result_cached_);
   std::swap(is_valid_, other.is_valid_);
   std::swap(is_empty_, other.is_empty_);
   std::swap(theta_, other.theta_);
+  std::swap(is_ordered_, other.is_ordered_);
   std::swap(lg_size_, other.lg_size_);
   std::swap(keys_, other.keys_);
+  std::swap(capacity_, other.capacity_);
   std::swap(num_keys_, other.num_keys_);
 }
 
 template<typename A>
 theta_intersection_alloc<A>::~theta_intersection_alloc() {
-  if (keys_ != nullptr) {
-    AllocU64().deallocate(keys_, 1 << lg_size_);
-  }
+  deallocate_keys();
 }
 
 template<typename A>
@@ -84,10 +111,17 @@ theta_intersection_alloc<A>& theta_intersection_alloc<A>::operator=(theta_inters
   std::swap(is_valid_, other.is_valid_);
   std::swap(is_empty_, other.is_empty_);
   std::swap(theta_, other.theta_);
+  std::swap(is_ordered_, other.is_ordered_);
   std::swap(lg_size_, other.lg_size_);
   std::swap(keys_, other.keys_);
+  std::swap(capacity_, other.capacity_);
   std::swap(num_keys_, other.num_keys_);
   std::swap(seed_hash_, other.seed_hash_);
+  std::swap(seed_, other.seed_);
+  std::swap(ordered_result_, other.ordered_result_);
+  std::swap(unordered_result_, other.unordered_result_);
+  std::swap(is_ordered_result_cached_, other.is_ordered_result_cached_);
+  std::swap(is_unordered_result_cached_, other.is_unordered_result_cached_);
   return *this;
 }
 
@@ -96,38 +130,59 @@ theta_intersection_alloc<A>& theta_intersection_alloc<A>::operator=(theta_inters
   std::swap(is_valid_, other.is_valid_);
   std::swap(is_empty_, other.is_empty_);
   std::swap(theta_, other.theta_);
+  std::swap(is_ordered_, other.is_ordered_);
   std::swap(lg_size_, other.lg_size_);
   std::swap(keys_, other.keys_);
+  std::swap(capacity_, other.capacity_);
   std::swap(num_keys_, other.num_keys_);
   std::swap(seed_hash_, other.seed_hash_);
+  std::swap(seed_, other.seed_);
+  std::swap(ordered_result_, other.ordered_result_);
+  std::swap(unordered_result_, other.unordered_result_);
+  std::swap(is_ordered_result_cached_, other.is_ordered_result_cached_);
+  std::swap(is_unordered_result_cached_, other.is_unordered_result_cached_);
   return *this;
 }
 
 template<typename A>
 void theta_intersection_alloc<A>::update(const theta_sketch_alloc<A>& sketch) {
   if (is_empty_) return;
+  reset_results();
   if (sketch.get_seed_hash() != seed_hash_) throw std::invalid_argument("seed hash mismatch");
   is_empty_ |= sketch.is_empty();
   theta_ = std::min(theta_, sketch.get_theta64());
   if (is_valid_ and num_keys_ == 0) return;
   if (sketch.get_num_retained() == 0) {
     is_valid_ = true;
-    if (keys_ != nullptr) {
-      AllocU64().deallocate(keys_, 1 << lg_size_);
-      keys_ = nullptr;
-      lg_size_ = 0;
-      num_keys_ = 0;
-    }
+    deallocate_keys();
     return;
   }
   if (!is_valid_) { // first update, clone incoming sketch
     is_valid_ = true;
-    lg_size_ = lg_size_from_count(sketch.get_num_retained(), update_theta_sketch_alloc<A>::REBUILD_THRESHOLD);
-    keys_ = AllocU64().allocate(1 << lg_size_);
-    std::fill(keys_, &keys_[1 << lg_size_], 0);
     num_keys_ = sketch.get_num_retained();
-    for (auto key: sketch) update_theta_sketch_alloc<A>::hash_search_or_insert(key, keys_, lg_size_);
-  } else { // intersection
+    // theta may be lower than the one of the sketch already, see intersect()
+    if (sketch.is_ordered()) {
+      is_ordered_ = true;
+      capacity_ = num_keys_;
+      keys_ = AllocU64().allocate(capacity_);
+      const uint64_t* keys = theta_sketch_alloc<A>::get_ordered_keys(sketch);
+      num_keys_ = std::lower_bound(keys, &keys[num_keys_], theta_) - keys;
+      std::copy(keys, &keys[num_keys_], keys_);
+    } else {
+      lg_size_ = lg_size_from_count(num_keys_, update_theta_sketch_alloc<A>::REBUILD_THRESHOLD);
+      capacity_ = 1 << lg_size_;
+      keys_ = AllocU64().allocate(capacity_);
+      std::fill(keys_, &keys_[capacity_], 0);
+      num_keys_ = 0;
+      for (auto key: sketch) {
+        if (key < theta_) num_keys_ += update_theta_sketch_alloc<A>::hash_search_or_insert(key, keys_, lg_size_);
+      }
+    }
+  } else if (is_ordered_ and sketch.is_ordered()) {
+    // merge in place, the array only shrinks
+    num_keys_ = sorted_set_intersection(keys_, num_keys_, theta_sketch_alloc<A>::get_ordered_keys(sketch), sketch.get_num_retained(), theta_, keys_);
+  } else { // intersection through the hash table
+    if (is_ordered_) to_hash_table();
     const uint32_t max_matches = std::min(num_keys_, sketch.get_num_retained());
     uint64_t* matched_keys = AllocU64().allocate(max_matches);
     uint32_t match_count = 0;
@@ -137,6 +192,7 @@ void theta_intersection_alloc<A>::update(const theta_sketch_alloc<A>& sketch) {
             if (match_count >= max_matches) {
                 // match_keys was allocated for max_matches elements
                 // writing at matched_keys[max_match and beyond] is unsafe
+                AllocU64().deallocate(matched_keys, max_matches);
                 throw std::invalid_argument("Too many keys to update, corrupted sketch?");
             } else {
                 matched_keys[match_count++] = key;
@@ -147,37 +203,298 @@ void theta_intersection_alloc<A>::update(const theta_sketch_alloc<A>& sketch) {
         break; // early stop
       }
     }
-    if (match_count == 0) {
-      AllocU64().deallocate(keys_, 1 << lg_size_);
-      keys_ = nullptr;
-      lg_size_ = 0;
+    if (sketch.is_ordered() or match_count == 0) {
+      // the matches come out ascending, back to merging with them as the state
+      deallocate_keys();
+      is_ordered_ = true;
+      keys_ = matched_keys;
+      capacity_ = max_matches;
+      num_keys_ = match_count;
+    } else {
+      rebuild_hash_table(matched_keys, match_count);
+      AllocU64().deallocate(matched_keys, max_matches);
+    }
+  }
+  if (num_keys_ == 0) {
+    deallocate_keys();
+    if (theta_ == theta_sketch_alloc<A>::MAX_THETA) is_empty_ = true;
+  }
+}
+
+template<typename A>
+void theta_intersection_alloc<A>::update(const void* bytes, size_t size) {
+  if (is_empty_) return;
+  reset_results();
+  theta_sketch_alloc<A>::check_size(size, 8);
+  const char* ptr = static_cast<const char*>(bytes);
+  uint8_t preamble_longs;
+  copy_from_mem(&ptr, &preamble_longs, sizeof(preamble_longs));
+  uint8_t serial_version;
+  copy_from_mem(&ptr, &serial_version, sizeof(serial_version));
+  uint8_t type;
+  copy_from_mem(&ptr, &type, sizeof(type));
+  uint8_t lg_nom_size;
+  copy_from_mem(&ptr, &lg_nom_size, sizeof(lg_nom_size));
+  uint8_t lg_cur_size;
+  copy_from_mem(&ptr, &lg_cur_size, sizeof(lg_cur_size));
+  uint8_t flags_byte;
+  copy_from_mem(&ptr, &flags_byte, sizeof(flags_byte));
+  uint16_t seed_hash;
+  copy_from_mem(&ptr, &seed_hash, sizeof(seed_hash));
+
+  if (type == compact_theta_sketch_alloc<A>::SKETCH_TYPE) {
+    compact_theta_sketch_alloc<A>::check_compact_serial_version(serial_version);
+  } else {
+    theta_sketch_alloc<A>::check_serial_version(serial_version, theta_sketch_alloc<A>::SERIAL_VERSION);
+  }
+  theta_sketch_alloc<A>::check_seed_hash(seed_hash, seed_hash_);
+  if (type != update_theta_sketch_alloc<A>::SKETCH_TYPE && type != compact_theta_sketch_alloc<A>::SKETCH_TYPE) {
+    throw std::invalid_argument("unsupported sketch type " + std::to_string((int) type));
+  }
+
+  if (is_valid_ and num_keys_ == 0) {
+    // no keys can be gained anymore, only theta and the empty flag matter
+    const bool is_empty = flags_byte & (1 << theta_sketch_alloc<A>::flags::IS_EMPTY);
+    uint64_t theta = theta_sketch_alloc<A>::MAX_THETA;
+    // theta follows num_keys and p in the second preamble long when present
+    if (type == update_theta_sketch_alloc<A>::SKETCH_TYPE || (!is_empty && preamble_longs > 2)) {
+      theta_sketch_alloc<A>::check_size(size, 24);
+      ptr += 8;
+      copy_from_mem(&ptr, &theta, sizeof(theta));
+    }
+    is_empty_ |= is_empty;
+    theta_ = std::min(theta_, theta);
+    return;
+  }
+
+  const size_t remaining = size - (ptr - static_cast<const char*>(bytes));
+  if (type == update_theta_sketch_alloc<A>::SKETCH_TYPE) {
+    typename update_theta_sketch_alloc<A>::resize_factor rf = static_cast<typename update_theta_sketch_alloc<A>::resize_factor>(preamble_longs >> 6);
+    update(update_theta_sketch_alloc<A>::internal_deserialize(ptr, remaining, rf, lg_cur_size, lg_nom_size, flags_byte, seed_));
+  } else if (serial_version == theta_sketch_alloc<A>::SERIAL_VERSION_COMPRESSED and is_valid_) {
+    update_packed(ptr, remaining, preamble_longs, flags_byte);
+  } else if (serial_version == theta_sketch_alloc<A>::SERIAL_VERSION and reinterpret_cast<uintptr_t>(bytes) % sizeof(uint64_t) == 0) {
+    update(compact_theta_sketch_view_alloc<A>(bytes, size, seed_));
+  } else {
+    update(compact_theta_sketch_alloc<A>::internal_deserialize(ptr, remaining, serial_version, preamble_longs, flags_byte, seed_hash));
+  }
+}
+
+template<typename A>
+void theta_intersection_alloc<A>::update_packed(const char* ptr, size_t size, uint8_t preamble_longs, uint8_t flags_byte) {
+  // the rest of the preamble, as compact_theta_sketch_alloc<A>::internal_deserialize() reads it
+  const char* const begin = ptr;
+  const bool is_empty = flags_byte & (1 << theta_sketch_alloc<A>::flags::IS_EMPTY);
+  uint32_t num_keys = 0;
+  uint64_t theta = theta_sketch_alloc<A>::MAX_THETA;
+  if (!is_empty) {
+    if (preamble_longs == 1) {
+      num_keys = 1;
+    } else {
+      theta_sketch_alloc<A>::check_size(size, 8);
+      copy_from_mem(&ptr, &num_keys, sizeof(num_keys));
+      ptr += sizeof(uint32_t);
+      if (preamble_longs > 2) {
+        theta_sketch_alloc<A>::check_size(size, 16);
+        copy_from_mem(&ptr, &theta, sizeof(theta));
+      }
+    }
+    compact_theta_sketch_alloc<A>::check_packed_keys(ptr, size - (ptr - begin), num_keys);
+  }
+  is_empty_ |= is_empty;
+  theta_ = std::min(theta_, theta);
+  if (num_keys == 0) {
+    deallocate_keys();
+    return;
+  }
+
+  packed_keys_reader reader(ptr, num_keys);
+  intersect_blocks(reader, num_keys, true);
+  if (num_keys_ == 0) {
+    deallocate_keys();
+    if (theta_ == theta_sketch_alloc<A>::MAX_THETA) is_empty_ = true;
+  }
+}
+
+template<typename A>
+void theta_intersection_alloc<A>::update(std::istream& is) {
+  typename theta_sketch_alloc<A>::stream_key_reader reader(is, seed_hash_);
+  if (is_empty_) {
+    reader.skip();
+    return;
+  }
+  reset_results();
+  is_empty_ |= reader.is_empty();
+  theta_ = std::min(theta_, reader.get_theta64());
+  if (is_valid_ and num_keys_ == 0) {
+    reader.skip();
+    return;
+  }
+  if (reader.get_num_retained() == 0) {
+    is_valid_ = true;
+    deallocate_keys();
+    reader.skip();
+    return;
+  }
+  if (!is_valid_) { // first update, the state is built from the keys below theta
+    is_valid_ = true;
+    uint64_t block[theta_sketch_alloc<A>::stream_key_reader::BLOCK_SIZE];
+    if (reader.is_ordered()) {
+      is_ordered_ = true;
+      capacity_ = reader.get_num_retained();
+      keys_ = AllocU64().allocate(capacity_);
       num_keys_ = 0;
-      if (theta_ == theta_sketch_alloc<A>::MAX_THETA) is_empty_ = true;
+      for (uint32_t count = reader.next(block); count > 0 and block[0] < theta_; count = reader.next(block)) {
+        for (uint32_t i = 0; i < count and block[i] < theta_; i++) keys_[num_keys_++] = block[i];
+      }
     } else {
-      const uint8_t lg_size = lg_size_from_count(match_count, update_theta_sketch_alloc<A>::REBUILD_THRESHOLD);
-      if (lg_size != lg_size_) {
-        AllocU64().deallocate(keys_, 1 << lg_size_);
-        lg_size_ = lg_size;
-        keys_ = AllocU64().allocate(1 << lg_size_);
-        std::fill(keys_, &keys_[1 << lg_size_], 0);
+      lg_size_ = lg_size_from_count(reader.get_num_retained(), update_theta_sketch_alloc<A>::REBUILD_THRESHOLD);
+      capacity_ = 1 << lg_size_;
+      keys_ = AllocU64().allocate(capacity_);
+      std::fill(keys_, &keys_[capacity_], 0);
+      num_keys_ = 0;
+      for (uint32_t count = reader.next(block); count > 0; count = reader.next(block)) {
+        for (uint32_t i = 0; i < count; i++) {
+          if (block[i] < theta_) num_keys_ += update_theta_sketch_alloc<A>::hash_search_or_insert(block[i], keys_, lg_size_);
+        }
+      }
+    }
+  } else {
+    intersect_blocks(reader, reader.get_num_retained(), reader.is_ordered());
+  }
+  reader.skip();
+  if (num_keys_ == 0) {
+    deallocate_keys();
+    if (theta_ == theta_sketch_alloc<A>::MAX_THETA) is_empty_ = true;
+  }
+}
+
+template<typename A>
+template<typename Reader>
+void theta_intersection_alloc<A>::intersect_blocks(Reader& reader, uint32_t num_keys, bool ordered) {
+  // same as update() with a sketch, reading the keys a block at a time until theta
+  // or, while merging, the end of the state
+  if (is_ordered_ and !ordered) to_hash_table();
+  const uint32_t max_matches = std::min(num_keys_, num_keys);
+  uint64_t* matched_keys = is_ordered_ ? keys_ : AllocU64().allocate(max_matches);
+  uint32_t match_count = 0;
+  uint32_t index = 0;
+  uint64_t block[theta_sketch_alloc<A>::stream_key_reader::BLOCK_SIZE];
+  bool done = false;
+  while (!done) {
+    const uint32_t count = reader.next(block);
+    if (count == 0) break;
+    for (uint32_t i = 0; i < count; i++) {
+      const uint64_t key = block[i];
+      if (key >= theta_) {
+        if (!ordered) continue;
+        done = true;
+        break;
       }
-      for (uint32_t i = 0; i < match_count; i++) {
-        update_theta_sketch_alloc<A>::hash_search_or_insert(matched_keys[i], keys_, lg_size_);
+      if (is_ordered_) {
+        while (index < num_keys_ and keys_[index] < key) index++;
+        if (index == num_keys_) {
+          done = true;
+          break;
+        }
+        if (keys_[index] == key) matched_keys[match_count++] = keys_[index++];
+      } else if (update_theta_sketch_alloc<A>::hash_search(key, keys_, lg_size_)) {
+        if (match_count == max_matches) {
+          AllocU64().deallocate(matched_keys, max_matches);
+          throw std::invalid_argument("Too many keys to update, corrupted sketch?");
+        }
+        matched_keys[match_count++] = key;
       }
-      num_keys_ = match_count;
     }
+  }
+  if (is_ordered_) {
+    num_keys_ = match_count;
+  } else if (ordered or match_count == 0) {
+    // the matches come out ascending, back to merging with them as the state
+    deallocate_keys();
+    is_ordered_ = true;
+    keys_ = matched_keys;
+    capacity_ = max_matches;
+    num_keys_ = match_count;
+  } else {
+    rebuild_hash_table(matched_keys, match_count);
     AllocU64().deallocate(matched_keys, max_matches);
   }
 }
 
 template<typename A>
-compact_theta_sketch_alloc<A> theta_intersection_alloc<A>::get_result(bool ordered) const {
+template<typename InputIt>
+void theta_intersection_alloc<A>::intersect(InputIt first, InputIt last) {
+  if (is_empty_) return;
+  typedef typename std::allocator_traits<A>::template rebind_alloc<const theta_sketch_alloc<A>*> AllocSketchPtr;
+  std::vector<const theta_sketch_alloc<A>*, AllocSketchPtr> sketches;
+  for (; first != last; ++first) {
+    const theta_sketch_alloc<A>& sketch = *first;
+    if (sketch.get_seed_hash() != seed_hash_) throw std::invalid_argument("seed hash mismatch");
+    sketches.push_back(&sketch);
+  }
+  if (sketches.empty()) return;
+  reset_results();
+  for (const theta_sketch_alloc<A>* sketch: sketches) {
+    if (sketch->is_empty()) {
+      update(*sketch);
+      return;
+    }
+    theta_ = std::min(theta_, sketch->get_theta64());
+  }
+  // by the keys expected below the common theta
+  const double theta = theta_;
+  auto keys_below_theta = [theta](const theta_sketch_alloc<A>* sketch) {
+    if (sketch->get_num_retained() == 0) return 0.0;
+    return sketch->get_num_retained() * (theta / sketch->get_theta64());
+  };
+  std::stable_sort(sketches.begin(), sketches.end(), [&keys_below_theta](const theta_sketch_alloc<A>* a, const theta_sketch_alloc<A>* b) {
+    return keys_below_theta(a) < keys_below_theta(b);
+  });
+  // past the smallest, ordered inputs only cost a merge or a gallop against the state,
+  // unordered ones are scanned in full whatever their rank, so they go last
+  std::stable_partition(sketches.begin() + 1, sketches.end(), [](const theta_sketch_alloc<A>* sketch) {
+    return sketch->is_ordered();
+  });
+  for (const theta_sketch_alloc<A>* sketch: sketches) {
+    update(*sketch);
+    if (num_keys_ == 0) break; // theta and the empty flag are final already
+  }
+}
+
+template<typename A>
+const compact_theta_sketch_alloc<A>& theta_intersection_alloc<A>::get_result(bool ordered) const {
   if (!is_valid_) throw std::invalid_argument("calling get_result() before calling update() is undefined");
-  if (num_keys_ == 0) return compact_theta_sketch_alloc<A>(is_empty_, theta_, nullptr, 0, seed_hash_, ordered);
-  uint64_t* keys = AllocU64().allocate(num_keys_);
-  std::copy_if(keys_, &keys_[1 << lg_size_], keys, [](uint64_t key) { return key != 0; });
-  if (ordered) std::sort(keys, &keys[num_keys_]);
-  return compact_theta_sketch_alloc<A>(false, this->theta_, keys, num_keys_, seed_hash_, ordered);
+  std::lock_guard<std::mutex> lock(result_mutex_);
+  compact_theta_sketch_alloc<A>& result = ordered ? ordered_result_ : unordered_result_;
+  bool& is_cached = ordered ? is_ordered_result_cached_ : is_unordered_result_cached_;
+  if (!is_cached) {
+    build_result(result, ordered);
+    is_cached = true;
+  }
+  return result;
+}
+
+template<typename A>
+void theta_intersection_alloc<A>::build_result(compact_theta_sketch_alloc<A>& result, bool ordered) const {
+  // the keys of the previous result of this ordering are overwritten if the count did not change
+  if (result.keys_ == nullptr or result.num_keys_ != num_keys_) {
+    AllocU64().deallocate(result.keys_, result.num_keys_);
+    result.keys_ = nullptr;
+    result.num_keys_ = 0;
+    if (num_keys_ > 0) result.keys_ = AllocU64().allocate(num_keys_);
+    result.num_keys_ = num_keys_;
+  }
+  if (is_ordered_) {
+    std::copy(keys_, &keys_[num_keys_], result.keys_);
+  } else if (num_keys_ > 0) {
+    std::copy_if(keys_, &keys_[capacity_], result.keys_, [](uint64_t key) { return key != 0; });
+    if (ordered) std::sort(result.keys_, &result.keys_[num_keys_]);
+  }
+  result.is_empty_ = num_keys_ == 0 and is_empty_;
+  result.theta_ = theta_;
+  result.seed_hash_ = seed_hash_;
+  result.is_ordered_ = ordered;
 }
 
 template<typename A>
@@ -185,6 +502,54 @@ bool theta_intersection_alloc<A>::has_result() const {
   return is_valid_;
 }
 
+template<typename A>
+void theta_intersection_alloc<A>::reset_results() {
+  is_ordered_result_cached_ = false;
+  is_unordered_result_cached_ = false;
+}
+
+template<typename A>
+void theta_intersection_alloc<A>::deallocate_keys() {
+  if (keys_ != nullptr) AllocU64().deallocate(keys_, capacity_);
+  keys_ = nullptr;
+  is_ordered_ = false;
+  lg_size_ = 0;
+  capacity_ = 0;
+  num_keys_ = 0;
+}
+
+template<typename A>
+void theta_intersection_alloc<A>::to_hash_table() {
+  const uint32_t num_keys = num_keys_;
+  // only probed from here on, one more doubling keeps the probe chains of misses short
+  const uint8_t lg_size = lg_size_from_count(num_keys, update_theta_sketch_alloc<A>::REBUILD_THRESHOLD) + 1;
+  uint64_t* keys = AllocU64().allocate(1 << lg_size);
+  std::fill(keys, &keys[1 << lg_size], 0);
+  for (uint32_t i = 0; i < num_keys; i++) update_theta_sketch_alloc<A>::hash_insert(keys_[i], keys, lg_size);
+  deallocate_keys();
+  lg_size_ = lg_size;
+  keys_ = keys;
+  capacity_ = 1 << lg_size;
+  num_keys_ = num_keys;
+}
+
+template<typename A>
+void theta_intersection_alloc<A>::rebuild_hash_table(const uint64_t* keys, uint32_t num_keys) {
+  const uint8_t lg_size = lg_size_from_count(num_keys, update_theta_sketch_alloc<A>::REBUILD_THRESHOLD);
+  if (lg_size != lg_size_) {
+    deallocate_keys();
+    lg_size_ = lg_size;
+    capacity_ = 1 << lg_size_;
+    keys_ = AllocU64().allocate(capacity_);
+  }
+  // the table is reused if the size did not change, keys that did not match must go
+  std::fill(keys_, &keys_[capacity_], 0);
+  for (uint32_t i = 0; i < num_keys; i++) {
+    update_theta_sketch_alloc<A>::hash_search_or_insert(keys[i], keys_, lg_size_);
+  }
+  num_keys_ = num_keys;
+}
+
 } /* namespace datasketches */
 
 # endif
@@ -0,0 +1,192 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THETA_PACKED_KEYS_HPP_
+#define THETA_PACKED_KEYS_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace datasketches {
+
+/*
+ * The keys of the compressed compact serial version: ascending keys stored as
+ * the deltas between consecutive keys (the first one from 0), in blocks of
+ * PACKED_KEYS_BLOCK_SIZE. All deltas of a block are packed with the width of the
+ * largest one, so that a block decodes without a branch per value, and is read
+ * one block at a time.
+ *
+ * Layout, little-endian like the rest of the serialized sketch:
+ *   one width byte per block, padded with zeros to a multiple of 8 bytes
+ *   per block, the deltas at bit i * width of its 64-bit words, which take
+ *   (count * width + 63) / 64 words for count deltas
+ *
+ * Keys are below theta, so deltas have 1 to 63 bits.
+ */
+
+static const uint32_t PACKED_KEYS_BLOCK_SIZE = 64;
+static const uint8_t PACKED_KEYS_MAX_WIDTH = 63;
+
+static inline uint32_t packed_keys_num_blocks(uint32_t num_keys) {
+  return (num_keys + PACKED_KEYS_BLOCK_SIZE - 1) / PACKED_KEYS_BLOCK_SIZE;
+}
+
+static inline size_t packed_keys_widths_bytes(uint32_t num_keys) {
+  return (packed_keys_num_blocks(num_keys) + 7) & ~static_cast<size_t>(7);
+}
+
+static inline uint32_t packed_keys_block_words(uint32_t count, uint8_t width) {
+  return (count * width + 63) / 64;
+}
+
+// keys in the block that starts at key index
+static inline uint32_t packed_keys_block_count(uint32_t num_keys, uint32_t index) {
+  return std::min(num_keys - index, PACKED_KEYS_BLOCK_SIZE);
+}
+
+static inline uint8_t packed_keys_width(const uint64_t* keys, uint32_t count, uint64_t previous) {
+  uint64_t bits = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    bits |= keys[i] - previous;
+    previous = keys[i];
+  }
+  uint8_t width = 0;
+  while (width < 64 and (bits >> width) != 0) width++;
+  return width;
+}
+
+/**
+ * Size of the packed keys.
+ * @param keys ascending, distinct and below theta
+ */
+static inline size_t packed_keys_size_bytes(const uint64_t* keys, uint32_t num_keys) {
+  size_t size = packed_keys_widths_bytes(num_keys);
+  uint64_t previous = 0;
+  for (uint32_t i = 0; i < num_keys; i += PACKED_KEYS_BLOCK_SIZE) {
+    const uint32_t count = packed_keys_block_count(num_keys, i);
+    size += sizeof(uint64_t) * packed_keys_block_words(count, packed_keys_width(&keys[i], count, previous));
+    previous = keys[i + count - 1];
+  }
+  return size;
+}
+
+/**
+ * Size of the packed words that follow the widths, as the widths say.
+ * @return 0 if a width is out of range, which only a corrupted sketch has
+ */
+static inline size_t packed_keys_words_bytes(const char* widths, uint32_t num_keys) {
+  size_t size = 0;
+  for (uint32_t i = 0; i < num_keys; i += PACKED_KEYS_BLOCK_SIZE) {
+    const uint8_t width = static_cast<uint8_t>(widths[i / PACKED_KEYS_BLOCK_SIZE]);
+    if (width == 0 or width > PACKED_KEYS_MAX_WIDTH) return 0;
+    size += sizeof(uint64_t) * packed_keys_block_words(packed_keys_block_count(num_keys, i), width);
+  }
+  return size;
+}
+
+/**
+ * Packs the keys.
+ * @param keys ascending, distinct and below theta
+ * @param out room for packed_keys_size_bytes(keys, num_keys) bytes
+ */
+static inline void packed_keys_write(const uint64_t* keys, uint32_t num_keys, char* out) {
+  char* widths = out;
+  const size_t widths_bytes = packed_keys_widths_bytes(num_keys);
+  std::fill(widths, &widths[widths_bytes], 0);
+  out += widths_bytes;
+  uint64_t words[PACKED_KEYS_MAX_WIDTH];
+  uint64_t previous = 0;
+  for (uint32_t i = 0; i < num_keys; i += PACKED_KEYS_BLOCK_SIZE) {
+    const uint32_t count = packed_keys_block_count(num_keys, i);
+    const uint8_t width = packed_keys_width(&keys[i], count, previous);
+    widths[i / PACKED_KEYS_BLOCK_SIZE] = width;
+    const uint32_t num_words = packed_keys_block_words(count, width);
+    std::fill(words, &words[num_words], 0);
+    for (uint32_t j = 0; j < count; j++) {
+      const uint64_t delta = keys[i + j] - previous;
+      previous = keys[i + j];
+      const uint32_t bit = j * width;
+      const uint32_t shift = bit & 63;
+      words[bit >> 6] |= delta << shift;
+      if (shift + width > 64) words[(bit >> 6) + 1] |= delta >> (64 - shift);
+    }
+    std::memcpy(out, words, sizeof(uint64_t) * num_words);
+    out += sizeof(uint64_t) * num_words;
+  }
+}
+
+/**
+ * Decodes one block: the deltas are extracted independently of each other, then
+ * summed up from the last key of the previous block.
+ * @param words the block, packed_keys_block_words(count, width) words
+ * @param width 1 to PACKED_KEYS_MAX_WIDTH
+ */
+static inline void packed_keys_unpack(const char* words, uint32_t count, uint8_t width, uint64_t previous, uint64_t* out) {
+  // one zero word past the block, so that every delta reads two words
+  uint64_t buffer[PACKED_KEYS_MAX_WIDTH + 1];
+  const uint32_t num_words = packed_keys_block_words(count, width);
+  std::memcpy(buffer, words, sizeof(uint64_t) * num_words);
+  buffer[num_words] = 0;
+  const uint64_t mask = (static_cast<uint64_t>(1) << width) - 1;
+  for (uint32_t i = 0; i < count; i++) {
+    const uint32_t bit = i * width;
+    const uint32_t shift = bit & 63;
+    out[i] = ((buffer[bit >> 6] >> shift) | ((buffer[(bit >> 6) + 1] << 1) << (63 - shift))) & mask;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    previous += out[i];
+    out[i] = previous;
+  }
+}
+
+// Decodes the packed keys a block at a time. The data must have been checked
+// with packed_keys_words_bytes() first.
+class packed_keys_reader {
+public:
+  packed_keys_reader(const char* data, uint32_t num_keys):
+  widths_(data), words_(data + packed_keys_widths_bytes(num_keys)), num_keys_(num_keys), index_(0), previous_(0) {}
+
+  /**
+   * Decodes the next block.
+   * @param out room for PACKED_KEYS_BLOCK_SIZE keys
+   * @return number of keys written to out, 0 after the last block
+   */
+  uint32_t next(uint64_t* out) {
+    if (index_ == num_keys_) return 0;
+    const uint32_t count = packed_keys_block_count(num_keys_, index_);
+    const uint8_t width = static_cast<uint8_t>(widths_[index_ / PACKED_KEYS_BLOCK_SIZE]);
+    packed_keys_unpack(words_, count, width, previous_, out);
+    words_ += sizeof(uint64_t) * packed_keys_block_words(count, width);
+    index_ += count;
+    previous_ = out[count - 1];
+    return count;
+  }
+
+private:
+  const char* widths_;
+  const char* words_;
+  uint32_t num_keys_;
+  uint32_t index_;
+  uint64_t previous_;
+};
+
+} /* namespace datasketches */
+
+# endif
@@ -23,6 +23,7 @@
 #include <memory>
 #include <functional>
 #include <climits>
+#include <vector>
 
 namespace datasketches {
 
@@ -36,9 +37,13 @@ namespace datasketches {
 template<typename A> class theta_sketch_alloc;
 template<typename A> class update_theta_sketch_alloc;
 template<typename A> class compact_theta_sketch_alloc;
+template<typename A> class compact_theta_sketch_view_alloc;
 template<typename A> class theta_union_alloc;
 template<typename A> class theta_intersection_alloc;
 template<typename A> class theta_a_not_b_alloc;
+template<typename A> class concurrent_theta_sketch_alloc;
+template<typename A> class atomic_update_theta_sketch_alloc;
+template<typename A> class direct_update_theta_sketch_alloc;
 
 // for serialization as raw bytes
 typedef std::unique_ptr<void, std::function<void(void*)>> void_ptr_with_deleter;
@@ -48,6 +53,8 @@ class theta_sketch_alloc {
 public:
   static const uint64_t MAX_THETA = LLONG_MAX; // signed max for compatibility with Java
   static const uint8_t SERIAL_VERSION = 3;
+  // compact sketches with packed keys, see compact_theta_sketch_alloc::serialize_compressed()
+  static const uint8_t SERIAL_VERSION_COMPRESSED = 4;
 
   theta_sketch_alloc(bool is_empty, uint64_t theta);
   theta_sketch_alloc(const theta_sketch_alloc<A>& other);
@@ -93,8 +100,16 @@ protected:
   static void check_seed_hash(uint16_t actual, uint16_t expected);
   static void check_size(size_t actual, size_t expected);
 
+  // the ascending keys of an ordered sketch, which is compact and holds them in one array
+  static const uint64_t* get_ordered_keys(const theta_sketch_alloc<A>& sketch);
+
+  class stream_key_reader;
+
+  friend theta_union_alloc<A>;
   friend theta_intersection_alloc<A>;
   friend theta_a_not_b_alloc<A>;
+  friend atomic_update_theta_sketch_alloc<A>;
+  friend direct_update_theta_sketch_alloc<A>;
 };
 
 // update sketch
@@ -143,6 +158,25 @@ public:
   // which does widening conversion to int64_t, if compatibility with Java is expected
   void update(const void* data, unsigned length);
 
+  // Batch updates, equivalent to calling update() on each value in order.
+  // Fixed size values are hashed a block at a time, so that the hash computations
+  // of a block overlap instead of forming one dependency chain per value.
+  void update_batch(const uint64_t* values, size_t n);
+  void update_batch(const int64_t* values, size_t n);
+  void update_batch(const double* values, size_t n);
+  void update_batch(const std::string* values, size_t n);
+
+  // Pre-hashed updates, for callers that hash each record once and feed it to
+  // several sketches. The hashes must be produced by compute_hash() or
+  // compute_hashes() (63-bit, already shifted) with the given seed, which is
+  // checked against the seed of this sketch: a mismatch throws std::invalid_argument.
+  void update_hashes(const uint64_t* hashes, size_t n, uint64_t seed = builder::DEFAULT_SEED);
+
+  // Same hash update(data, length) or update(value) computes with the given seed
+  static uint64_t compute_hash(const void* data, unsigned length, uint64_t seed = builder::DEFAULT_SEED);
+  static uint64_t compute_hash(uint64_t value, uint64_t seed = builder::DEFAULT_SEED);
+  static void compute_hashes(const uint64_t* values, size_t n, uint64_t* hashes, uint64_t seed = builder::DEFAULT_SEED);
+
   // remove retained entries in excess of the nominal size k (if any)
   void trim();
 
@@ -160,6 +194,13 @@ private:
   // hash table rebuild threshold = 15/16
   static constexpr double REBUILD_THRESHOLD = 15.0 / 16.0;
 
+  // values hashed per step by update_batch()
+  static const int BATCH_SIZE = 256;
+  // Tables of at least this size (8 bytes per slot) do not fit in L2, batched
+  // inserts prefetch their home slots PREFETCH_DISTANCE hashes ahead then
+  static const uint8_t PREFETCH_MIN_LG_SIZE = 17;
+  static const int PREFETCH_DISTANCE = 32;
+
   static constexpr uint8_t STRIDE_HASH_BITS = 7;
   static constexpr uint32_t STRIDE_MASK = (1 << STRIDE_HASH_BITS) - 1;
 
@@ -167,6 +208,8 @@ private:
   uint8_t lg_nom_size_;
   uint64_t* keys_;
   uint32_t num_keys_;
+  // 1 << lg_nom_size_ survivors of rebuild(), allocated by the first one
+  uint64_t* rebuild_keys_;
   resize_factor rf_;
   float p_;
   uint64_t seed_;
@@ -182,14 +225,24 @@ private:
   void resize();
   void rebuild();
 
+  static int64_t canonical_double(double value);
+
+  friend concurrent_theta_sketch_alloc<A>;
+  friend atomic_update_theta_sketch_alloc<A>;
+  friend direct_update_theta_sketch_alloc<A>;
   friend theta_union_alloc<A>;
   void internal_update(uint64_t hash);
+  void internal_update(const uint64_t* hashes, size_t n);
+  inline void prefetch_home(uint64_t hash) const;
+  static inline void prefetch(const uint64_t* slot);
 
   friend theta_intersection_alloc<A>;
   friend theta_a_not_b_alloc<A>;
   static inline uint32_t get_capacity(uint8_t lg_cur_size, uint8_t lg_nom_size);
   static inline uint32_t get_stride(uint64_t hash, uint8_t lg_size);
   static bool hash_search_or_insert(uint64_t hash, uint64_t* table, uint8_t lg_size);
+  // for a hash known not to be in the table, which must have an empty slot
+  static void hash_insert(uint64_t hash, uint64_t* table, uint8_t lg_size);
   static bool hash_search(uint64_t hash, const uint64_t* table, uint8_t lg_size);
 
   friend theta_sketch_alloc<A>;
@@ -220,6 +273,14 @@ public:
   // header space is reserved, but not initialized
   virtual std::pair<void_ptr_with_deleter, const size_t> serialize(unsigned header_size_bytes = 0) const;
 
+  // Serial version 4: the preamble of version 3, then the keys as deltas bit-packed
+  // per block (see theta_packed_keys.hpp), which takes around lg(theta / num keys) + 1
+  // bits per key instead of 64. Unordered sketches and sketches with less than two
+  // keys are written as version 3. deserialize() reads both versions.
+  void serialize_compressed(std::ostream& os) const;
+  // header space is reserved, but not initialized
+  std::pair<void_ptr_with_deleter, const size_t> serialize_compressed(unsigned header_size_bytes = 0) const;
+
   virtual typename theta_sketch_alloc<A>::const_iterator begin() const;
   virtual typename theta_sketch_alloc<A>::const_iterator end() const;
 
@@ -236,12 +297,51 @@ private:
 
   friend theta_sketch_alloc<A>;
   friend update_theta_sketch_alloc<A>;
+  friend atomic_update_theta_sketch_alloc<A>;
+  friend direct_update_theta_sketch_alloc<A>;
   friend theta_union_alloc<A>;
   friend theta_intersection_alloc<A>;
   friend theta_a_not_b_alloc<A>;
   compact_theta_sketch_alloc(bool is_empty, uint64_t theta, uint64_t* keys, uint32_t num_keys, uint16_t seed_hash, bool is_ordered);
-  static compact_theta_sketch_alloc<A> internal_deserialize(std::istream& is, uint8_t preamble_longs, uint8_t flags_byte, uint16_t seed_hash);
-  static compact_theta_sketch_alloc<A> internal_deserialize(const void* bytes, size_t size, uint8_t preamble_longs, uint8_t flags_byte, uint16_t seed_hash);
+  bool is_compressible() const;
+  static void check_compact_serial_version(uint8_t serial_version);
+  static compact_theta_sketch_alloc<A> internal_deserialize(std::istream& is, uint8_t serial_version, uint8_t preamble_longs, uint8_t flags_byte, uint16_t seed_hash);
+  static compact_theta_sketch_alloc<A> internal_deserialize(const void* bytes, size_t size, uint8_t serial_version, uint8_t preamble_longs, uint8_t flags_byte, uint16_t seed_hash);
+  // checks the widths and the size of packed keys
+  static size_t check_packed_keys(const char* data, size_t size, uint32_t num_keys);
+};
+
+// read-only view of a serialized compact sketch
+
+template<typename A>
+class compact_theta_sketch_view_alloc: public theta_sketch_alloc<A> {
+public:
+  // Checks the preamble and the size, then reads the keys in place. The memory is
+  // owned by the caller, must outlive the view and be 8-byte aligned.
+  compact_theta_sketch_view_alloc(const void* bytes, size_t size, uint64_t seed = update_theta_sketch_alloc<A>::builder::DEFAULT_SEED);
+
+  virtual uint32_t get_num_retained() const;
+  virtual uint16_t get_seed_hash() const;
+  virtual bool is_ordered() const;
+  virtual void to_stream(std::ostream& os, bool print_items = false) const;
+  // the bytes of the view as they are
+  virtual void serialize(std::ostream& os) const;
+  // header space is reserved, but not initialized
+  virtual std::pair<void_ptr_with_deleter, const size_t> serialize(unsigned header_size_bytes = 0) const;
+
+  virtual typename theta_sketch_alloc<A>::const_iterator begin() const;
+  virtual typename theta_sketch_alloc<A>::const_iterator end() const;
+
+  // bytes of the serialized sketch, which may be less than the size passed in
+  size_t get_serialized_size_bytes() const;
+
+private:
+  const char* bytes_;
+  size_t size_;
+  const uint64_t* keys_;
+  uint32_t num_keys_;
+  uint16_t seed_hash_;
+  bool is_ordered_;
 };
 
 // builder
@@ -266,6 +366,7 @@ private:
   float p_;
   uint64_t seed_;
 
+  friend direct_update_theta_sketch_alloc<A>;
   static uint8_t starting_sub_multiple(uint8_t lg_tgt, uint8_t lg_min, uint8_t lg_rf);
 };
 
@@ -286,13 +387,63 @@ private:
   const_iterator(const uint64_t* keys, uint32_t size, uint32_t index);
   friend class update_theta_sketch_alloc<A>;
   friend class compact_theta_sketch_alloc<A>;
+  friend class compact_theta_sketch_view_alloc<A>;
+  friend class theta_sketch_alloc<A>;
 };
 
+// Reads the keys of a serialized update or compact sketch from a stream a block at a time,
+// for the set operations that take a stream. The memory it takes does not depend on the
+// size of the sketch, except for the widths of a compressed one: a byte per 64 keys.
+template<typename A>
+class theta_sketch_alloc<A>::stream_key_reader {
+public:
+  static const uint32_t BLOCK_SIZE = 64;
+
+  // reads the preamble and checks the sketch type, serial version and seed hash
+  stream_key_reader(std::istream& is, uint16_t seed_hash);
+
+  bool is_empty() const;
+  bool is_ordered() const;
+  uint64_t get_theta64() const;
+  // keys retained by the sketch, as its preamble says
+  uint32_t get_num_retained() const;
+
+  /**
+   * Reads the next keys: in ascending order if the sketch is ordered,
+   * without the empty slots of an update sketch.
+   * @param out room for BLOCK_SIZE keys
+   * @return number of keys written to out, 0 after the last one
+   */
+  uint32_t next(uint64_t* out);
+
+  // reads past the keys that were not asked for, to the end of the sketch
+  void skip();
+
+private:
+  typedef typename std::allocator_traits<A>::template rebind_alloc<char> AllocChar;
+
+  std::istream& is_;
+  bool is_update_;
+  bool is_empty_;
+  bool is_ordered_;
+  bool is_compressed_;
+  uint64_t theta_;
+  uint32_t num_retained_;
+  // keys of a compact sketch or slots of an update sketch
+  uint32_t num_entries_;
+  uint32_t index_;
+  // the block widths of a compressed sketch and the last key of the previous block
+  std::vector<char, AllocChar> widths_;
+  uint64_t previous_;
+
+  void read(void* data, size_t size);
+};
 
 // aliases with default allocator for convenience
 typedef theta_sketch_alloc<std::allocator<void>> theta_sketch;
 typedef update_theta_sketch_alloc<std::allocator<void>> update_theta_sketch;
 typedef compact_theta_sketch_alloc<std::allocator<void>> compact_theta_sketch;
+typedef compact_theta_sketch_view_alloc<std::allocator<void>> compact_theta_sketch_view;
 
 // common helping functions
 
@@ -22,14 +22,21 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <memory>
 #include <functional>
 #include <istream>
 #include <ostream>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
 
 #include "MurmurHash3.h"
 #include "serde.hpp"
 #include "binomial_bounds.hpp"
+#include "theta_packed_keys.hpp"
 
 namespace datasketches {
 
@@ -126,7 +133,11 @@ typename theta_sketch_alloc<A>::unique_ptr theta_sketch_alloc<A>::deserialize(st
   uint16_t seed_hash;
   is.read((char*)&seed_hash, sizeof(seed_hash));
 
-  check_serial_version(serial_version, SERIAL_VERSION);
+  if (type == compact_theta_sketch_alloc<A>::SKETCH_TYPE) {
+    compact_theta_sketch_alloc<A>::check_compact_serial_version(serial_version);
+  } else {
+    check_serial_version(serial_version, SERIAL_VERSION);
+  }
   check_seed_hash(seed_hash, get_seed_hash(seed));
 
   if (type == update_theta_sketch_alloc<A>::SKETCH_TYPE) {
@@ -142,7 +153,7 @@ typename theta_sketch_alloc<A>::unique_ptr theta_sketch_alloc<A>::deserialize(st
   } else if (type == compact_theta_sketch_alloc<A>::SKETCH_TYPE) {
     typedef typename std::allocator_traits<A>::template rebind_alloc<compact_theta_sketch_alloc<A>> AC;
     return unique_ptr(
-      static_cast<theta_sketch_alloc<A>*>(new (AC().allocate(1)) compact_theta_sketch_alloc<A>(compact_theta_sketch_alloc<A>::internal_deserialize(is, preamble_longs, flags_byte, seed_hash))),
+      static_cast<theta_sketch_alloc<A>*>(new (AC().allocate(1)) compact_theta_sketch_alloc<A>(compact_theta_sketch_alloc<A>::internal_deserialize(is, serial_version, preamble_longs, flags_byte, seed_hash))),
       [](theta_sketch_alloc<A>* ptr) {
         ptr->~theta_sketch_alloc();
         AC().deallocate(static_cast<compact_theta_sketch_alloc<A>*>(ptr), 1);
@@ -171,7 +182,11 @@ typename theta_sketch_alloc<A>::unique_ptr theta_sketch_alloc<A>::deserialize(co
   uint16_t seed_hash;
   copy_from_mem(&ptr, &seed_hash, sizeof(seed_hash));
 
-  check_serial_version(serial_version, SERIAL_VERSION);
+  if (type == compact_theta_sketch_alloc<A>::SKETCH_TYPE) {
+    compact_theta_sketch_alloc<A>::check_compact_serial_version(serial_version);
+  } else {
+    check_serial_version(serial_version, SERIAL_VERSION);
+  }
   check_seed_hash(seed_hash, get_seed_hash(seed));
 
   if (type == update_theta_sketch_alloc<A>::SKETCH_TYPE) {
@@ -190,7 +205,7 @@ typename theta_sketch_alloc<A>::unique_ptr theta_sketch_alloc<A>::deserialize(co
     typedef typename std::allocator_traits<A>::template rebind_alloc<compact_theta_sketch_alloc<A>> AC;
     return unique_ptr(
       static_cast<theta_sketch_alloc<A>*>(new (AC().allocate(1)) compact_theta_sketch_alloc<A>(
-        compact_theta_sketch_alloc<A>::internal_deserialize(ptr, size - (ptr - static_cast<const char*>(bytes)), preamble_longs, flags_byte, seed_hash))
+        compact_theta_sketch_alloc<A>::internal_deserialize(ptr, size - (ptr - static_cast<const char*>(bytes)), serial_version, preamble_longs, flags_byte, seed_hash))
       ),
       [](theta_sketch_alloc<A>* ptr) {
         ptr->~theta_sketch_alloc();
@@ -236,6 +251,12 @@ void theta_sketch_alloc<A>::check_size(size_t actual, size_t expected) {
   }
 }
 
+template<typename A>
+const uint64_t* theta_sketch_alloc<A>::get_ordered_keys(const theta_sketch_alloc<A>& sketch) {
+  const const_iterator it = sketch.begin();
+  return &it.keys_[it.index_];
+}
+
 // update sketch
 
 template<typename A>
@@ -245,6 +266,7 @@ lg_cur_size_(lg_cur_size),
 lg_nom_size_(lg_nom_size),
 keys_(AllocU64().allocate(1 << lg_cur_size_)),
 num_keys_(0),
+rebuild_keys_(nullptr),
 rf_(rf),
 p_(p),
 seed_(seed),
@@ -261,6 +283,7 @@ lg_cur_size_(lg_cur_size),
 lg_nom_size_(lg_nom_size),
 keys_(keys),
 num_keys_(num_keys),
+rebuild_keys_(nullptr),
 rf_(rf),
 p_(p),
 seed_(seed),
@@ -274,6 +297,7 @@ lg_cur_size_(other.lg_cur_size_),
 lg_nom_size_(other.lg_nom_size_),
 keys_(AllocU64().allocate(1 << lg_cur_size_)),
 num_keys_(other.num_keys_),
+rebuild_keys_(nullptr),
 rf_(other.rf_),
 p_(other.p_),
 seed_(other.seed_),
@@ -289,22 +313,29 @@ lg_cur_size_(other.lg_cur_size_),
 lg_nom_size_(other.lg_nom_size_),
 keys_(nullptr),
 num_keys_(other.num_keys_),
+rebuild_keys_(nullptr),
 rf_(other.rf_),
 p_(other.p_),
 seed_(other.seed_),
 capacity_(other.capacity_)
 {
   std::swap(keys_, other.keys_);
+  std::swap(rebuild_keys_, other.rebuild_keys_);
 }
 
 template<typename A>
 update_theta_sketch_alloc<A>::~update_theta_sketch_alloc() {
   AllocU64().deallocate(keys_, 1 << lg_cur_size_);
+  if (rebuild_keys_ != nullptr) AllocU64().deallocate(rebuild_keys_, 1 << lg_nom_size_);
 }
 
 template<typename A>
 update_theta_sketch_alloc<A>& update_theta_sketch_alloc<A>::operator=(const update_theta_sketch_alloc<A>& other) {
   theta_sketch_alloc<A>::operator=(other);
+  if (rebuild_keys_ != nullptr and lg_nom_size_ != other.lg_nom_size_) {
+    AllocU64().deallocate(rebuild_keys_, 1 << lg_nom_size_);
+    rebuild_keys_ = nullptr;
+  }
   if (lg_cur_size_ != other.lg_cur_size_) {
     AllocU64().deallocate(keys_, 1 << lg_cur_size_);
     lg_cur_size_ = other.lg_cur_size_;
@@ -324,8 +355,9 @@ template<typename A>
 update_theta_sketch_alloc<A>& update_theta_sketch_alloc<A>::operator=(update_theta_sketch_alloc<A>&& other) {
   theta_sketch_alloc<A>::operator=(std::move(other));
   std::swap(lg_cur_size_, other.lg_cur_size_);
-  lg_nom_size_ = other.lg_nom_size_;
+  std::swap(lg_nom_size_, other.lg_nom_size_);
   std::swap(keys_, other.keys_);
+  std::swap(rebuild_keys_, other.rebuild_keys_);
   num_keys_ = other.num_keys_;
   rf_ = other.rf_;
   p_ = other.p_;
@@ -556,7 +588,7 @@ void update_theta_sketch_alloc<A>::update(int8_t value) {
 }
 
 template<typename A>
-void update_theta_sketch_alloc<A>::update(double value) {
+int64_t update_theta_sketch_alloc<A>::canonical_double(double value) {
   union {
     int64_t long_value;
     double double_value;
@@ -569,7 +601,13 @@ void update_theta_sketch_alloc<A>::update(double value) {
   } else {
     long_double_union.double_value = value;
   }
-  update(&long_double_union, sizeof(long_double_union));
+  return long_double_union.long_value;
+}
+
+template<typename A>
+void update_theta_sketch_alloc<A>::update(double value) {
+  const int64_t long_value = canonical_double(value);
+  update(&long_value, sizeof(long_value));
 }
 
 template<typename A>
@@ -579,10 +617,75 @@ void update_theta_sketch_alloc<A>::update(float value) {
 
 template<typename A>
 void update_theta_sketch_alloc<A>::update(const void* data, unsigned length) {
+  internal_update(compute_hash(data, length, seed_));
+}
+
+template<typename A>
+void update_theta_sketch_alloc<A>::update_batch(const uint64_t* values, size_t n) {
+  uint64_t hashes[BATCH_SIZE];
+  while (n > 0) {
+    const size_t block = std::min(n, static_cast<size_t>(BATCH_SIZE));
+    compute_hashes(values, block, hashes, seed_);
+    internal_update(hashes, block);
+    values += block;
+    n -= block;
+  }
+}
+
+template<typename A>
+void update_theta_sketch_alloc<A>::update_batch(const int64_t* values, size_t n) {
+  // same bytes, same hashes
+  update_batch(reinterpret_cast<const uint64_t*>(values), n);
+}
+
+template<typename A>
+void update_theta_sketch_alloc<A>::update_batch(const double* values, size_t n) {
+  uint64_t longs[BATCH_SIZE];
+  while (n > 0) {
+    const size_t block = std::min(n, static_cast<size_t>(BATCH_SIZE));
+    for (size_t i = 0; i < block; i++) longs[i] = canonical_double(values[i]);
+    update_batch(longs, block);
+    values += block;
+    n -= block;
+  }
+}
+
+template<typename A>
+void update_theta_sketch_alloc<A>::update_batch(const std::string* values, size_t n) {
+  // variable length keys, nothing to share between them
+  for (size_t i = 0; i < n; i++) update(values[i]);
+}
+
+template<typename A>
+void update_theta_sketch_alloc<A>::update_hashes(const uint64_t* hashes, size_t n, uint64_t seed) {
+  if (seed != seed_) {
+    throw std::invalid_argument("Hash seed mismatch: expected " + std::to_string(seed_) + ", actual " + std::to_string(seed));
+  }
+  internal_update(hashes, n);
+}
+
+template<typename A>
+uint64_t update_theta_sketch_alloc<A>::compute_hash(const void* data, unsigned length, uint64_t seed) {
   HashState hashes;
-  MurmurHash3_x64_128(data, length, seed_, hashes);
-  const uint64_t hash = hashes.h1 >> 1; // Java implementation does logical shift >>> to make values positive
-  internal_update(hash);
+  MurmurHash3_x64_128(data, length, seed, hashes);
+  return hashes.h1 >> 1; // Java implementation does logical shift >>> to make values positive
+}
+
+template<typename A>
+uint64_t update_theta_sketch_alloc<A>::compute_hash(uint64_t value, uint64_t seed) {
+  return compute_hash(&value, sizeof(value), seed);
+}
+
+template<typename A>
+void update_theta_sketch_alloc<A>::compute_hashes(const uint64_t* values, size_t n, uint64_t* hashes, uint64_t seed) {
+  while (n > 0) {
+    const int block = static_cast<int>(std::min(n, static_cast<size_t>(BATCH_SIZE)));
+    MurmurHash3_x64_128_8_bytes(values, block, seed, hashes);
+    for (int i = 0; i < block; i++) hashes[i] >>= 1;
+    values += block;
+    hashes += block;
+    n -= block;
+  }
 }
 
 template<typename A>
@@ -606,6 +709,39 @@ void update_theta_sketch_alloc<A>::internal_update(uint64_t hash) {
   }
 }
 
+template<typename A>
+void update_theta_sketch_alloc<A>::internal_update(const uint64_t* hashes, size_t n) {
+  if (lg_cur_size_ < PREFETCH_MIN_LG_SIZE) {
+    for (size_t i = 0; i < n; i++) internal_update(hashes[i]);
+    return;
+  }
+  // Nearly every probe of a large table is a cache miss. Fetching the home slots
+  // ahead lets the misses of consecutive hashes overlap instead of queueing up.
+  // A resize in between only makes some prefetches useless.
+  const size_t ahead = std::min(n, static_cast<size_t>(PREFETCH_DISTANCE));
+  for (size_t i = 0; i < ahead; i++) prefetch_home(hashes[i]);
+  for (size_t i = 0; i < n; i++) {
+    if (i + ahead < n) prefetch_home(hashes[i + ahead]);
+    internal_update(hashes[i]);
+  }
+}
+
+template<typename A>
+void update_theta_sketch_alloc<A>::prefetch_home(uint64_t hash) const {
+  if (hash < this->theta_) prefetch(&keys_[static_cast<uint32_t>(hash) & ((1 << lg_cur_size_) - 1)]);
+}
+
+template<typename A>
+void update_theta_sketch_alloc<A>::prefetch(const uint64_t* slot) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(slot);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_prefetch(reinterpret_cast<const char*>(slot), _MM_HINT_T0);
+#else
+  (void) slot;
+#endif
+}
+
 template<typename A>
 void update_theta_sketch_alloc<A>::trim() {
   if (num_keys_ > (1 << lg_nom_size_)) rebuild();
@@ -621,9 +757,7 @@ void update_theta_sketch_alloc<A>::resize() {
   uint64_t* new_keys = AllocU64().allocate(new_size);
   std::fill(new_keys, &new_keys[new_size], 0);
   for (uint32_t i = 0; i < cur_size; i++) {
-    if (keys_[i] != 0) {
-      hash_search_or_insert(keys_[i], new_keys, lg_new_size); // TODO hash_insert
-    }
+    if (keys_[i] != 0) hash_insert(keys_[i], new_keys, lg_new_size);
   }
   AllocU64().deallocate(keys_, cur_size);
   keys_ = new_keys;
@@ -634,20 +768,20 @@ void update_theta_sketch_alloc<A>::resize() {
 template<typename A>
 void update_theta_sketch_alloc<A>::rebuild() {
   const uint32_t cur_size = 1 << lg_cur_size_;
-  const uint32_t pivot = (1 << lg_nom_size_) + cur_size - num_keys_;
-  std::nth_element(&keys_[0], &keys_[pivot], &keys_[cur_size]);
-  this->theta_ = keys_[pivot];
-  uint64_t* new_keys = AllocU64().allocate(cur_size);
-  std::fill(new_keys, &new_keys[cur_size], 0);
-  num_keys_ = 0;
+  const uint32_t nom_size = 1 << lg_nom_size_;
+  // gather the keys at the front, so that the selection skips the empty slots
+  uint32_t num_keys = 0;
   for (uint32_t i = 0; i < cur_size; i++) {
-    if (keys_[i] != 0 and keys_[i] < this->theta_) {
-      hash_search_or_insert(keys_[i], new_keys, lg_cur_size_); // TODO hash_insert
-      num_keys_++;
-    }
+    if (keys_[i] != 0) keys_[num_keys++] = keys_[i];
   }
-  AllocU64().deallocate(keys_, cur_size);
-  keys_ = new_keys;
+  std::nth_element(&keys_[0], &keys_[nom_size], &keys_[num_keys]);
+  this->theta_ = keys_[nom_size];
+  // the nom_size keys below the new theta are distinct, put them back without searching
+  if (rebuild_keys_ == nullptr) rebuild_keys_ = AllocU64().allocate(nom_size);
+  std::copy(&keys_[0], &keys_[nom_size], rebuild_keys_);
+  std::fill(&keys_[0], &keys_[cur_size], 0);
+  for (uint32_t i = 0; i < nom_size; i++) hash_insert(rebuild_keys_[i], keys_, lg_cur_size_);
+  num_keys_ = nom_size;
 }
 
 template<typename A>
@@ -685,6 +819,15 @@ bool update_theta_sketch_alloc<A>::hash_search_or_insert(uint64_t hash, uint64_t
   throw std::logic_error("key not found and no empty slots!");
 }
 
+template<typename A>
+void update_theta_sketch_alloc<A>::hash_insert(uint64_t hash, uint64_t* table, uint8_t lg_size) {
+  const uint32_t mask = (1 << lg_size) - 1;
+  const uint32_t stride = get_stride(hash, lg_size);
+  uint32_t cur_probe = static_cast<uint32_t>(hash) & mask;
+  while (table[cur_probe] != 0) cur_probe = (cur_probe + stride) & mask;
+  table[cur_probe] = hash;
+}
+
 template<typename A>
 bool update_theta_sketch_alloc<A>::hash_search(uint64_t hash, const uint64_t* table, uint8_t lg_size) {
   const uint32_t mask = (1 << lg_size) - 1;
@@ -901,6 +1044,77 @@ std::pair<void_ptr_with_deleter, const size_t> compact_theta_sketch_alloc<A>::se
   return std::make_pair(std::move(data_ptr), size);;
 }
 
+template<typename A>
+void compact_theta_sketch_alloc<A>::serialize_compressed(std::ostream& os) const {
+  if (!is_compressible()) {
+    serialize(os);
+    return;
+  }
+  const auto bytes = serialize_compressed();
+  os.write(static_cast<const char*>(bytes.first.get()), bytes.second);
+}
+
+template<typename A>
+std::pair<void_ptr_with_deleter, const size_t> compact_theta_sketch_alloc<A>::serialize_compressed(unsigned header_size_bytes) const {
+  if (!is_compressible()) return serialize(header_size_bytes);
+  // not a single item, so the number of keys is in the preamble
+  const uint8_t preamble_longs = this->is_estimation_mode() ? 3 : 2;
+  const size_t size = header_size_bytes + sizeof(uint64_t) * preamble_longs + packed_keys_size_bytes(keys_, num_keys_);
+  typedef typename std::allocator_traits<A>::template rebind_alloc<char> AllocChar;
+  void_ptr_with_deleter data_ptr(
+    static_cast<void*>(AllocChar().allocate(size)),
+    [size](void* ptr) { AllocChar().deallocate(static_cast<char*>(ptr), size); }
+  );
+  char* ptr = static_cast<char*>(data_ptr.get()) + header_size_bytes;
+
+  copy_to_mem(&preamble_longs, &ptr, sizeof(preamble_longs));
+  const uint8_t serial_version = theta_sketch_alloc<A>::SERIAL_VERSION_COMPRESSED;
+  copy_to_mem(&serial_version, &ptr, sizeof(serial_version));
+  const uint8_t type = SKETCH_TYPE;
+  copy_to_mem(&type, &ptr, sizeof(type));
+  const uint16_t unused16 = 0;
+  copy_to_mem(&unused16, &ptr, sizeof(unused16));
+  const uint8_t flags_byte(
+    (1 << theta_sketch_alloc<A>::flags::IS_COMPACT) |
+    (1 << theta_sketch_alloc<A>::flags::IS_READ_ONLY) |
+    (1 << theta_sketch_alloc<A>::flags::IS_ORDERED)
+  );
+  copy_to_mem(&flags_byte, &ptr, sizeof(flags_byte));
+  const uint16_t seed_hash = get_seed_hash();
+  copy_to_mem(&seed_hash, &ptr, sizeof(seed_hash));
+  copy_to_mem(&num_keys_, &ptr, sizeof(num_keys_));
+  const uint32_t unused32 = 0;
+  copy_to_mem(&unused32, &ptr, sizeof(unused32));
+  if (this->is_estimation_mode()) {
+    copy_to_mem(&(this->theta_), &ptr, sizeof(uint64_t));
+  }
+  packed_keys_write(keys_, num_keys_, ptr);
+
+  return std::make_pair(std::move(data_ptr), size);
+}
+
+template<typename A>
+bool compact_theta_sketch_alloc<A>::is_compressible() const {
+  return is_ordered_ and num_keys_ > 1;
+}
+
+template<typename A>
+void compact_theta_sketch_alloc<A>::check_compact_serial_version(uint8_t serial_version) {
+  if (serial_version != theta_sketch_alloc<A>::SERIAL_VERSION_COMPRESSED) {
+    theta_sketch_alloc<A>::check_serial_version(serial_version, theta_sketch_alloc<A>::SERIAL_VERSION);
+  }
+}
+
+template<typename A>
+size_t compact_theta_sketch_alloc<A>::check_packed_keys(const char* data, size_t size, uint32_t num_keys) {
+  const size_t widths_bytes = packed_keys_widths_bytes(num_keys);
+  theta_sketch_alloc<A>::check_size(size, widths_bytes);
+  const size_t words_bytes = packed_keys_words_bytes(data, num_keys);
+  if (num_keys > 0 and words_bytes == 0) throw std::invalid_argument("packed key width out of range");
+  theta_sketch_alloc<A>::check_size(size - widths_bytes, words_bytes);
+  return widths_bytes + words_bytes;
+}
+
 template<typename A>
 compact_theta_sketch_alloc<A> compact_theta_sketch_alloc<A>::deserialize(std::istream& is, uint64_t seed) {
   uint8_t preamble_longs;
@@ -916,13 +1130,13 @@ compact_theta_sketch_alloc<A> compact_theta_sketch_alloc<A>::deserialize(std::is
   uint16_t seed_hash;
   is.read((char*)&seed_hash, sizeof(seed_hash));
   theta_sketch_alloc<A>::check_sketch_type(type, SKETCH_TYPE);
-  theta_sketch_alloc<A>::check_serial_version(serial_version, theta_sketch_alloc<A>::SERIAL_VERSION);
+  check_compact_serial_version(serial_version);
   theta_sketch_alloc<A>::check_seed_hash(seed_hash, theta_sketch_alloc<A>::get_seed_hash(seed));
-  return internal_deserialize(is, preamble_longs, flags_byte, seed_hash);
+  return internal_deserialize(is, serial_version, preamble_longs, flags_byte, seed_hash);
 }
 
 template<typename A>
-compact_theta_sketch_alloc<A> compact_theta_sketch_alloc<A>::internal_deserialize(std::istream& is, uint8_t preamble_longs, uint8_t flags_byte, uint16_t seed_hash) {
+compact_theta_sketch_alloc<A> compact_theta_sketch_alloc<A>::internal_deserialize(std::istream& is, uint8_t serial_version, uint8_t preamble_longs, uint8_t flags_byte, uint16_t seed_hash) {
   uint64_t theta = theta_sketch_alloc<A>::MAX_THETA;
   uint64_t* keys = nullptr;
   uint32_t num_keys = 0;
@@ -940,8 +1154,21 @@ compact_theta_sketch_alloc<A> compact_theta_sketch_alloc<A>::internal_deserializ
       }
     }
     typedef typename std::allocator_traits<A>::template rebind_alloc<uint64_t> AllocU64;
-    keys = AllocU64().allocate(num_keys);
-    is.read((char*)keys, sizeof(uint64_t) * num_keys);
+    if (serial_version == theta_sketch_alloc<A>::SERIAL_VERSION_COMPRESSED) {
+      typedef typename std::allocator_traits<A>::template rebind_alloc<char> AllocChar;
+      std::vector<char, AllocChar> packed(packed_keys_widths_bytes(num_keys));
+      is.read(packed.data(), packed.size());
+      const size_t words_bytes = packed_keys_words_bytes(packed.data(), num_keys);
+      if (num_keys > 0 and words_bytes == 0) throw std::invalid_argument("packed key width out of range");
+      packed.resize(packed.size() + words_bytes);
+      is.read(packed.data() + packed.size() - words_bytes, words_bytes);
+      keys = AllocU64().allocate(num_keys);
+      packed_keys_reader reader(packed.data(), num_keys);
+      for (uint32_t i = 0; i < num_keys; i += reader.next(&keys[i])) {}
+    } else {
+      keys = AllocU64().allocate(num_keys);
+      is.read((char*)keys, sizeof(uint64_t) * num_keys);
+    }
   }
 
   const bool is_ordered = flags_byte & (1 << theta_sketch_alloc<A>::flags::IS_ORDERED);
@@ -965,13 +1192,13 @@ compact_theta_sketch_alloc<A> compact_theta_sketch_alloc<A>::deserialize(const v
   uint16_t seed_hash;
   copy_from_mem(&ptr, &seed_hash, sizeof(seed_hash));
   theta_sketch_alloc<A>::check_sketch_type(type, SKETCH_TYPE);
-  theta_sketch_alloc<A>::check_serial_version(serial_version, theta_sketch_alloc<A>::SERIAL_VERSION);
+  check_compact_serial_version(serial_version);
   theta_sketch_alloc<A>::check_seed_hash(seed_hash, theta_sketch_alloc<A>::get_seed_hash(seed));
-  return internal_deserialize(ptr, size - (ptr - static_cast<const char*>(bytes)), preamble_longs, flags_byte, seed_hash);
+  return internal_deserialize(ptr, size - (ptr - static_cast<const char*>(bytes)), serial_version, preamble_longs, flags_byte, seed_hash);
 }
 
 template<typename A>
-compact_theta_sketch_alloc<A> compact_theta_sketch_alloc<A>::internal_deserialize(const void* bytes, size_t size, uint8_t preamble_longs, uint8_t flags_byte, uint16_t seed_hash) {
+compact_theta_sketch_alloc<A> compact_theta_sketch_alloc<A>::internal_deserialize(const void* bytes, size_t size, uint8_t serial_version, uint8_t preamble_longs, uint8_t flags_byte, uint16_t seed_hash) {
   const char* ptr = static_cast<const char*>(bytes);
 
   uint64_t theta = theta_sketch_alloc<A>::MAX_THETA;
@@ -992,11 +1219,18 @@ compact_theta_sketch_alloc<A> compact_theta_sketch_alloc<A>::internal_deserializ
         copy_from_mem(&ptr, &theta, sizeof(theta));
       }
     }
-    const size_t keys_size_bytes = sizeof(uint64_t) * num_keys;
-    theta_sketch_alloc<A>::check_size(size - (ptr - static_cast<const char*>(bytes)), keys_size_bytes);
     typedef typename std::allocator_traits<A>::template rebind_alloc<uint64_t> AllocU64;
-    keys = AllocU64().allocate(num_keys);
-    copy_from_mem(&ptr, keys, keys_size_bytes);
+    if (serial_version == theta_sketch_alloc<A>::SERIAL_VERSION_COMPRESSED) {
+      check_packed_keys(ptr, size - (ptr - static_cast<const char*>(bytes)), num_keys);
+      keys = AllocU64().allocate(num_keys);
+      packed_keys_reader reader(ptr, num_keys);
+      for (uint32_t i = 0; i < num_keys; i += reader.next(&keys[i])) {}
+    } else {
+      const size_t keys_size_bytes = sizeof(uint64_t) * num_keys;
+      theta_sketch_alloc<A>::check_size(size - (ptr - static_cast<const char*>(bytes)), keys_size_bytes);
+      keys = AllocU64().allocate(num_keys);
+      copy_from_mem(&ptr, keys, keys_size_bytes);
+    }
   }
 
   const bool is_ordered = flags_byte & (1 << theta_sketch_alloc<A>::flags::IS_ORDERED);
@@ -1013,6 +1247,128 @@ typename theta_sketch_alloc<A>::const_iterator compact_theta_sketch_alloc<A>::en
   return typename theta_sketch_alloc<A>::const_iterator(keys_, num_keys_, num_keys_);
 }
 
+// compact view
+
+template<typename A>
+compact_theta_sketch_view_alloc<A>::compact_theta_sketch_view_alloc(const void* bytes, size_t size, uint64_t seed):
+theta_sketch_alloc<A>(true, theta_sketch_alloc<A>::MAX_THETA),
+bytes_(static_cast<const char*>(bytes)),
+size_(8),
+keys_(nullptr),
+num_keys_(0),
+seed_hash_(0),
+is_ordered_(true)
+{
+  theta_sketch_alloc<A>::check_size(size, 8);
+  if (reinterpret_cast<uintptr_t>(bytes) % sizeof(uint64_t) != 0) {
+    throw std::invalid_argument("serialized sketch must be 8-byte aligned to be viewed in place");
+  }
+  const char* ptr = bytes_;
+  uint8_t preamble_longs;
+  copy_from_mem(&ptr, &preamble_longs, sizeof(preamble_longs));
+  uint8_t serial_version;
+  copy_from_mem(&ptr, &serial_version, sizeof(serial_version));
+  uint8_t type;
+  copy_from_mem(&ptr, &type, sizeof(type));
+  uint16_t unused16;
+  copy_from_mem(&ptr, &unused16, sizeof(unused16));
+  uint8_t flags_byte;
+  copy_from_mem(&ptr, &flags_byte, sizeof(flags_byte));
+  copy_from_mem(&ptr, &seed_hash_, sizeof(seed_hash_));
+  theta_sketch_alloc<A>::check_sketch_type(type, compact_theta_sketch_alloc<A>::SKETCH_TYPE);
+  theta_sketch_alloc<A>::check_serial_version(serial_version, theta_sketch_alloc<A>::SERIAL_VERSION);
+  theta_sketch_alloc<A>::check_seed_hash(seed_hash_, theta_sketch_alloc<A>::get_seed_hash(seed));
+
+  // same layout as compact_theta_sketch_alloc<A>::internal_deserialize() reads
+  this->is_empty_ = flags_byte & (1 << theta_sketch_alloc<A>::flags::IS_EMPTY);
+  is_ordered_ = flags_byte & (1 << theta_sketch_alloc<A>::flags::IS_ORDERED);
+  if (this->is_empty_) return;
+  if (preamble_longs == 1) {
+    num_keys_ = 1;
+  } else {
+    theta_sketch_alloc<A>::check_size(size, 16);
+    copy_from_mem(&ptr, &num_keys_, sizeof(num_keys_));
+    ptr += sizeof(uint32_t);
+    if (preamble_longs > 2) {
+      theta_sketch_alloc<A>::check_size(size, 24);
+      copy_from_mem(&ptr, &this->theta_, sizeof(this->theta_));
+    }
+  }
+  const size_t preamble_size = ptr - bytes_;
+  const size_t keys_size_bytes = sizeof(uint64_t) * num_keys_;
+  theta_sketch_alloc<A>::check_size(size - preamble_size, keys_size_bytes);
+  keys_ = reinterpret_cast<const uint64_t*>(ptr);
+  size_ = preamble_size + keys_size_bytes;
+}
+
+template<typename A>
+uint32_t compact_theta_sketch_view_alloc<A>::get_num_retained() const {
+  return num_keys_;
+}
+
+template<typename A>
+uint16_t compact_theta_sketch_view_alloc<A>::get_seed_hash() const {
+  return seed_hash_;
+}
+
+template<typename A>
+bool compact_theta_sketch_view_alloc<A>::is_ordered() const {
+  return is_ordered_;
+}
+
+template<typename A>
+void compact_theta_sketch_view_alloc<A>::to_stream(std::ostream& os, bool print_items) const {
+  os << "### Compact Theta sketch view summary:" << std::endl;
+  os << "   num retained keys    : " << num_keys_ << std::endl;
+  os << "   seed hash            : " << this->get_seed_hash() << std::endl;
+  os << "   ordered?             : " << (this->is_ordered() ? "true" : "false") << std::endl;
+  os << "   theta (fraction)     : " << this->get_theta() << std::endl;
+  os << "   theta (raw 64-bit)   : " << this->theta_ << std::endl;
+  os << "   estimation mode?     : " << (this->is_estimation_mode() ? "true" : "false") << std::endl;
+  os << "   estimate             : " << this->get_estimate() << std::endl;
+  os << "   lower bound 95% conf : " << this->get_lower_bound(2) << std::endl;
+  os << "   upper bound 95% conf : " << this->get_upper_bound(2) << std::endl;
+  os << "### End sketch summary" << std::endl;
+  if (print_items) {
+    os << "### Retained keys" << std::endl;
+    for (auto key: *this) os << "   " << key << std::endl;
+    os << "### End retained keys" << std::endl;
+  }
+}
+
+template<typename A>
+void compact_theta_sketch_view_alloc<A>::serialize(std::ostream& os) const {
+  os.write(bytes_, size_);
+}
+
+template<typename A>
+std::pair<void_ptr_with_deleter, const size_t> compact_theta_sketch_view_alloc<A>::serialize(unsigned header_size_bytes) const {
+  const size_t size = header_size_bytes + size_;
+  typedef typename std::allocator_traits<A>::template rebind_alloc<char> AllocChar;
+  void_ptr_with_deleter data_ptr(
+    static_cast<void*>(AllocChar().allocate(size)),
+    [size](void* ptr) { AllocChar().deallocate(static_cast<char*>(ptr), size); }
+  );
+  char* ptr = static_cast<char*>(data_ptr.get()) + header_size_bytes;
+  copy_to_mem(bytes_, &ptr, size_);
+  return std::make_pair(std::move(data_ptr), size);
+}
+
+template<typename A>
+typename theta_sketch_alloc<A>::const_iterator compact_theta_sketch_view_alloc<A>::begin() const {
+  return typename theta_sketch_alloc<A>::const_iterator(keys_, num_keys_, 0);
+}
+
+template<typename A>
+typename theta_sketch_alloc<A>::const_iterator compact_theta_sketch_view_alloc<A>::end() const {
+  return typename theta_sketch_alloc<A>::const_iterator(keys_, num_keys_, num_keys_);
+}
+
+template<typename A>
+size_t compact_theta_sketch_view_alloc<A>::get_serialized_size_bytes() const {
+  return size_;
+}
+
 // builder
 
 template<typename A>
@@ -1094,6 +1450,153 @@ uint64_t theta_sketch_alloc<A>::const_iterator::operator*() const {
   return keys_[index_];
 }
 
+// stream key reader
+
+template<typename A>
+theta_sketch_alloc<A>::stream_key_reader::stream_key_reader(std::istream& is, uint16_t seed_hash):
+is_(is),
+is_update_(false),
+is_empty_(false),
+is_ordered_(false),
+is_compressed_(false),
+theta_(MAX_THETA),
+num_retained_(0),
+num_entries_(0),
+index_(0),
+widths_(),
+previous_(0)
+{
+  static_assert(PACKED_KEYS_BLOCK_SIZE <= BLOCK_SIZE, "a packed block must fit in a block");
+  uint8_t preamble_longs;
+  read(&preamble_longs, sizeof(preamble_longs));
+  uint8_t serial_version;
+  read(&serial_version, sizeof(serial_version));
+  uint8_t type;
+  read(&type, sizeof(type));
+  uint8_t lg_nom_size;
+  read(&lg_nom_size, sizeof(lg_nom_size));
+  uint8_t lg_cur_size;
+  read(&lg_cur_size, sizeof(lg_cur_size));
+  uint8_t flags_byte;
+  read(&flags_byte, sizeof(flags_byte));
+  uint16_t sketch_seed_hash;
+  read(&sketch_seed_hash, sizeof(sketch_seed_hash));
+
+  if (type == compact_theta_sketch_alloc<A>::SKETCH_TYPE) {
+    compact_theta_sketch_alloc<A>::check_compact_serial_version(serial_version);
+  } else {
+    check_serial_version(serial_version, SERIAL_VERSION);
+  }
+  check_seed_hash(sketch_seed_hash, seed_hash);
+  is_empty_ = flags_byte & (1 << flags::IS_EMPTY);
+
+  if (type == update_theta_sketch_alloc<A>::SKETCH_TYPE) {
+    // the rest of the preamble as update_theta_sketch_alloc::internal_deserialize() reads it
+    is_update_ = true;
+    read(&num_retained_, sizeof(num_retained_));
+    float p;
+    read(&p, sizeof(p));
+    read(&theta_, sizeof(theta_));
+    num_entries_ = 1 << lg_cur_size;
+  } else if (type == compact_theta_sketch_alloc<A>::SKETCH_TYPE) {
+    // as compact_theta_sketch_alloc::internal_deserialize() reads it
+    is_ordered_ = flags_byte & (1 << flags::IS_ORDERED);
+    is_compressed_ = serial_version == SERIAL_VERSION_COMPRESSED;
+    if (!is_empty_) {
+      if (preamble_longs == 1) {
+        num_retained_ = 1;
+      } else {
+        read(&num_retained_, sizeof(num_retained_));
+        uint32_t unused32;
+        read(&unused32, sizeof(unused32));
+        if (preamble_longs > 2) read(&theta_, sizeof(theta_));
+      }
+      num_entries_ = num_retained_;
+      if (is_compressed_) {
+        widths_.resize(packed_keys_widths_bytes(num_entries_));
+        read(widths_.data(), widths_.size());
+        if (num_entries_ > 0 and packed_keys_words_bytes(widths_.data(), num_entries_) == 0) {
+          throw std::invalid_argument("packed key width out of range");
+        }
+      }
+    }
+  } else {
+    throw std::invalid_argument("unsupported sketch type " + std::to_string((int) type));
+  }
+}
+
+template<typename A>
+bool theta_sketch_alloc<A>::stream_key_reader::is_empty() const {
+  return is_empty_;
+}
+
+template<typename A>
+bool theta_sketch_alloc<A>::stream_key_reader::is_ordered() const {
+  return is_ordered_;
+}
+
+template<typename A>
+uint64_t theta_sketch_alloc<A>::stream_key_reader::get_theta64() const {
+  return theta_;
+}
+
+template<typename A>
+uint32_t theta_sketch_alloc<A>::stream_key_reader::get_num_retained() const {
+  return num_retained_;
+}
+
+template<typename A>
+uint32_t theta_sketch_alloc<A>::stream_key_reader::next(uint64_t* out) {
+  while (index_ < num_entries_) {
+    if (is_compressed_) {
+      const uint32_t count = packed_keys_block_count(num_entries_, index_);
+      const uint8_t width = static_cast<uint8_t>(widths_[index_ / PACKED_KEYS_BLOCK_SIZE]);
+      char words[sizeof(uint64_t) * PACKED_KEYS_MAX_WIDTH];
+      read(words, sizeof(uint64_t) * packed_keys_block_words(count, width));
+      packed_keys_unpack(words, count, width, previous_, out);
+      previous_ = out[count - 1];
+      index_ += count;
+      return count;
+    }
+    const uint32_t left = num_entries_ - index_;
+    const uint32_t count = left < BLOCK_SIZE ? left : BLOCK_SIZE;
+    read(out, sizeof(uint64_t) * count);
+    index_ += count;
+    if (!is_update_) return count;
+    // the empty slots of the hash table are dropped
+    uint32_t num_keys = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      if (out[i] != 0) out[num_keys++] = out[i];
+    }
+    if (num_keys > 0) return num_keys;
+  }
+  return 0;
+}
+
+template<typename A>
+void theta_sketch_alloc<A>::stream_key_reader::skip() {
+  uint64_t size = 0;
+  if (is_compressed_) {
+    for (; index_ < num_entries_; index_ += PACKED_KEYS_BLOCK_SIZE) {
+      const uint8_t width = static_cast<uint8_t>(widths_[index_ / PACKED_KEYS_BLOCK_SIZE]);
+      size += sizeof(uint64_t) * packed_keys_block_words(packed_keys_block_count(num_entries_, index_), width);
+    }
+  } else {
+    size = sizeof(uint64_t) * static_cast<uint64_t>(num_entries_ - index_);
+  }
+  index_ = num_entries_;
+  if (size > 0) {
+    is_.ignore(size);
+    if (static_cast<uint64_t>(is_.gcount()) != size) throw std::runtime_error("error reading from std::istream");
+  }
+}
+
+template<typename A>
+void theta_sketch_alloc<A>::stream_key_reader::read(void* data, size_t size) {
+  is_.read(static_cast<char*>(data), size);
+  if (is_.fail()) throw std::runtime_error("error reading from std::istream");
+}
+
 } /* namespace datasketches */
 
 #endif
@@ -0,0 +1,310 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THETA_SORTED_SET_HPP_
+#define THETA_SORTED_SET_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// AVX2 (4 lanes) and AVX-512F (8 lanes) block compares, picked at run time
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define THETA_SORTED_SET_SIMD_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace datasketches {
+
+/*
+ * Set operations on the ascending key arrays of ordered sketches, for the set
+ * operations to use when both sides are ordered.
+ *
+ * The merges compare a block of keys of a with a block of keys of b, all pairs
+ * at once, by rotating the b block through the lanes of a vector. The block of a
+ * collects the lanes that found their key until its last key is passed, then the
+ * lanes to keep are packed to the output. The scalar versions, which the vector
+ * ones finish with, merge without branching on the comparisons.
+ */
+
+// one array is this many times longer than the other before the intersection gallops
+static const uint32_t SORTED_SET_GALLOP_RATIO = 32;
+
+// first index in [from, size) with keys[index] >= key, probing 1, 2, 4... slots ahead
+static inline uint32_t sorted_set_gallop(const uint64_t* keys, uint32_t from, uint32_t size, uint64_t key) {
+  uint32_t to = from;
+  uint32_t step = 1;
+  while (to < size and keys[to] < key) {
+    from = to + 1;
+    to += step;
+    step <<= 1;
+  }
+  return std::lower_bound(&keys[from], &keys[std::min(to, size)], key) - keys;
+}
+
+// the keys of small that are in large, found by galloping through large
+static inline uint32_t sorted_set_gallop_intersection(const uint64_t* small, uint32_t small_size,
+    const uint64_t* large, uint32_t large_size, uint64_t* out) {
+  uint32_t count = 0;
+  uint32_t j = 0;
+  for (uint32_t i = 0; i < small_size and j < large_size; i++) {
+    j = sorted_set_gallop(large, j, large_size, small[i]);
+    if (j < large_size and large[j] == small[i]) out[count++] = large[j++];
+  }
+  return count;
+}
+
+/*
+ * The merge kernels: the keys of a that are in b (INTERSECT) or that are not.
+ * out must have room for a_size keys and may be a.
+ */
+
+// From a[i] and b[j] on, where the lanes of matched (bit 0 for a[i]) found their
+// key in b before b[j]
+template<bool INTERSECT>
+static inline uint32_t sorted_set_merge_tail(const uint64_t* a, uint32_t i, uint32_t a_size,
+    const uint64_t* b, uint32_t j, uint32_t b_size, uint32_t matched, uint64_t* out, uint32_t count) {
+  for (; matched != 0 and i < a_size; i++, matched >>= 1) {
+    const uint64_t key = a[i];
+    bool found = matched & 1;
+    if (!found) {
+      while (j < b_size and b[j] < key) j++;
+      found = j < b_size and b[j] == key;
+    }
+    if (found == INTERSECT) out[count++] = key;
+  }
+  while (i < a_size and j < b_size) {
+    // no branch on the comparison, which is unpredictable
+    const uint64_t x = a[i];
+    const uint64_t y = b[j];
+    out[count] = x;
+    count += INTERSECT ? x == y : x < y;
+    i += x <= y;
+    j += y <= x;
+  }
+  if (!INTERSECT) {
+    while (i < a_size) out[count++] = a[i++];
+  }
+  return count;
+}
+
+template<bool INTERSECT>
+static inline uint32_t sorted_set_merge_scalar(const uint64_t* a, uint32_t a_size, const uint64_t* b, uint32_t b_size, uint64_t* out) {
+  return sorted_set_merge_tail<INTERSECT>(a, 0, a_size, b, 0, b_size, 0, out, 0);
+}
+
+#ifdef THETA_SORTED_SET_SIMD_DISPATCH
+
+template<bool INTERSECT>
+__attribute__((target("avx2,popcnt")))
+static inline uint32_t sorted_set_merge_avx2(const uint64_t* a, uint32_t a_size, const uint64_t* b, uint32_t b_size, uint64_t* out) {
+  // 32-bit lane indices moving the 64-bit lanes set in the mask to the front
+  static const uint32_t PACK[16][8] = {
+    {0, 0, 0, 0, 0, 0, 0, 0}, {0, 1, 0, 0, 0, 0, 0, 0}, {2, 3, 0, 0, 0, 0, 0, 0}, {0, 1, 2, 3, 0, 0, 0, 0},
+    {4, 5, 0, 0, 0, 0, 0, 0}, {0, 1, 4, 5, 0, 0, 0, 0}, {2, 3, 4, 5, 0, 0, 0, 0}, {0, 1, 2, 3, 4, 5, 0, 0},
+    {6, 7, 0, 0, 0, 0, 0, 0}, {0, 1, 6, 7, 0, 0, 0, 0}, {2, 3, 6, 7, 0, 0, 0, 0}, {0, 1, 2, 3, 6, 7, 0, 0},
+    {4, 5, 6, 7, 0, 0, 0, 0}, {0, 1, 4, 5, 6, 7, 0, 0}, {2, 3, 4, 5, 6, 7, 0, 0}, {0, 1, 2, 3, 4, 5, 6, 7}
+  };
+  uint32_t i = 0;
+  uint32_t j = 0;
+  uint32_t count = 0;
+  uint32_t matched = 0;
+  if (a_size >= 4 and b_size >= 4) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+    for (;;) {
+      __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&b[j]));
+      __m256i eq = _mm256_cmpeq_epi64(va, vb);
+      vb = _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1));
+      eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, vb));
+      vb = _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1));
+      eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, vb));
+      vb = _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1));
+      eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, vb));
+      matched |= _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+      const uint64_t a_max = a[i + 3];
+      const uint64_t b_max = b[j + 3];
+      if (a_max <= b_max) {
+        // writes 4 keys, the ones past count + popcount are overwritten later
+        const uint32_t keep = INTERSECT ? matched : ~matched & 0xf;
+        const __m256i pack = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(PACK[keep]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[count]), _mm256_permutevar8x32_epi32(va, pack));
+        count += _mm_popcnt_u32(keep);
+        matched = 0;
+        i += 4;
+        if (i + 4 > a_size) break;
+        va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&a[i]));
+      }
+      if (b_max <= a_max) {
+        j += 4;
+        if (j + 4 > b_size) break;
+      }
+    }
+  }
+  return sorted_set_merge_tail<INTERSECT>(a, i, a_size, b, j, b_size, matched, out, count);
+}
+
+template<bool INTERSECT>
+__attribute__((target("avx512f,popcnt")))
+static inline uint32_t sorted_set_merge_avx512(const uint64_t* a, uint32_t a_size, const uint64_t* b, uint32_t b_size, uint64_t* out) {
+  uint32_t i = 0;
+  uint32_t j = 0;
+  uint32_t count = 0;
+  uint32_t matched = 0;
+  if (a_size >= 8 and b_size >= 8) {
+    __m512i va = _mm512_loadu_si512(a);
+    for (;;) {
+      __m512i vb = _mm512_loadu_si512(&b[j]);
+      __mmask8 eq = _mm512_cmpeq_epi64_mask(va, vb);
+      for (int r = 1; r < 8; r++) {
+        // rotates by one lane; the unmasked form starts from an undefined register, which -Wall flags
+        vb = _mm512_maskz_alignr_epi64(0xFF, vb, vb, 1);
+        eq |= _mm512_cmpeq_epi64_mask(va, vb);
+      }
+      matched |= eq;
+      const uint64_t a_max = a[i + 7];
+      const uint64_t b_max = b[j + 7];
+      if (a_max <= b_max) {
+        // writes 8 keys, the ones past count + popcount are overwritten later
+        const __mmask8 keep = INTERSECT ? matched : ~matched;
+        _mm512_storeu_si512(&out[count], _mm512_maskz_compress_epi64(keep, va));
+        count += _mm_popcnt_u32(keep);
+        matched = 0;
+        i += 8;
+        if (i + 8 > a_size) break;
+        va = _mm512_loadu_si512(&a[i]);
+      }
+      if (b_max <= a_max) {
+        j += 8;
+        if (j + 8 > b_size) break;
+      }
+    }
+  }
+  return sorted_set_merge_tail<INTERSECT>(a, i, a_size, b, j, b_size, matched, out, count);
+}
+
+#endif
+
+template<bool INTERSECT>
+static inline uint32_t sorted_set_merge(const uint64_t* a, uint32_t a_size, const uint64_t* b, uint32_t b_size, uint64_t* out) {
+#ifdef THETA_SORTED_SET_SIMD_DISPATCH
+  static const bool has_avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt");
+  static const bool has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+  if (has_avx512) return sorted_set_merge_avx512<INTERSECT>(a, a_size, b, b_size, out);
+  if (has_avx2) return sorted_set_merge_avx2<INTERSECT>(a, a_size, b, b_size, out);
+#endif
+  return sorted_set_merge_scalar<INTERSECT>(a, a_size, b, b_size, out);
+}
+
+/**
+ * Intersects two ascending key arrays, keeping the keys below theta.
+ * Merges both arrays, or gallops through the longer one when the lengths
+ * differ by SORTED_SET_GALLOP_RATIO or more.
+ * @param out room for a_size keys, may be a
+ * @return number of keys written to out
+ */
+static inline uint32_t sorted_set_intersection(const uint64_t* a, uint32_t a_size,
+    const uint64_t* b, uint32_t b_size, uint64_t theta, uint64_t* out) {
+  a_size = std::lower_bound(a, &a[a_size], theta) - a;
+  b_size = std::lower_bound(b, &b[b_size], theta) - b;
+  if (a_size / SORTED_SET_GALLOP_RATIO >= b_size) return sorted_set_gallop_intersection(b, b_size, a, a_size, out);
+  if (b_size / SORTED_SET_GALLOP_RATIO >= a_size) return sorted_set_gallop_intersection(a, a_size, b, b_size, out);
+  return sorted_set_merge<true>(a, a_size, b, b_size, out);
+}
+
+/**
+ * The keys below theta of the ascending array a that are not in the ascending array b.
+ * @param out room for a_size keys, may be a
+ * @return number of keys written to out
+ */
+static inline uint32_t sorted_set_difference(const uint64_t* a, uint32_t a_size,
+    const uint64_t* b, uint32_t b_size, uint64_t theta, uint64_t* out) {
+  a_size = std::lower_bound(a, &a[a_size], theta) - a;
+  b_size = std::lower_bound(b, &b[b_size], theta) - b;
+  return sorted_set_merge<false>(a, a_size, b, b_size, out);
+}
+
+/**
+ * The distinct keys below theta of num_runs ascending arrays, merged with a loser tree
+ * and written ascending, up to max_keys of them.
+ * @param out room for max_keys keys
+ * @param next set to the first distinct key left out, or to theta if none was
+ * @return number of keys written to out
+ */
+template<typename A>
+uint32_t sorted_set_union(const uint64_t* const* runs, const uint32_t* sizes, uint32_t num_runs,
+    uint64_t theta, uint32_t max_keys, uint64_t* out, uint64_t& next) {
+  next = theta;
+  if (num_runs == 0) return 0;
+  typedef typename std::allocator_traits<A>::template rebind_alloc<uint32_t> AllocU32;
+  typedef typename std::allocator_traits<A>::template rebind_alloc<uint64_t> AllocU64;
+  // keys are below theta, so an exhausted run never wins
+  const uint64_t done = std::numeric_limits<uint64_t>::max();
+  std::vector<uint32_t, AllocU32> positions(num_runs);
+  std::vector<uint32_t, AllocU32> ends(num_runs);
+  std::vector<uint64_t, AllocU64> heads(num_runs);
+  for (uint32_t i = 0; i < num_runs; i++) {
+    positions[i] = 0;
+    ends[i] = std::lower_bound(runs[i], &runs[i][sizes[i]], theta) - runs[i];
+    heads[i] = ends[i] > 0 ? runs[i][0] : done;
+  }
+
+  // leaf i sits at node num_runs + i, the internal nodes hold the losers of their match
+  // and node 0 the overall winner
+  std::vector<uint32_t, AllocU32> tree(num_runs);
+  {
+    std::vector<uint32_t, AllocU32> winners(2 * num_runs);
+    for (uint32_t i = 0; i < num_runs; i++) winners[num_runs + i] = i;
+    for (uint32_t node = num_runs - 1; node > 0; node--) {
+      const uint32_t left = winners[2 * node];
+      const uint32_t right = winners[2 * node + 1];
+      const bool left_wins = heads[left] <= heads[right];
+      winners[node] = left_wins ? left : right;
+      tree[node] = left_wins ? right : left;
+    }
+    tree[0] = winners[1];
+  }
+
+  uint32_t count = 0;
+  while (true) {
+    uint32_t winner = tree[0];
+    const uint64_t key = heads[winner];
+    if (key == done) break;
+    if (count == 0 or key != out[count - 1]) {
+      if (count == max_keys) {
+        next = key;
+        break;
+      }
+      out[count++] = key;
+    }
+    // advance the winning run and replay its path to the root
+    const uint32_t position = ++positions[winner];
+    heads[winner] = position < ends[winner] ? runs[winner][position] : done;
+    for (uint32_t node = (num_runs + winner) >> 1; node > 0; node >>= 1) {
+      if (heads[tree[node]] < heads[winner]) std::swap(tree[node], winner);
+    }
+    tree[0] = winner;
+  }
+  return count;
+}
+
+} /* namespace datasketches */
+
+# endif
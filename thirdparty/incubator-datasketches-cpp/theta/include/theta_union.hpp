@@ -23,8 +23,15 @@
 #include <memory>
 #include <functional>
 #include <climits>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <istream>
 
 #include <theta_sketch.hpp>
+#include <theta_sorted_set.hpp>
 
 namespace datasketches {
 
@@ -39,12 +46,66 @@ class theta_union_alloc {
 public:
   class builder;
   void update(const theta_sketch_alloc<A>& sketch);
+
+  /**
+   * Updates the union with a serialized sketch. 8-byte aligned compact sketches are read
+   * in place through a compact_theta_sketch_view, compressed compact sketches are decoded
+   * a block at a time up to theta, anything else is deserialized.
+   * @param bytes serialized compact or update sketch
+   * @param size size of the serialized sketch in bytes
+   */
+  void update(const void* bytes, size_t size);
+
+  /**
+   * Updates the union with a sketch read from a stream, without deserializing it: the keys
+   * go through a buffer of a block, and the keys of an ordered sketch from theta on are
+   * skipped without being decoded. The stream is left past the end of the sketch.
+   * @param is stream at the start of a serialized compact or update sketch
+   */
+  void update(std::istream& is);
+
+  /**
+   * Updates the union with a range of sketches (or views).
+   * While the union holds no hashed keys and all the inputs are ordered, their keys
+   * are merged straight into the sorted result, which stops at the nominal number
+   * of keys. Otherwise the sketches are given to update() one by one.
+   * @param first, last range of elements convertible to const theta_sketch_alloc<A>&
+   */
+  template<typename InputIt>
+  void update(InputIt first, InputIt last);
+
+  /**
+   * Updates the union with a range of sketches (or views) on the threads of a pool.
+   * The range is split into num_tasks partitions, each unioned by a worker union of
+   * the same configuration, then the workers are combined pairwise. The workers share
+   * the lowest theta any of them has reached and skip the keys at or above it.
+   * The result is the one of update(first, last).
+   * @param first, last range of elements convertible to const theta_sketch_alloc<A>&,
+   * which must stay valid until the call returns
+   * @param executor called as executor(task) with a std::function<void()>, it runs the
+   * task on a thread of its own (running it inline is fine, but serial)
+   */
+  template<typename InputIt, typename Executor>
+  void update(InputIt first, InputIt last, Executor& executor, unsigned num_tasks);
+
   compact_theta_sketch_alloc<A> get_result(bool ordered = true) const;
 
 private:
+  typedef typename std::allocator_traits<A>::template rebind_alloc<uint64_t> AllocU64;
   bool is_empty_;
   uint64_t theta_;
   update_theta_sketch_alloc<A> state_;
+  std::vector<uint64_t, AllocU64> merged_keys_; // ascending, from update(first, last) while state_ holds no keys
+
+  // sketches a worker unions between two looks at the theta shared by the workers
+  static const uint32_t PARALLEL_BATCH_SIZE = 64;
+
+  void hash_merged_keys();
+  // an empty union of the same configuration
+  theta_union_alloc<A> make_empty() const;
+  // runs the tasks on the executor, returns when all are done and rethrows the first failure
+  template<typename Executor, typename Task>
+  static void run_tasks(Executor& executor, const std::vector<Task>& tasks);
 
   // for builder
   theta_union_alloc(uint64_t theta, update_theta_sketch_alloc<A>&& state);
@@ -30,7 +30,7 @@ namespace datasketches {
 
 template<typename A>
 theta_union_alloc<A>::theta_union_alloc(uint64_t theta, update_theta_sketch_alloc<A>&& state):
-is_empty_(true), theta_(theta), state_(std::move(state)) {}
+is_empty_(true), theta_(theta), state_(std::move(state)), merged_keys_() {}
 
 template<typename A>
 void theta_union_alloc<A>::update(const theta_sketch_alloc<A>& sketch) {
@@ -38,6 +38,7 @@ void theta_union_alloc<A>::update(const theta_sketch_alloc<A>& sketch) {
   if (sketch.get_seed_hash() != state_.get_seed_hash()) throw std::invalid_argument("seed hash mismatch");
   is_empty_ = false;
   if (sketch.get_theta64() < theta_) theta_ = sketch.get_theta64();
+  hash_merged_keys();
   if (sketch.is_ordered()) {
     for (auto hash: sketch) {
       if (hash >= theta_) break; // early stop
@@ -49,13 +50,249 @@ void theta_union_alloc<A>::update(const theta_sketch_alloc<A>& sketch) {
   if (state_.get_theta64() < theta_) theta_ = state_.get_theta64();
 }
 
+template<typename A>
+void theta_union_alloc<A>::update(const void* bytes, size_t size) {
+  theta_sketch_alloc<A>::check_size(size, 8);
+  const char* ptr = static_cast<const char*>(bytes);
+  uint8_t preamble_longs;
+  copy_from_mem(&ptr, &preamble_longs, sizeof(preamble_longs));
+  uint8_t serial_version;
+  copy_from_mem(&ptr, &serial_version, sizeof(serial_version));
+  uint8_t type;
+  copy_from_mem(&ptr, &type, sizeof(type));
+  uint8_t lg_nom_size;
+  copy_from_mem(&ptr, &lg_nom_size, sizeof(lg_nom_size));
+  uint8_t lg_cur_size;
+  copy_from_mem(&ptr, &lg_cur_size, sizeof(lg_cur_size));
+  uint8_t flags_byte;
+  copy_from_mem(&ptr, &flags_byte, sizeof(flags_byte));
+  uint16_t seed_hash;
+  copy_from_mem(&ptr, &seed_hash, sizeof(seed_hash));
+
+  if (type == update_theta_sketch_alloc<A>::SKETCH_TYPE) {
+    theta_sketch_alloc<A>::check_serial_version(serial_version, theta_sketch_alloc<A>::SERIAL_VERSION);
+    theta_sketch_alloc<A>::check_seed_hash(seed_hash, state_.get_seed_hash());
+    typename update_theta_sketch_alloc<A>::resize_factor rf = static_cast<typename update_theta_sketch_alloc<A>::resize_factor>(preamble_longs >> 6);
+    update(update_theta_sketch_alloc<A>::internal_deserialize(ptr, size - (ptr - static_cast<const char*>(bytes)), rf, lg_cur_size, lg_nom_size, flags_byte, state_.seed_));
+    return;
+  }
+  theta_sketch_alloc<A>::check_sketch_type(type, compact_theta_sketch_alloc<A>::SKETCH_TYPE);
+  compact_theta_sketch_alloc<A>::check_compact_serial_version(serial_version);
+  const bool is_empty = flags_byte & (1 << theta_sketch_alloc<A>::flags::IS_EMPTY);
+  if (is_empty) return;
+  theta_sketch_alloc<A>::check_seed_hash(seed_hash, state_.get_seed_hash());
+  if (serial_version == theta_sketch_alloc<A>::SERIAL_VERSION) {
+    if (reinterpret_cast<uintptr_t>(bytes) % sizeof(uint64_t) == 0) {
+      update(compact_theta_sketch_view_alloc<A>(bytes, size, state_.seed_));
+    } else {
+      update(compact_theta_sketch_alloc<A>::internal_deserialize(ptr, size - (ptr - static_cast<const char*>(bytes)), serial_version, preamble_longs, flags_byte, seed_hash));
+    }
+    return;
+  }
+
+  // compressed, the rest of the preamble as compact_theta_sketch_alloc<A>::internal_deserialize() reads it
+  uint32_t num_keys = 1;
+  uint64_t theta = theta_sketch_alloc<A>::MAX_THETA;
+  if (preamble_longs > 1) {
+    theta_sketch_alloc<A>::check_size(size, 16);
+    copy_from_mem(&ptr, &num_keys, sizeof(num_keys));
+    ptr += sizeof(uint32_t);
+    if (preamble_longs > 2) {
+      theta_sketch_alloc<A>::check_size(size, 24);
+      copy_from_mem(&ptr, &theta, sizeof(theta));
+    }
+  }
+  compact_theta_sketch_alloc<A>::check_packed_keys(ptr, size - (ptr - static_cast<const char*>(bytes)), num_keys);
+  is_empty_ = false;
+  if (theta < theta_) theta_ = theta;
+  hash_merged_keys();
+  packed_keys_reader reader(ptr, num_keys);
+  uint64_t block[PACKED_KEYS_BLOCK_SIZE];
+  for (uint32_t count = reader.next(block); count > 0 and block[0] < theta_; count = reader.next(block)) {
+    for (uint32_t i = 0; i < count and block[i] < theta_; i++) state_.internal_update(block[i]);
+  }
+  if (state_.get_theta64() < theta_) theta_ = state_.get_theta64();
+}
+
+template<typename A>
+void theta_union_alloc<A>::update(std::istream& is) {
+  typename theta_sketch_alloc<A>::stream_key_reader reader(is, state_.get_seed_hash());
+  if (reader.is_empty()) {
+    reader.skip();
+    return;
+  }
+  is_empty_ = false;
+  if (reader.get_theta64() < theta_) theta_ = reader.get_theta64();
+  hash_merged_keys();
+  uint64_t block[theta_sketch_alloc<A>::stream_key_reader::BLOCK_SIZE];
+  for (uint32_t count = reader.next(block); count > 0; count = reader.next(block)) {
+    if (reader.is_ordered() and block[0] >= theta_) {
+      reader.skip(); // early stop
+      break;
+    }
+    for (uint32_t i = 0; i < count; i++) if (block[i] < theta_) state_.internal_update(block[i]);
+  }
+  if (state_.get_theta64() < theta_) theta_ = state_.get_theta64();
+}
+
+template<typename A>
+template<typename InputIt>
+void theta_union_alloc<A>::update(InputIt first, InputIt last) {
+  typedef typename std::allocator_traits<A>::template rebind_alloc<const theta_sketch_alloc<A>*> AllocSketchPtr;
+  std::vector<const theta_sketch_alloc<A>*, AllocSketchPtr> sketches;
+  bool all_ordered = true;
+  for (; first != last; ++first) {
+    const theta_sketch_alloc<A>& sketch = *first;
+    if (sketch.is_empty()) continue;
+    if (sketch.get_seed_hash() != state_.get_seed_hash()) throw std::invalid_argument("seed hash mismatch");
+    sketches.push_back(&sketch);
+    all_ordered &= sketch.is_ordered();
+  }
+  if (sketches.empty()) return;
+  if (!all_ordered or state_.get_num_retained() > 0) {
+    for (const theta_sketch_alloc<A>* sketch: sketches) update(*sketch);
+    return;
+  }
+  is_empty_ = false;
+  typedef typename std::allocator_traits<A>::template rebind_alloc<const uint64_t*> AllocKeysPtr;
+  typedef typename std::allocator_traits<A>::template rebind_alloc<uint32_t> AllocU32;
+  std::vector<const uint64_t*, AllocKeysPtr> runs;
+  std::vector<uint32_t, AllocU32> sizes;
+  runs.reserve(sketches.size() + 1);
+  sizes.reserve(sketches.size() + 1);
+  uint64_t num_keys = merged_keys_.size();
+  runs.push_back(merged_keys_.data());
+  sizes.push_back(merged_keys_.size());
+  for (const theta_sketch_alloc<A>* sketch: sketches) {
+    theta_ = std::min(theta_, sketch->get_theta64());
+    runs.push_back(theta_sketch_alloc<A>::get_ordered_keys(*sketch));
+    sizes.push_back(sketch->get_num_retained());
+    num_keys += sketch->get_num_retained();
+  }
+  // past the nominal number of keys, the next one is the new theta
+  const uint32_t nom_num_keys = 1 << state_.lg_nom_size_;
+  std::vector<uint64_t, AllocU64> keys(std::min<uint64_t>(num_keys, nom_num_keys));
+  keys.resize(sorted_set_union<A>(runs.data(), sizes.data(), runs.size(), theta_, keys.size(), keys.data(), theta_));
+  merged_keys_ = std::move(keys);
+}
+
+template<typename A>
+template<typename InputIt, typename Executor>
+void theta_union_alloc<A>::update(InputIt first, InputIt last, Executor& executor, unsigned num_tasks) {
+  typedef std::reference_wrapper<const theta_sketch_alloc<A>> sketch_ref;
+  typedef typename std::allocator_traits<A>::template rebind_alloc<sketch_ref> AllocSketchRef;
+  std::vector<sketch_ref, AllocSketchRef> sketches;
+  for (; first != last; ++first) {
+    const theta_sketch_alloc<A>& sketch = *first;
+    if (!sketch.is_empty() and sketch.get_seed_hash() != state_.get_seed_hash()) throw std::invalid_argument("seed hash mismatch");
+    sketches.push_back(sketch);
+  }
+  const size_t num_workers = std::min<size_t>(std::max(num_tasks, 1U), sketches.size());
+  if (num_workers <= 1) {
+    update(sketches.begin(), sketches.end());
+    return;
+  }
+
+  typedef typename std::allocator_traits<A>::template rebind_alloc<theta_union_alloc<A>> AllocUnion;
+  std::vector<theta_union_alloc<A>, AllocUnion> workers;
+  workers.reserve(num_workers);
+  for (size_t i = 0; i < num_workers; i++) workers.push_back(make_empty());
+  // keys at or above the theta of any worker cannot make it into the result
+  std::atomic<uint64_t> shared_theta(theta_);
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < num_workers; i++) {
+    const size_t begin = sketches.size() * i / num_workers;
+    const size_t end = sketches.size() * (i + 1) / num_workers;
+    theta_union_alloc<A>& worker = workers[i];
+    tasks.push_back([&sketches, &shared_theta, &worker, begin, end]() {
+      for (size_t from = begin; from < end; from += PARALLEL_BATCH_SIZE) {
+        worker.theta_ = std::min(worker.theta_, shared_theta.load(std::memory_order_relaxed));
+        worker.update(sketches.begin() + from, sketches.begin() + std::min<size_t>(from + PARALLEL_BATCH_SIZE, end));
+        uint64_t theta = shared_theta.load(std::memory_order_relaxed);
+        while (worker.theta_ < theta and !shared_theta.compare_exchange_weak(theta, worker.theta_, std::memory_order_relaxed)) {}
+      }
+    });
+  }
+  run_tasks(executor, tasks);
+
+  // pairwise, the results of the workers are ordered and merge without the hash table
+  for (size_t step = 1; step < num_workers; step *= 2) {
+    tasks.clear();
+    for (size_t i = 0; i + step < num_workers; i += 2 * step) {
+      theta_union_alloc<A>& worker = workers[i];
+      const theta_union_alloc<A>& other = workers[i + step];
+      tasks.push_back([&worker, &other]() {
+        const compact_theta_sketch_alloc<A> result = other.get_result();
+        worker.update(&result, &result + 1);
+      });
+    }
+    run_tasks(executor, tasks);
+  }
+  const compact_theta_sketch_alloc<A> result = workers[0].get_result();
+  update(&result, &result + 1);
+}
+
+template<typename A>
+template<typename Executor, typename Task>
+void theta_union_alloc<A>::run_tasks(Executor& executor, const std::vector<Task>& tasks) {
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t pending = tasks.size();
+  std::exception_ptr error;
+  for (size_t i = 0; i < tasks.size(); i++) {
+    const Task& task = tasks[i];
+    try {
+      executor(std::function<void()>([&task, &mutex, &done, &pending, &error]() {
+        std::exception_ptr task_error;
+        try {
+          task();
+        } catch (...) {
+          task_error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (task_error and !error) error = task_error;
+        if (--pending == 0) done.notify_one();
+      }));
+    } catch (...) {
+      // the tasks given so far still refer to this frame, wait for them
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error) error = std::current_exception();
+      pending -= tasks.size() - i;
+      break;
+    }
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&pending]() { return pending == 0; });
+  if (error) std::rethrow_exception(error);
+}
+
+template<typename A>
+theta_union_alloc<A> theta_union_alloc<A>::make_empty() const {
+  typename update_theta_sketch_alloc<A>::builder builder;
+  builder.set_lg_k(state_.lg_nom_size_).set_resize_factor(state_.rf_).set_p(state_.p_).set_seed(state_.seed_);
+  update_theta_sketch_alloc<A> sketch = builder.build();
+  return theta_union_alloc(sketch.get_theta64(), std::move(sketch));
+}
+
+template<typename A>
+void theta_union_alloc<A>::hash_merged_keys() {
+  for (uint64_t key: merged_keys_) state_.internal_update(key);
+  merged_keys_.clear();
+  merged_keys_.shrink_to_fit();
+}
+
 template<typename A>
 compact_theta_sketch_alloc<A> theta_union_alloc<A>::get_result(bool ordered) const {
   if (is_empty_) return state_.compact(ordered);
+  if (!merged_keys_.empty()) {
+    // already sorted and trimmed, ordered or not
+    uint64_t* keys = AllocU64().allocate(merged_keys_.size());
+    std::copy(merged_keys_.begin(), merged_keys_.end(), keys);
+    return compact_theta_sketch_alloc<A>(false, theta_, keys, merged_keys_.size(), state_.get_seed_hash(), ordered);
+  }
   const uint32_t nom_num_keys = 1 << state_.lg_nom_size_;
   if (theta_ >= state_.theta_ and state_.get_num_retained() <= nom_num_keys) return state_.compact(ordered);
   uint64_t theta = std::min(theta_, state_.get_theta64());
-  typedef typename std::allocator_traits<A>::template rebind_alloc<uint64_t> AllocU64;
   uint64_t* keys = AllocU64().allocate(state_.get_num_retained());
   uint32_t num_keys = 0;
   for (auto key: state_) {
@@ -22,6 +22,9 @@
 
 #include <theta_a_not_b.hpp>
 
+#include <algorithm>
+#include <vector>
+
 namespace datasketches {
 
 class theta_a_not_b_test: public CppUnit::TestFixture {
@@ -36,6 +39,8 @@ class theta_a_not_b_test: public CppUnit::TestFixture {
   CPPUNIT_TEST(estimation_mode_disjoint);
   CPPUNIT_TEST(estimation_mode_full_overlap);
   CPPUNIT_TEST(seed_mismatch);
+  CPPUNIT_TEST(compact_views);
+  CPPUNIT_TEST(ordered_same_as_unordered);
   CPPUNIT_TEST_SUITE_END();
 
   void empty() {
@@ -232,6 +237,57 @@ class theta_a_not_b_test: public CppUnit::TestFixture {
     CPPUNIT_ASSERT_THROW(a_not_b.compute(sketch, sketch), std::invalid_argument);
   }
 
+  void compact_views() {
+    // estimation mode on both sides with different thetas, views of ordered and unordered sketches
+    update_theta_sketch a = update_theta_sketch::builder().set_lg_k(10).build();
+    for (int i = 0; i < 10000; i++) a.update(i);
+    update_theta_sketch b = update_theta_sketch::builder().set_lg_k(11).build();
+    for (int i = 5000; i < 15000; i++) b.update(i);
+    for (bool ordered: {true, false}) {
+      const compact_theta_sketch compact_a = a.compact(ordered);
+      const compact_theta_sketch compact_b = b.compact(ordered);
+      auto bytes_a = compact_a.serialize();
+      auto bytes_b = compact_b.serialize();
+      const compact_theta_sketch_view view_a(bytes_a.first.get(), bytes_a.second);
+      const compact_theta_sketch_view view_b(bytes_b.first.get(), bytes_b.second);
+
+      theta_a_not_b a_not_b;
+      const compact_theta_sketch expected = a_not_b.compute(compact_a, compact_b);
+      CPPUNIT_ASSERT(expected.get_num_retained() > 0);
+      const std::vector<uint64_t> expected_keys(expected.begin(), expected.end());
+      // either side, or both, as a view
+      for (const compact_theta_sketch& result: {a_not_b.compute(view_a, compact_b), a_not_b.compute(compact_a, view_b), a_not_b.compute(view_a, view_b)}) {
+        CPPUNIT_ASSERT_EQUAL(expected.get_theta64(), result.get_theta64());
+        CPPUNIT_ASSERT(expected_keys == std::vector<uint64_t>(result.begin(), result.end()));
+      }
+    }
+
+    // a view of an empty b leaves a as it is
+    auto bytes_empty = update_theta_sketch::builder().build().compact().serialize();
+    const compact_theta_sketch_view empty(bytes_empty.first.get(), bytes_empty.second);
+    const compact_theta_sketch result = theta_a_not_b().compute(a.compact(), empty);
+    const compact_theta_sketch compact_a = a.compact();
+    CPPUNIT_ASSERT_EQUAL(compact_a.get_theta64(), result.get_theta64());
+    CPPUNIT_ASSERT(std::vector<uint64_t>(compact_a.begin(), compact_a.end()) == std::vector<uint64_t>(result.begin(), result.end()));
+  }
+
+
+  void ordered_same_as_unordered() {
+    // b has the lower theta, the keys of a above it must go in both paths
+    update_theta_sketch a = update_theta_sketch::builder().set_lg_k(14).build();
+    for (int i = 0; i < 100000; i++) a.update(i);
+    update_theta_sketch b = update_theta_sketch::builder().set_lg_k(12).build();
+    for (int i = 50000; i < 150000; i++) b.update(i);
+
+    theta_a_not_b a_not_b;
+    compact_theta_sketch result1 = a_not_b.compute(a, b);
+    compact_theta_sketch result2 = a_not_b.compute(a.compact(), b.compact());
+    CPPUNIT_ASSERT_EQUAL(b.get_theta64(), result2.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(result1.get_num_retained(), result2.get_num_retained());
+    CPPUNIT_ASSERT(std::equal(result1.begin(), result1.end(), result2.begin()));
+    for (auto key: result2) CPPUNIT_ASSERT(key < result2.get_theta64());
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(theta_a_not_b_test);
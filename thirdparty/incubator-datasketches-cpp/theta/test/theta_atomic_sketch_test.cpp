@@ -0,0 +1,157 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <theta_atomic_sketch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace datasketches {
+
+class theta_atomic_sketch_test: public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE(theta_atomic_sketch_test);
+  CPPUNIT_TEST(empty);
+  CPPUNIT_TEST(exact_mode_same_keys);
+  CPPUNIT_TEST(estimation_mode);
+  CPPUNIT_TEST(many_threads_exact);
+  CPPUNIT_TEST(many_threads_estimation);
+  CPPUNIT_TEST(estimate_during_rebuilds);
+  CPPUNIT_TEST_SUITE_END();
+
+  static std::vector<uint64_t> sorted_keys(const theta_sketch& sketch) {
+    std::vector<uint64_t> keys(sketch.begin(), sketch.end());
+    std::sort(keys.begin(), keys.end());
+    return keys;
+  }
+
+  void empty() {
+    atomic_update_theta_sketch sketch;
+    CPPUNIT_ASSERT(sketch.is_empty());
+    CPPUNIT_ASSERT_EQUAL(0.0, sketch.get_estimate());
+    CPPUNIT_ASSERT_EQUAL(1.0, sketch.get_theta());
+    compact_theta_sketch compact = sketch.compact();
+    CPPUNIT_ASSERT(compact.is_empty());
+    CPPUNIT_ASSERT_EQUAL(sketch.get_seed_hash(), compact.get_seed_hash());
+  }
+
+  void exact_mode_same_keys() {
+    atomic_update_theta_sketch sketch(12);
+    update_theta_sketch update_sketch = update_theta_sketch::builder().set_lg_k(12).build();
+    for (int i = 0; i < 1000; i++) {
+      sketch.update(i);
+      update_sketch.update(i);
+      sketch.update(i); // duplicates are ignored
+      sketch.update(std::to_string(i));
+      update_sketch.update(std::to_string(i));
+      sketch.update(i + 0.5);
+      update_sketch.update(i + 0.5);
+    }
+    CPPUNIT_ASSERT(!sketch.is_empty());
+    CPPUNIT_ASSERT_EQUAL(3000.0, sketch.get_estimate());
+    CPPUNIT_ASSERT_EQUAL(update_sketch.get_num_retained(), sketch.get_num_retained());
+    CPPUNIT_ASSERT(sorted_keys(update_sketch) == sorted_keys(sketch.compact()));
+  }
+
+  void estimation_mode() {
+    // one thread updates in the same order, resizes and rebuilds give the same theta
+    atomic_update_theta_sketch sketch(10, 123);
+    update_theta_sketch update_sketch = update_theta_sketch::builder().set_lg_k(10).set_seed(123).build();
+    for (int i = 0; i < 100000; i++) {
+      sketch.update(i);
+      update_sketch.update(i);
+    }
+    CPPUNIT_ASSERT(sketch.get_theta() < 1);
+    CPPUNIT_ASSERT_EQUAL(update_sketch.get_theta64(), sketch.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(update_sketch.get_estimate(), sketch.get_estimate());
+    compact_theta_sketch compact = sketch.compact();
+    CPPUNIT_ASSERT(sorted_keys(update_sketch) == sorted_keys(compact));
+    CPPUNIT_ASSERT_EQUAL(update_sketch.get_seed_hash(), compact.get_seed_hash());
+  }
+
+  void many_threads_exact() {
+    // all threads update the same values, the table grows meanwhile
+    const int num_threads = 8;
+    const int n = 2000;
+    atomic_update_theta_sketch sketch(12);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&sketch, t, n]() {
+        for (int i = 0; i < n; i++) sketch.update((i * 7 + t * 13) % n);
+      });
+    }
+    for (auto& thread: threads) thread.join();
+    update_theta_sketch update_sketch = update_theta_sketch::builder().set_lg_k(12).build();
+    for (int i = 0; i < n; i++) update_sketch.update(i);
+    CPPUNIT_ASSERT_EQUAL(static_cast<double>(n), sketch.get_estimate());
+    CPPUNIT_ASSERT(sorted_keys(update_sketch) == sorted_keys(sketch.compact()));
+  }
+
+  void many_threads_estimation() {
+    const int num_threads = 8;
+    const int n = 50000;
+    atomic_update_theta_sketch sketch(9);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&sketch, t, n]() {
+        for (int i = 0; i < n; i++) sketch.update(static_cast<uint64_t>(t) * n + i);
+      });
+    }
+    for (auto& thread: threads) thread.join();
+    const double exact = num_threads * n;
+    compact_theta_sketch compact = sketch.compact();
+    CPPUNIT_ASSERT_EQUAL(sketch.get_num_retained(), compact.get_num_retained());
+    CPPUNIT_ASSERT(compact.get_lower_bound(3) <= exact);
+    CPPUNIT_ASSERT(exact <= compact.get_upper_bound(3));
+    for (auto key: compact) CPPUNIT_ASSERT(key < compact.get_theta64());
+  }
+
+  void estimate_during_rebuilds() {
+    // A count from before a rebuild with the theta from after it would be
+    // almost twice the number of keys, so far off the error bounds.
+    const uint64_t n = 200000;
+    atomic_update_theta_sketch sketch(9);
+    std::atomic<uint64_t> inserted(0);
+    std::thread writer([&sketch, &inserted, n]() {
+      for (uint64_t i = 0; i < n; i++) {
+        sketch.update(i);
+        inserted.store(i + 1, std::memory_order_release);
+      }
+    });
+    double max_ratio = 0;
+    while (inserted.load(std::memory_order_acquire) < n) {
+      const double estimate = sketch.get_estimate();
+      const uint64_t upper = inserted.load(std::memory_order_acquire);
+      if (upper > 10000) max_ratio = std::max(max_ratio, estimate / upper);
+    }
+    writer.join();
+    CPPUNIT_ASSERT(max_ratio < 1.5);
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(theta_atomic_sketch_test);
+
+} /* namespace datasketches */
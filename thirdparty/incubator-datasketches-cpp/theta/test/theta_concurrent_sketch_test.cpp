@@ -0,0 +1,116 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <theta_concurrent_sketch.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace datasketches {
+
+class theta_concurrent_sketch_test: public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE(theta_concurrent_sketch_test);
+  CPPUNIT_TEST(empty);
+  CPPUNIT_TEST(same_as_update_sketch);
+  CPPUNIT_TEST(bounded_staleness);
+  CPPUNIT_TEST(many_threads);
+  CPPUNIT_TEST_SUITE_END();
+
+  void empty() {
+    concurrent_theta_sketch sketch(update_theta_sketch::builder().build());
+    {
+      concurrent_theta_sketch::local_buffer buffer(sketch);
+    }
+    CPPUNIT_ASSERT(sketch.is_empty());
+    CPPUNIT_ASSERT_EQUAL(0.0, sketch.get_estimate());
+    CPPUNIT_ASSERT_EQUAL(1.0, sketch.get_theta());
+    CPPUNIT_ASSERT(sketch.compact().is_empty());
+  }
+
+  void same_as_update_sketch() {
+    // one writer keeps the order of the updates, so the retained keys are the same
+    update_theta_sketch update_sketch = update_theta_sketch::builder().set_lg_k(10).build();
+    concurrent_theta_sketch sketch(update_theta_sketch::builder().set_lg_k(10).build(), 100);
+    {
+      concurrent_theta_sketch::local_buffer buffer(sketch);
+      for (int i = 0; i < 20000; i++) {
+        update_sketch.update(static_cast<uint64_t>(i));
+        buffer.update(static_cast<uint64_t>(i));
+        update_sketch.update(-static_cast<int64_t>(i));
+        buffer.update(-static_cast<int64_t>(i));
+        update_sketch.update(i + 0.5);
+        buffer.update(i + 0.5);
+        update_sketch.update(std::to_string(i));
+        buffer.update(std::to_string(i));
+      }
+    }
+    CPPUNIT_ASSERT(sketch.get_theta() < 1);
+    CPPUNIT_ASSERT_EQUAL(update_sketch.get_theta64(), sketch.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(update_sketch.get_estimate(), sketch.get_estimate());
+    compact_theta_sketch compact1 = update_sketch.compact();
+    compact_theta_sketch compact2 = sketch.compact();
+    CPPUNIT_ASSERT_EQUAL(compact1.get_num_retained(), compact2.get_num_retained());
+    auto it = compact1.begin();
+    for (auto key: compact2) {
+      CPPUNIT_ASSERT_EQUAL(*it, key);
+      ++it;
+    }
+  }
+
+  void bounded_staleness() {
+    concurrent_theta_sketch sketch(update_theta_sketch::builder().build(), 100);
+    concurrent_theta_sketch::local_buffer buffer(sketch);
+    for (int i = 0; i < 250; i++) buffer.update(i);
+    CPPUNIT_ASSERT(!sketch.is_empty());
+    CPPUNIT_ASSERT_EQUAL(200.0, sketch.get_estimate());
+    buffer.flush();
+    CPPUNIT_ASSERT_EQUAL(250.0, sketch.get_estimate());
+  }
+
+  void many_threads() {
+    const int num_threads = 8;
+    const int n = 100000;
+    concurrent_theta_sketch sketch(update_theta_sketch::builder().set_lg_k(12).build());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&sketch, t, n]() {
+        concurrent_theta_sketch::local_buffer buffer(sketch);
+        // half of the values are shared by all threads
+        for (int i = 0; i < n; i++) buffer.update(i % 2 == 0 ? i : t * n + i);
+      });
+    }
+    for (auto& thread: threads) thread.join();
+    const double exact = n / 2 + num_threads * n / 2;
+    compact_theta_sketch result = sketch.compact();
+    CPPUNIT_ASSERT_EQUAL(sketch.get_estimate(), result.get_estimate());
+    CPPUNIT_ASSERT(result.get_lower_bound(3) <= exact);
+    CPPUNIT_ASSERT(exact <= result.get_upper_bound(3));
+    for (auto key: result) CPPUNIT_ASSERT(key < result.get_theta64());
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(theta_concurrent_sketch_test);
+
+} /* namespace datasketches */
@@ -0,0 +1,226 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <theta_direct_sketch.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace datasketches {
+
+class theta_direct_sketch_test: public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE(theta_direct_sketch_test);
+  CPPUNIT_TEST(empty);
+  CPPUNIT_TEST(same_as_update_sketch);
+  CPPUNIT_TEST(wrap_again);
+  CPPUNIT_TEST(wrap_serialized);
+  CPPUNIT_TEST(memory_request);
+  CPPUNIT_TEST(memory_full);
+  CPPUNIT_TEST(memory_request_failed);
+  CPPUNIT_TEST(invalid_memory);
+  CPPUNIT_TEST_SUITE_END();
+
+  static std::vector<uint64_t> sorted_keys(const theta_sketch& sketch) {
+    std::vector<uint64_t> keys(sketch.begin(), sketch.end());
+    std::sort(keys.begin(), keys.end());
+    return keys;
+  }
+
+  // 8-byte aligned memory
+  static std::vector<uint64_t> memory_for(uint8_t lg_k) {
+    return std::vector<uint64_t>(direct_update_theta_sketch::get_max_serialized_size_bytes(lg_k) / sizeof(uint64_t));
+  }
+
+  void empty() {
+    std::vector<uint64_t> mem = memory_for(12);
+    direct_update_theta_sketch sketch = direct_update_theta_sketch::initialize(mem.data(), mem.size() * sizeof(uint64_t));
+    CPPUNIT_ASSERT(sketch.is_empty());
+    CPPUNIT_ASSERT_EQUAL(0.0, sketch.get_estimate());
+    CPPUNIT_ASSERT_EQUAL(1.0, sketch.get_theta());
+    CPPUNIT_ASSERT(sketch.compact().is_empty());
+
+    // the memory is a serialized empty update sketch
+    update_theta_sketch update_sketch = update_theta_sketch::builder().build();
+    auto bytes = update_sketch.serialize();
+    CPPUNIT_ASSERT_EQUAL(bytes.second, sketch.get_serialized_size_bytes());
+    CPPUNIT_ASSERT(std::memcmp(bytes.first.get(), sketch.get_memory(), bytes.second) == 0);
+  }
+
+  void same_as_update_sketch() {
+    // same resizes and rebuilds, same preamble and keys
+    std::vector<uint64_t> mem = memory_for(10);
+    update_theta_sketch::builder builder;
+    builder.set_lg_k(10).set_resize_factor(update_theta_sketch::resize_factor::X2).set_p(0.5).set_seed(123);
+    direct_update_theta_sketch sketch = direct_update_theta_sketch::initialize(mem.data(), mem.size() * sizeof(uint64_t), builder);
+    update_theta_sketch update_sketch = builder.build();
+    for (int i = 0; i < 100000; i++) {
+      sketch.update(i);
+      update_sketch.update(i);
+      sketch.update(std::to_string(i));
+      update_sketch.update(std::to_string(i));
+    }
+    CPPUNIT_ASSERT(sketch.get_theta() < 0.5);
+    CPPUNIT_ASSERT_EQUAL(update_sketch.get_theta64(), sketch.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(update_sketch.get_estimate(), sketch.get_estimate());
+    CPPUNIT_ASSERT(sorted_keys(update_sketch) == sorted_keys(sketch.compact()));
+    auto bytes = update_sketch.serialize();
+    CPPUNIT_ASSERT_EQUAL(bytes.second, sketch.get_serialized_size_bytes());
+    CPPUNIT_ASSERT(std::memcmp(bytes.first.get(), sketch.get_memory(), 3 * sizeof(uint64_t)) == 0);
+    update_theta_sketch deserialized = update_theta_sketch::deserialize(sketch.get_memory(), sketch.get_serialized_size_bytes(), 123);
+    CPPUNIT_ASSERT(sorted_keys(update_sketch) == sorted_keys(deserialized));
+  }
+
+  void wrap_again() {
+    // as after a restart of a process that kept the sketch in a mapped file
+    std::vector<uint64_t> mem = memory_for(12);
+    const size_t size = mem.size() * sizeof(uint64_t);
+    {
+      direct_update_theta_sketch sketch = direct_update_theta_sketch::initialize(mem.data(), size);
+      for (int i = 0; i < 3000; i++) sketch.update(i);
+    }
+    direct_update_theta_sketch sketch = direct_update_theta_sketch::wrap(mem.data(), size);
+    CPPUNIT_ASSERT_EQUAL(3000.0, sketch.get_estimate());
+    for (int i = 0; i < 20000; i++) sketch.update(i);
+    update_theta_sketch update_sketch = update_theta_sketch::builder().build();
+    for (int i = 0; i < 20000; i++) update_sketch.update(i);
+    CPPUNIT_ASSERT_EQUAL(update_sketch.get_theta64(), sketch.get_theta64());
+    CPPUNIT_ASSERT(sorted_keys(update_sketch) == sorted_keys(sketch.compact()));
+
+    // readable as a regular update sketch
+    update_theta_sketch deserialized = update_theta_sketch::deserialize(mem.data(), size);
+    CPPUNIT_ASSERT_EQUAL(sketch.get_estimate(), deserialized.get_estimate());
+    CPPUNIT_ASSERT(sorted_keys(update_sketch) == sorted_keys(deserialized));
+  }
+
+  void wrap_serialized() {
+    update_theta_sketch update_sketch = update_theta_sketch::builder().set_lg_k(11).build();
+    for (int i = 0; i < 1000; i++) update_sketch.update(i);
+    std::vector<uint64_t> mem = memory_for(11);
+    auto bytes = update_sketch.serialize();
+    std::memcpy(mem.data(), bytes.first.get(), bytes.second);
+    direct_update_theta_sketch sketch = direct_update_theta_sketch::wrap(mem.data(), mem.size() * sizeof(uint64_t));
+    CPPUNIT_ASSERT_EQUAL(1000.0, sketch.get_estimate());
+    for (int i = 0; i < 10000; i++) {
+      sketch.update(i);
+      update_sketch.update(i);
+    }
+    CPPUNIT_ASSERT_EQUAL(update_sketch.get_theta64(), sketch.get_theta64());
+    CPPUNIT_ASSERT(sorted_keys(update_sketch) == sorted_keys(sketch.compact()));
+  }
+
+  void memory_request() {
+    // start with room for the starting table of lg_k=14 (lg 6) only, then grow like realloc()
+    std::vector<std::vector<uint64_t>> blocks;
+    blocks.emplace_back(direct_update_theta_sketch::get_max_serialized_size_bytes(5) / sizeof(uint64_t));
+    int requests = 0;
+    auto request = [&blocks, &requests](void* mem, size_t size, size_t new_size) -> void* {
+      requests++;
+      std::vector<uint64_t> block(new_size / sizeof(uint64_t));
+      std::memcpy(block.data(), mem, size);
+      blocks.push_back(std::move(block));
+      return blocks.back().data();
+    };
+    update_theta_sketch::builder builder;
+    builder.set_lg_k(14);
+    direct_update_theta_sketch sketch = direct_update_theta_sketch::initialize(blocks[0].data(), blocks[0].size() * sizeof(uint64_t), builder, request);
+    update_theta_sketch update_sketch = builder.build();
+    for (int i = 0; i < 100000; i++) {
+      sketch.update(i);
+      update_sketch.update(i);
+    }
+    CPPUNIT_ASSERT(requests > 0);
+    CPPUNIT_ASSERT(sketch.get_memory() == blocks.back().data());
+    CPPUNIT_ASSERT_EQUAL(direct_update_theta_sketch::get_max_serialized_size_bytes(14), sketch.get_serialized_size_bytes());
+    CPPUNIT_ASSERT_EQUAL(update_sketch.get_theta64(), sketch.get_theta64());
+    CPPUNIT_ASSERT(sorted_keys(update_sketch) == sorted_keys(sketch.compact()));
+  }
+
+  void memory_full() {
+    // room for the starting table of lg_k=14 only
+    std::vector<uint64_t> mem = memory_for(5);
+    update_theta_sketch::builder builder;
+    builder.set_lg_k(14);
+    direct_update_theta_sketch sketch = direct_update_theta_sketch::initialize(mem.data(), mem.size() * sizeof(uint64_t), builder);
+    CPPUNIT_ASSERT_THROW(for (int i = 0; i < 1000; i++) sketch.update(i), std::runtime_error);
+  }
+
+  void memory_request_failed() {
+    // room for the starting table of lg_k=14 only, and no more to be had
+    std::vector<uint64_t> mem = memory_for(5);
+    const size_t size = mem.size() * sizeof(uint64_t);
+    auto request = [](void*, size_t, size_t) -> void* { return nullptr; };
+    update_theta_sketch::builder builder;
+    builder.set_lg_k(14);
+    int updates = 0;
+    {
+      direct_update_theta_sketch sketch = direct_update_theta_sketch::initialize(mem.data(), size, builder, request);
+      CPPUNIT_ASSERT_THROW(for (; updates < 1000; updates++) sketch.update(updates), std::runtime_error);
+    }
+    // the update that threw is counted along with its key
+    direct_update_theta_sketch sketch = direct_update_theta_sketch::wrap(mem.data(), size);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32_t>(updates + 1), sketch.get_num_retained());
+    update_theta_sketch update_sketch = builder.build();
+    for (int i = 0; i <= updates; i++) update_sketch.update(i);
+    CPPUNIT_ASSERT(sorted_keys(update_sketch) == sorted_keys(sketch.compact()));
+    update_theta_sketch deserialized = update_theta_sketch::deserialize(mem.data(), size);
+    CPPUNIT_ASSERT_EQUAL(sketch.get_num_retained(), deserialized.get_num_retained());
+    CPPUNIT_ASSERT(sorted_keys(update_sketch) == sorted_keys(deserialized));
+  }
+
+  void invalid_memory() {
+    std::vector<uint64_t> mem = memory_for(12);
+    const size_t size = mem.size() * sizeof(uint64_t);
+    // misaligned
+    CPPUNIT_ASSERT_THROW(direct_update_theta_sketch::initialize(reinterpret_cast<char*>(mem.data()) + 1, size - 8), std::invalid_argument);
+    // too small for the starting table
+    CPPUNIT_ASSERT_THROW(direct_update_theta_sketch::initialize(mem.data(), 64), std::invalid_argument);
+    direct_update_theta_sketch::initialize(mem.data(), size);
+    CPPUNIT_ASSERT_THROW(direct_update_theta_sketch::wrap(mem.data(), size, 123), std::invalid_argument);
+    CPPUNIT_ASSERT_THROW(direct_update_theta_sketch::wrap(mem.data(), 64), std::invalid_argument);
+    // lg_nom_size and lg_cur_size out of range, before sizes are computed from them
+    char* preamble = reinterpret_cast<char*>(mem.data());
+    preamble[3] = direct_update_theta_sketch::MAX_LG_K + 1;
+    CPPUNIT_ASSERT_THROW(direct_update_theta_sketch::wrap(mem.data(), size), std::invalid_argument);
+    preamble[3] = 100;
+    preamble[4] = 64;
+    CPPUNIT_ASSERT_THROW(direct_update_theta_sketch::wrap(mem.data(), size), std::invalid_argument);
+    update_theta_sketch::builder builder;
+    builder.set_lg_k(direct_update_theta_sketch::MAX_LG_K + 1);
+    CPPUNIT_ASSERT_THROW(direct_update_theta_sketch::initialize(mem.data(), size, builder), std::invalid_argument);
+
+    // a compact sketch is not an update sketch
+    update_theta_sketch update_sketch = update_theta_sketch::builder().build();
+    update_sketch.update(1);
+    auto bytes = update_sketch.compact().serialize();
+    std::memcpy(mem.data(), bytes.first.get(), bytes.second);
+    CPPUNIT_ASSERT_THROW(direct_update_theta_sketch::wrap(mem.data(), size), std::invalid_argument);
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(theta_direct_sketch_test);
+
+} /* namespace datasketches */
@@ -22,6 +22,12 @@
 
 #include <theta_intersection.hpp>
 
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 namespace datasketches {
 
 class theta_intersection_test: public CppUnit::TestFixture {
@@ -39,6 +45,19 @@ class theta_intersection_test: public CppUnit::TestFixture {
   CPPUNIT_TEST(estimation_mode_disjoint_unordered);
   CPPUNIT_TEST(estimation_mode_disjoint_ordered);
   CPPUNIT_TEST(seed_mismatch);
+  CPPUNIT_TEST(same_table_size_after_intersection);
+  CPPUNIT_TEST(serialized_estimation_mode_half_overlap);
+  CPPUNIT_TEST(serialized_after_no_retained_keys);
+  CPPUNIT_TEST(serialized_seed_mismatch);
+  CPPUNIT_TEST(cached_result);
+  CPPUNIT_TEST(concurrent_get_result);
+  CPPUNIT_TEST(compact_views);
+  CPPUNIT_TEST(ordered_same_as_unordered);
+  CPPUNIT_TEST(intersect_range);
+  CPPUNIT_TEST(intersect_range_empty_input);
+  CPPUNIT_TEST(intersect_range_seed_mismatch);
+  CPPUNIT_TEST(serialized_compressed);
+  CPPUNIT_TEST(streamed);
   CPPUNIT_TEST_SUITE_END();
 
   void invalid() {
@@ -233,6 +252,384 @@ class theta_intersection_test: public CppUnit::TestFixture {
     CPPUNIT_ASSERT_THROW(intersection.update(sketch), std::invalid_argument);
   }
 
+  void same_table_size_after_intersection() {
+    // 1000 and 970 keys need the same table size, non-matching keys must not survive
+    update_theta_sketch sketch1 = update_theta_sketch::builder().build();
+    for (int i = 0; i < 1000; i++) sketch1.update(i);
+    update_theta_sketch sketch2 = update_theta_sketch::builder().build();
+    for (int i = 0; i < 970; i++) sketch2.update(i);
+
+    theta_intersection intersection;
+    intersection.update(sketch1);
+    intersection.update(sketch2);
+    intersection.update(sketch1);
+    compact_theta_sketch result = intersection.get_result();
+    CPPUNIT_ASSERT(!result.is_empty());
+    CPPUNIT_ASSERT(!result.is_estimation_mode());
+    CPPUNIT_ASSERT_EQUAL(970.0, result.get_estimate());
+  }
+
+  void serialized_estimation_mode_half_overlap() {
+    update_theta_sketch sketch1 = update_theta_sketch::builder().build();
+    int value = 0;
+    for (int i = 0; i < 10000; i++) sketch1.update(value++);
+
+    update_theta_sketch sketch2 = update_theta_sketch::builder().build();
+    value = 5000;
+    for (int i = 0; i < 10000; i++) sketch2.update(value++);
+
+    theta_intersection intersection;
+    intersection.update(sketch1);
+    intersection.update(sketch2);
+    compact_theta_sketch expected = intersection.get_result();
+
+    // serialized update sketch first, serialized compact sketch next
+    theta_intersection serialized;
+    auto bytes1 = sketch1.serialize();
+    serialized.update(bytes1.first.get(), bytes1.second);
+    auto bytes2 = sketch2.compact().serialize();
+    serialized.update(bytes2.first.get(), bytes2.second);
+    compact_theta_sketch result = serialized.get_result();
+    CPPUNIT_ASSERT_EQUAL(expected.get_num_retained(), result.get_num_retained());
+    CPPUNIT_ASSERT_EQUAL(expected.get_theta64(), result.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(expected.get_estimate(), result.get_estimate());
+  }
+
+  void serialized_compressed() {
+    std::vector<compact_theta_sketch> sketches;
+    for (int i = 0; i < 4; i++) {
+      update_theta_sketch sketch = update_theta_sketch::builder().set_lg_k(10 + i).build();
+      for (int j = 0; j < 20000; j++) sketch.update(i * 2000 + j);
+      sketches.push_back(sketch.compact(i != 0));
+    }
+    std::vector<std::pair<void_ptr_with_deleter, const size_t>> bytes;
+    for (const auto& sketch: sketches) bytes.push_back(sketch.serialize_compressed());
+
+    // the first input as a hash table, then as a sorted array
+    for (bool first_unordered: {true, false}) {
+      theta_intersection intersection;
+      theta_intersection serialized;
+      for (size_t i = first_unordered ? 0 : 1; i < sketches.size(); i++) {
+        intersection.update(sketches[i]);
+        serialized.update(bytes[i].first.get(), bytes[i].second);
+      }
+      const compact_theta_sketch& expected = intersection.get_result();
+      const compact_theta_sketch& result = serialized.get_result();
+      CPPUNIT_ASSERT(expected.get_num_retained() > 0);
+      CPPUNIT_ASSERT_EQUAL(expected.get_theta64(), result.get_theta64());
+      CPPUNIT_ASSERT_EQUAL(expected.get_num_retained(), result.get_num_retained());
+      CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), result.begin()));
+    }
+
+    // no overlap left, then only the preamble is read
+    theta_intersection intersection;
+    update_theta_sketch disjoint = update_theta_sketch::builder().build();
+    for (int j = 0; j < 1000; j++) disjoint.update(-1 - j);
+    intersection.update(disjoint.compact());
+    intersection.update(bytes[3].first.get(), bytes[3].second);
+    CPPUNIT_ASSERT_EQUAL(0U, intersection.get_result().get_num_retained());
+    intersection.update(bytes[1].first.get(), bytes[1].second);
+    CPPUNIT_ASSERT_EQUAL(sketches[1].get_theta64(), intersection.get_result().get_theta64());
+  }
+
+  void streamed() {
+    std::vector<update_theta_sketch> update_sketches;
+    for (int i = 0; i < 4; i++) {
+      update_sketches.push_back(update_theta_sketch::builder().set_lg_k(10 + i).build());
+      for (int j = 0; j < 20000; j++) update_sketches.back().update(i * 2000 + j);
+    }
+
+    // the first input as a hash table, then as a sorted array, with inputs of all kinds after it
+    for (bool first_unordered: {true, false}) {
+      std::stringstream s(std::ios::in | std::ios::out | std::ios::binary);
+      if (first_unordered) update_sketches[0].serialize(s);
+      else update_sketches[0].compact(true).serialize_compressed(s);
+      update_sketches[1].compact(true).serialize(s);
+      update_sketches[2].compact(false).serialize(s);
+      update_sketches[3].compact(true).serialize_compressed(s);
+      s.put(42);
+      theta_intersection intersection;
+      theta_intersection streamed;
+      for (const auto& sketch: update_sketches) {
+        intersection.update(sketch);
+        streamed.update(s);
+      }
+      CPPUNIT_ASSERT_EQUAL(42, s.get());
+      const compact_theta_sketch& expected = intersection.get_result();
+      const compact_theta_sketch& result = streamed.get_result();
+      CPPUNIT_ASSERT(expected.get_num_retained() > 0);
+      CPPUNIT_ASSERT_EQUAL(expected.get_theta64(), result.get_theta64());
+      CPPUNIT_ASSERT_EQUAL(expected.get_num_retained(), result.get_num_retained());
+      CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), result.begin()));
+    }
+
+    // no overlap left, then the keys are skipped
+    std::stringstream s(std::ios::in | std::ios::out | std::ios::binary);
+    update_theta_sketch disjoint = update_theta_sketch::builder().build();
+    for (int j = 0; j < 1000; j++) disjoint.update(-1 - j);
+    disjoint.compact().serialize(s);
+    update_sketches[3].compact().serialize_compressed(s);
+    update_sketches[1].serialize(s);
+    s.put(42);
+    theta_intersection intersection;
+    for (int i = 0; i < 3; i++) intersection.update(s);
+    CPPUNIT_ASSERT_EQUAL(42, s.get());
+    CPPUNIT_ASSERT_EQUAL(0U, intersection.get_result().get_num_retained());
+    CPPUNIT_ASSERT_EQUAL(update_sketches[1].get_theta64(), intersection.get_result().get_theta64());
+
+    update_theta_sketch other_seed = update_theta_sketch::builder().set_seed(123).build();
+    other_seed.update(1);
+    other_seed.serialize(s);
+    CPPUNIT_ASSERT_THROW(intersection.update(s), std::invalid_argument);
+  }
+
+  void serialized_after_no_retained_keys() {
+    update_theta_sketch sketch1 = update_theta_sketch::builder().build();
+    int value = 0;
+    for (int i = 0; i < 10000; i++) sketch1.update(value++);
+    update_theta_sketch sketch2 = update_theta_sketch::builder().build();
+    for (int i = 0; i < 10000; i++) sketch2.update(value++);
+    // smaller k, so a smaller theta that must still be picked up from the preamble
+    update_theta_sketch sketch3 = update_theta_sketch::builder().set_lg_k(5).build();
+    for (int i = 0; i < 10000; i++) sketch3.update(value++);
+
+    theta_intersection intersection;
+    intersection.update(sketch1);
+    intersection.update(sketch2);
+    intersection.update(sketch3);
+    compact_theta_sketch expected = intersection.get_result();
+
+    theta_intersection serialized;
+    auto bytes1 = sketch1.compact().serialize();
+    serialized.update(bytes1.first.get(), bytes1.second);
+    auto bytes2 = sketch2.compact().serialize();
+    serialized.update(bytes2.first.get(), bytes2.second);
+    auto bytes3 = sketch3.compact().serialize();
+    serialized.update(bytes3.first.get(), bytes3.second);
+    compact_theta_sketch result = serialized.get_result();
+    CPPUNIT_ASSERT(!result.is_empty());
+    CPPUNIT_ASSERT_EQUAL(0U, result.get_num_retained());
+    CPPUNIT_ASSERT_EQUAL(expected.get_theta64(), result.get_theta64());
+    CPPUNIT_ASSERT(result.get_theta64() < sketch2.get_theta64());
+
+    // only the preamble of the update sketch is read now
+    auto bytes4 = sketch3.serialize();
+    serialized.update(bytes4.first.get(), bytes4.second);
+    CPPUNIT_ASSERT_EQUAL(expected.get_theta64(), serialized.get_result().get_theta64());
+
+    // an empty sketch makes the result empty
+    update_theta_sketch sketch5 = update_theta_sketch::builder().build();
+    auto bytes5 = sketch5.compact().serialize();
+    serialized.update(bytes5.first.get(), bytes5.second);
+    CPPUNIT_ASSERT(serialized.get_result().is_empty());
+  }
+
+  void serialized_seed_mismatch() {
+    update_theta_sketch sketch = update_theta_sketch::builder().build();
+    sketch.update(1);
+    auto bytes = sketch.compact().serialize();
+    theta_intersection intersection(123);
+    CPPUNIT_ASSERT_THROW(intersection.update(bytes.first.get(), bytes.second), std::invalid_argument);
+  }
+
+  void cached_result() {
+    update_theta_sketch sketch1 = update_theta_sketch::builder().build();
+    for (int i = 0; i < 10000; i++) sketch1.update(i);
+    update_theta_sketch sketch2 = update_theta_sketch::builder().build();
+    for (int i = 5000; i < 15000; i++) sketch2.update(i);
+    update_theta_sketch sketch3 = update_theta_sketch::builder().build();
+    for (int i = 7500; i < 17500; i++) sketch3.update(i);
+
+    theta_intersection intersection;
+    intersection.update(sketch1);
+    intersection.update(sketch2);
+    const compact_theta_sketch& result1 = intersection.get_result();
+    CPPUNIT_ASSERT(result1.is_ordered());
+    const uint32_t num_retained = result1.get_num_retained();
+    const double estimate = result1.get_estimate();
+    // same object, nothing rebuilt
+    CPPUNIT_ASSERT_EQUAL(&result1, &intersection.get_result());
+    CPPUNIT_ASSERT_EQUAL(num_retained, intersection.get_result().get_num_retained());
+
+    // the other ordering is a result of its own, the one held above stays as it was
+    const std::vector<uint64_t> ordered_keys(result1.begin(), result1.end());
+    const compact_theta_sketch& unordered = intersection.get_result(false);
+    CPPUNIT_ASSERT(&unordered != &result1);
+    CPPUNIT_ASSERT(!unordered.is_ordered());
+    CPPUNIT_ASSERT_EQUAL(num_retained, unordered.get_num_retained());
+    CPPUNIT_ASSERT(result1.is_ordered());
+    CPPUNIT_ASSERT(std::equal(ordered_keys.begin(), ordered_keys.end(), result1.begin()));
+    CPPUNIT_ASSERT_EQUAL(&result1, &intersection.get_result());
+    CPPUNIT_ASSERT_EQUAL(&unordered, &intersection.get_result(false));
+    CPPUNIT_ASSERT_EQUAL(estimate, intersection.get_result().get_estimate());
+    std::vector<uint64_t> unordered_keys(unordered.begin(), unordered.end());
+    std::sort(unordered_keys.begin(), unordered_keys.end());
+    CPPUNIT_ASSERT(ordered_keys == unordered_keys);
+
+    // copies keep an independent result
+    theta_intersection copy(intersection);
+    CPPUNIT_ASSERT_EQUAL(estimate, copy.get_result().get_estimate());
+
+    // update invalidates it
+    intersection.update(sketch3);
+    const compact_theta_sketch& result2 = intersection.get_result();
+    CPPUNIT_ASSERT(result2.get_num_retained() < num_retained);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(2500, result2.get_estimate(), 2500 * 0.05);
+    CPPUNIT_ASSERT_EQUAL(estimate, copy.get_result().get_estimate());
+
+    // keys are sorted and unique
+    uint64_t previous = 0;
+    for (auto key: result2) {
+      CPPUNIT_ASSERT(key > previous);
+      previous = key;
+    }
+  }
+
+  void concurrent_get_result() {
+    update_theta_sketch sketch1 = update_theta_sketch::builder().build();
+    for (int i = 0; i < 10000; i++) sketch1.update(i);
+    update_theta_sketch sketch2 = update_theta_sketch::builder().build();
+    for (int i = 5000; i < 15000; i++) sketch2.update(i);
+    theta_intersection intersection;
+    intersection.update(sketch1);
+    intersection.update(sketch2);
+    const theta_intersection& readers = intersection;
+
+    // readers of both orderings race to build the results
+    std::vector<const compact_theta_sketch*> results(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < results.size(); i++) {
+      threads.emplace_back([&readers, &results, i]() { results[i] = &readers.get_result(i % 2 == 0); });
+    }
+    for (auto& thread: threads) thread.join();
+    for (size_t i = 0; i < results.size(); i++) {
+      CPPUNIT_ASSERT_EQUAL(results[i % 2], results[i]);
+      CPPUNIT_ASSERT_EQUAL(i % 2 == 0, results[i]->is_ordered());
+      CPPUNIT_ASSERT_EQUAL(results[0]->get_num_retained(), results[i]->get_num_retained());
+    }
+  }
+
+  void compact_views() {
+    // three inputs with different thetas, the first one unordered so that the state starts
+    // as a hash table, then turns sorted and is merged with the ordered views
+    std::vector<compact_theta_sketch> sketches;
+    for (int i = 0; i < 3; i++) {
+      update_theta_sketch sketch = update_theta_sketch::builder().set_lg_k(10 + i).build();
+      for (int j = 0; j < 20000; j++) sketch.update(i * 2000 + j);
+      sketches.push_back(sketch.compact(i != 0));
+    }
+    theta_intersection intersection1;
+    theta_intersection intersection2;
+    std::vector<std::pair<void_ptr_with_deleter, const size_t>> bytes;
+    for (const auto& sketch: sketches) {
+      bytes.push_back(sketch.serialize());
+      intersection1.update(sketch);
+      intersection2.update(compact_theta_sketch_view(bytes.back().first.get(), bytes.back().second));
+    }
+    const compact_theta_sketch& result1 = intersection1.get_result();
+    const compact_theta_sketch& result2 = intersection2.get_result();
+    CPPUNIT_ASSERT(result1.get_num_retained() > 0);
+    CPPUNIT_ASSERT_EQUAL(sketches[0].get_theta64(), result2.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(result1.get_theta64(), result2.get_theta64());
+    CPPUNIT_ASSERT(std::vector<uint64_t>(result1.begin(), result1.end()) == std::vector<uint64_t>(result2.begin(), result2.end()));
+
+    // a disjoint view leaves no keys, but a non-empty result
+    update_theta_sketch disjoint = update_theta_sketch::builder().build();
+    for (int j = 0; j < 1000; j++) disjoint.update(-1 - j);
+    auto disjoint_bytes = disjoint.compact().serialize();
+    intersection2.update(compact_theta_sketch_view(disjoint_bytes.first.get(), disjoint_bytes.second));
+    CPPUNIT_ASSERT_EQUAL(0U, intersection2.get_result().get_num_retained());
+    CPPUNIT_ASSERT(!intersection2.get_result().is_empty());
+  }
+
+
+  void ordered_same_as_unordered() {
+    // balanced and very unbalanced sizes, merged, galloped and mixed with hash probes
+    const int sizes[] = {200000, 150000, 3000, 200000, 100, 50};
+    std::vector<update_theta_sketch> sketches;
+    for (int size: sizes) {
+      sketches.push_back(update_theta_sketch::builder().set_lg_k(16).build());
+      for (int i = 0; i < size; i++) sketches.back().update(i * 3 % 200000);
+    }
+    for (int unordered = -1; unordered < 6; unordered++) {
+      theta_intersection hashed;
+      theta_intersection merged;
+      for (int i = 0; i < 6; i++) {
+        hashed.update(sketches[i]);
+        merged.update(sketches[i].compact(i != unordered));
+        const compact_theta_sketch& result1 = hashed.get_result();
+        const compact_theta_sketch& result2 = merged.get_result();
+        CPPUNIT_ASSERT_EQUAL(result1.get_theta64(), result2.get_theta64());
+        CPPUNIT_ASSERT_EQUAL(result1.get_num_retained(), result2.get_num_retained());
+        CPPUNIT_ASSERT(std::equal(result1.begin(), result1.end(), result2.begin()));
+      }
+      CPPUNIT_ASSERT(merged.get_result().get_num_retained() > 0);
+    }
+  }
+
+  void intersect_range() {
+    // different thetas and sizes, given largest first, some unordered
+    std::vector<compact_theta_sketch> sketches;
+    for (int i = 0; i < 8; i++) {
+      update_theta_sketch sketch = update_theta_sketch::builder().set_lg_k(10 + i % 4).build();
+      for (int j = 0; j < 100000 - i * 10000; j++) sketch.update(j * (i % 3 + 1));
+      sketches.push_back(sketch.compact(i % 3 != 1));
+    }
+    theta_intersection sequential;
+    for (const auto& sketch: sketches) sequential.update(sketch);
+    theta_intersection planned;
+    planned.intersect(sketches.begin(), sketches.end());
+    const compact_theta_sketch& result1 = sequential.get_result();
+    const compact_theta_sketch& result2 = planned.get_result();
+    CPPUNIT_ASSERT(result1.get_num_retained() > 0);
+    CPPUNIT_ASSERT_EQUAL(result1.get_theta64(), result2.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(result1.get_num_retained(), result2.get_num_retained());
+    CPPUNIT_ASSERT(std::equal(result1.begin(), result1.end(), result2.begin()));
+
+    // views, and more after the range
+    std::vector<std::pair<void_ptr_with_deleter, const size_t>> bytes;
+    for (const auto& sketch: sketches) bytes.push_back(sketch.serialize());
+    std::vector<compact_theta_sketch_view> views;
+    for (const auto& b: bytes) views.push_back(compact_theta_sketch_view(b.first.get(), b.second));
+    theta_intersection viewed;
+    viewed.intersect(views.begin(), views.begin() + 4);
+    viewed.intersect(views.begin() + 4, views.end());
+    CPPUNIT_ASSERT_EQUAL(result1.get_theta64(), viewed.get_result().get_theta64());
+    CPPUNIT_ASSERT(std::equal(result1.begin(), result1.end(), viewed.get_result().begin()));
+  }
+
+  void intersect_range_empty_input() {
+    std::vector<compact_theta_sketch> sketches;
+    update_theta_sketch sketch = update_theta_sketch::builder().build();
+    for (int i = 0; i < 1000; i++) sketch.update(i);
+    sketches.push_back(sketch.compact());
+    sketches.push_back(update_theta_sketch::builder().build().compact());
+    theta_intersection intersection;
+    intersection.intersect(sketches.begin(), sketches.end());
+    CPPUNIT_ASSERT(intersection.has_result());
+    CPPUNIT_ASSERT(intersection.get_result().is_empty());
+    CPPUNIT_ASSERT_EQUAL(0U, intersection.get_result().get_num_retained());
+
+    // nothing to intersect, no result yet
+    theta_intersection none;
+    none.intersect(sketches.end(), sketches.end());
+    CPPUNIT_ASSERT(!none.has_result());
+  }
+
+  void intersect_range_seed_mismatch() {
+    std::vector<compact_theta_sketch> sketches;
+    update_theta_sketch sketch1 = update_theta_sketch::builder().build();
+    sketch1.update(1);
+    sketches.push_back(sketch1.compact());
+    update_theta_sketch sketch2 = update_theta_sketch::builder().set_seed(123).build();
+    sketch2.update(1);
+    sketches.push_back(sketch2.compact());
+    theta_intersection intersection;
+    CPPUNIT_ASSERT_THROW(intersection.intersect(sketches.begin(), sketches.end()), std::invalid_argument);
+    // checked before anything changes
+    CPPUNIT_ASSERT(!intersection.has_result());
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(theta_intersection_test);
@@ -0,0 +1,80 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <theta_packed_keys.hpp>
+
+#include <random>
+#include <vector>
+
+namespace datasketches {
+
+class theta_packed_keys_test: public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE(theta_packed_keys_test);
+  CPPUNIT_TEST(round_trip);
+  CPPUNIT_TEST(corrupted_width);
+  CPPUNIT_TEST_SUITE_END();
+
+  void round_trip() {
+    std::mt19937_64 random(1);
+    // around the block size, gaps of 1 bit up to the widest a key below theta has
+    for (uint32_t num_keys: {1, 2, 63, 64, 65, 128, 129, 1000}) {
+      for (uint8_t max_gap_bits: {1, 7, 20, 62}) {
+        std::vector<uint64_t> keys;
+        uint64_t key = 0;
+        for (uint32_t i = 0; i < num_keys and key < (1ULL << 62); i++) {
+          key += 1 + (random() >> (64 - max_gap_bits));
+          keys.push_back(key);
+        }
+        std::vector<char> packed(packed_keys_size_bytes(keys.data(), keys.size()));
+        packed_keys_write(keys.data(), keys.size(), packed.data());
+        CPPUNIT_ASSERT_EQUAL(packed.size(), packed_keys_widths_bytes(keys.size()) + packed_keys_words_bytes(packed.data(), keys.size()));
+        std::vector<uint64_t> decoded(keys.size());
+        packed_keys_reader reader(packed.data(), keys.size());
+        for (uint32_t count = 0; count < keys.size();) {
+          const uint32_t n = reader.next(&decoded[count]);
+          CPPUNIT_ASSERT(n > 0 and n <= PACKED_KEYS_BLOCK_SIZE);
+          count += n;
+        }
+        uint64_t block[PACKED_KEYS_BLOCK_SIZE];
+        CPPUNIT_ASSERT_EQUAL(0U, reader.next(block));
+        CPPUNIT_ASSERT(keys == decoded);
+      }
+    }
+  }
+
+  void corrupted_width() {
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 1; i <= 100; i++) keys.push_back(i * 1000);
+    std::vector<char> packed(packed_keys_size_bytes(keys.data(), keys.size()));
+    packed_keys_write(keys.data(), keys.size(), packed.data());
+    packed[1] = 0;
+    CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(0), packed_keys_words_bytes(packed.data(), keys.size()));
+    packed[1] = 64;
+    CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(0), packed_keys_words_bytes(packed.data(), keys.size()));
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(theta_packed_keys_test);
+
+} /* namespace datasketches */
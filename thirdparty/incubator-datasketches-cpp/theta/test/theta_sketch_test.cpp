@@ -21,6 +21,13 @@
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <theta_sketch.hpp>
+#include <test_allocator.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
 
 namespace datasketches {
 
@@ -47,6 +54,15 @@ class theta_sketch_test: public CppUnit::TestFixture {
   CPPUNIT_TEST(deserialize_compact_estimation_from_java_as_base);
   CPPUNIT_TEST(deserialize_compact_estimation_from_java_as_subclass);
   CPPUNIT_TEST(serialize_deserialize_stream_and_bytes_equivalency);
+  CPPUNIT_TEST(batch_update_same_as_single);
+  CPPUNIT_TEST(prehashed_update);
+  CPPUNIT_TEST(batch_update_large_table);
+  CPPUNIT_TEST(rebuild_does_not_allocate);
+  CPPUNIT_TEST(compact_view);
+  CPPUNIT_TEST(compact_view_from_java);
+  CPPUNIT_TEST(compact_view_invalid);
+  CPPUNIT_TEST(compressed_serialization);
+  CPPUNIT_TEST(compressed_invalid);
   CPPUNIT_TEST_SUITE_END();
 
   void empty() {
@@ -437,6 +453,266 @@ class theta_sketch_test: public CppUnit::TestFixture {
     }
   }
 
+  static void assert_same_keys(const update_theta_sketch& sketch1, const update_theta_sketch& sketch2) {
+    CPPUNIT_ASSERT_EQUAL(sketch1.is_empty(), sketch2.is_empty());
+    CPPUNIT_ASSERT_EQUAL(sketch1.get_theta64(), sketch2.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(sketch1.get_num_retained(), sketch2.get_num_retained());
+    // same keys inserted in the same order end up in the same slots
+    auto iter = sketch1.begin();
+    for (auto key: sketch2) {
+      CPPUNIT_ASSERT_EQUAL(*iter, key);
+      ++iter;
+    }
+  }
+
+  void batch_update_same_as_single() {
+    // not a multiple of the batch size, estimation mode
+    const size_t n = 10007;
+    std::vector<uint64_t> values(n);
+    for (size_t i = 0; i < n; i++) values[i] = i * 0x9e3779b97f4a7c15ULL;
+    update_theta_sketch sketch1 = update_theta_sketch::builder().set_lg_k(10).build();
+    update_theta_sketch sketch2 = update_theta_sketch::builder().set_lg_k(10).build();
+    for (uint64_t value: values) sketch1.update(value);
+    sketch2.update_batch(values.data(), n);
+    assert_same_keys(sketch1, sketch2);
+
+    std::vector<int64_t> longs(n);
+    for (size_t i = 0; i < n; i++) longs[i] = -static_cast<int64_t>(i);
+    update_theta_sketch sketch3 = update_theta_sketch::builder().build();
+    update_theta_sketch sketch4 = update_theta_sketch::builder().build();
+    for (int64_t value: longs) sketch3.update(value);
+    sketch4.update_batch(longs.data(), n);
+    assert_same_keys(sketch3, sketch4);
+
+    // including the values that are canonicalized
+    std::vector<double> doubles = {0.0, -0.0, std::nan(""), -std::nan(""), 1.5, -2.25, 1e300};
+    for (size_t i = 0; i < n; i++) doubles.push_back(i / 3.0);
+    update_theta_sketch sketch5 = update_theta_sketch::builder().build();
+    update_theta_sketch sketch6 = update_theta_sketch::builder().build();
+    for (double value: doubles) sketch5.update(value);
+    sketch6.update_batch(doubles.data(), doubles.size());
+    assert_same_keys(sketch5, sketch6);
+
+    std::vector<std::string> strings = {"", "a", "abcdefghijklmnopq"};
+    for (size_t i = 0; i < 1000; i++) strings.push_back(std::to_string(i));
+    update_theta_sketch sketch7 = update_theta_sketch::builder().build();
+    update_theta_sketch sketch8 = update_theta_sketch::builder().build();
+    for (const std::string& value: strings) sketch7.update(value);
+    sketch8.update_batch(strings.data(), strings.size());
+    assert_same_keys(sketch7, sketch8);
+
+    // the seed goes into both paths
+    update_theta_sketch sketch9 = update_theta_sketch::builder().set_seed(123).build();
+    update_theta_sketch sketch10 = update_theta_sketch::builder().set_seed(123).build();
+    sketch9.update(values[0]);
+    sketch10.update_batch(values.data(), 1);
+    assert_same_keys(sketch9, sketch10);
+  }
+
+  void batch_update_large_table() {
+    // the table outgrows the prefetch threshold, resizes and then rebuilds in between batches
+    const size_t n = 300000;
+    std::vector<uint64_t> values(n);
+    for (size_t i = 0; i < n; i++) values[i] = i;
+    update_theta_sketch sketch1 = update_theta_sketch::builder().set_lg_k(16).build();
+    update_theta_sketch sketch2 = update_theta_sketch::builder().set_lg_k(16).build();
+    for (uint64_t value: values) sketch1.update(value);
+    sketch2.update_batch(values.data(), n);
+    CPPUNIT_ASSERT(sketch2.is_estimation_mode());
+    assert_same_keys(sketch1, sketch2);
+  }
+
+  void rebuild_does_not_allocate() {
+    typedef update_theta_sketch_alloc<test_allocator<uint64_t>> update_theta_sketch_test_alloc;
+    test_allocator_total_bytes = 0;
+    {
+      update_theta_sketch_test_alloc sketch = update_theta_sketch_test_alloc::builder().set_lg_k(10).build();
+      int i = 0;
+      while (!sketch.is_estimation_mode()) sketch.update(i++);
+      const uint64_t theta = sketch.get_theta64();
+      const long long allocations = test_allocator_allocations;
+      for (int j = 0; j < 100000; j++) sketch.update(i++);
+      CPPUNIT_ASSERT(sketch.get_theta64() < theta);
+      CPPUNIT_ASSERT_EQUAL(allocations, test_allocator_allocations);
+
+      // same retained keys as the default allocator
+      update_theta_sketch reference = update_theta_sketch::builder().set_lg_k(10).build();
+      for (int j = 0; j < i; j++) reference.update(j);
+      CPPUNIT_ASSERT_EQUAL(reference.get_theta64(), sketch.get_theta64());
+      CPPUNIT_ASSERT_EQUAL(reference.get_num_retained(), sketch.get_num_retained());
+      std::vector<uint64_t> keys1(sketch.begin(), sketch.end());
+      std::vector<uint64_t> keys2(reference.begin(), reference.end());
+      std::sort(keys1.begin(), keys1.end());
+      std::sort(keys2.begin(), keys2.end());
+      CPPUNIT_ASSERT(keys1 == keys2);
+    }
+    CPPUNIT_ASSERT_EQUAL(0LL, test_allocator_total_bytes);
+  }
+
+  static void assert_view_same_as_compact(const compact_theta_sketch& compact) {
+    auto bytes = compact.serialize();
+    compact_theta_sketch_view view(bytes.first.get(), bytes.second);
+    CPPUNIT_ASSERT_EQUAL(compact.is_empty(), view.is_empty());
+    CPPUNIT_ASSERT_EQUAL(compact.is_ordered(), view.is_ordered());
+    CPPUNIT_ASSERT_EQUAL(compact.get_theta64(), view.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(compact.get_num_retained(), view.get_num_retained());
+    CPPUNIT_ASSERT_EQUAL(compact.get_seed_hash(), view.get_seed_hash());
+    CPPUNIT_ASSERT_EQUAL(compact.get_estimate(), view.get_estimate());
+    CPPUNIT_ASSERT_EQUAL(bytes.second, view.get_serialized_size_bytes());
+    auto it = compact.begin();
+    for (auto key: view) {
+      CPPUNIT_ASSERT_EQUAL(*it, key);
+      ++it;
+    }
+    CPPUNIT_ASSERT(it == compact.end());
+    auto bytes2 = view.serialize();
+    CPPUNIT_ASSERT_EQUAL(bytes.second, bytes2.second);
+    CPPUNIT_ASSERT(std::memcmp(bytes.first.get(), bytes2.first.get(), bytes.second) == 0);
+  }
+
+  void compact_view() {
+    update_theta_sketch update_sketch = update_theta_sketch::builder().build();
+    assert_view_same_as_compact(update_sketch.compact());
+    update_sketch.update(1);
+    assert_view_same_as_compact(update_sketch.compact());
+    for (int i = 0; i < 1000; i++) update_sketch.update(i);
+    assert_view_same_as_compact(update_sketch.compact());
+    assert_view_same_as_compact(update_sketch.compact(false));
+    for (int i = 0; i < 10000; i++) update_sketch.update(i);
+    assert_view_same_as_compact(update_sketch.compact());
+    assert_view_same_as_compact(update_sketch.compact(false));
+  }
+
+  void compact_view_from_java() {
+    std::ifstream is;
+    is.exceptions(std::ios::failbit | std::ios::badbit);
+    is.open(inputPath + "theta_compact_estimation_from_java.bin", std::ios::binary | std::ios::ate);
+    const size_t size = is.tellg();
+    is.seekg(0);
+    std::vector<uint64_t> buffer((size + 7) / 8);
+    is.read(reinterpret_cast<char*>(buffer.data()), size);
+    compact_theta_sketch_view view(buffer.data(), size);
+    CPPUNIT_ASSERT(view.is_estimation_mode());
+    CPPUNIT_ASSERT_EQUAL(4342U, view.get_num_retained());
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(8166.25234614053, view.get_estimate(), 1e-10);
+    compact_theta_sketch compact = compact_theta_sketch::deserialize(buffer.data(), size);
+    CPPUNIT_ASSERT(std::equal(view.begin(), view.end(), compact.begin()));
+  }
+
+  void compressed_serialization() {
+    for (int n: {2, 1000, 100000}) {
+      update_theta_sketch update_sketch = update_theta_sketch::builder().build();
+      for (int i = 0; i < n; i++) update_sketch.update(i);
+      const compact_theta_sketch compact_sketch = update_sketch.compact();
+      auto bytes = compact_sketch.serialize_compressed();
+      CPPUNIT_ASSERT_EQUAL(theta_sketch::SERIAL_VERSION_COMPRESSED, static_cast<const uint8_t*>(bytes.first.get())[1]);
+      // the gaps between keys average 2^63 / n, packed with a few bits to spare
+      if (n > 2) CPPUNIT_ASSERT(bytes.second * 8 < compact_sketch.get_num_retained() * (68 - std::log2(n)) + 512);
+
+      std::stringstream s(std::ios::in | std::ios::out | std::ios::binary);
+      compact_sketch.serialize_compressed(s);
+      CPPUNIT_ASSERT_EQUAL(bytes.second, static_cast<size_t>(s.tellp()));
+      const compact_theta_sketch from_stream = compact_theta_sketch::deserialize(s);
+      const compact_theta_sketch from_bytes = compact_theta_sketch::deserialize(bytes.first.get(), bytes.second);
+      auto base = theta_sketch::deserialize(bytes.first.get(), bytes.second);
+      const std::vector<const theta_sketch*> sketches = {&from_stream, &from_bytes, base.get()};
+      for (const theta_sketch* sketch: sketches) {
+        CPPUNIT_ASSERT(sketch->is_ordered());
+        CPPUNIT_ASSERT_EQUAL(compact_sketch.get_theta64(), sketch->get_theta64());
+        CPPUNIT_ASSERT_EQUAL(compact_sketch.get_num_retained(), sketch->get_num_retained());
+        CPPUNIT_ASSERT(std::equal(compact_sketch.begin(), compact_sketch.end(), sketch->begin()));
+      }
+    }
+
+    // written as version 3: empty, single item, unordered
+    update_theta_sketch update_sketch = update_theta_sketch::builder().build();
+    CPPUNIT_ASSERT_EQUAL(update_sketch.compact().serialize().second, update_sketch.compact().serialize_compressed().second);
+    update_sketch.update(1);
+    CPPUNIT_ASSERT_EQUAL(update_sketch.compact().serialize().second, update_sketch.compact().serialize_compressed().second);
+    for (int i = 0; i < 1000; i++) update_sketch.update(i);
+    auto unordered = update_sketch.compact(false).serialize_compressed();
+    CPPUNIT_ASSERT_EQUAL(theta_sketch::SERIAL_VERSION, static_cast<const uint8_t*>(unordered.first.get())[1]);
+    CPPUNIT_ASSERT(!compact_theta_sketch::deserialize(unordered.first.get(), unordered.second).is_ordered());
+  }
+
+  void compressed_invalid() {
+    update_theta_sketch update_sketch = update_theta_sketch::builder().build();
+    for (int i = 0; i < 10000; i++) update_sketch.update(i);
+    auto bytes = update_sketch.compact().serialize_compressed();
+    char* data = static_cast<char*>(bytes.first.get());
+    CPPUNIT_ASSERT_THROW(compact_theta_sketch::deserialize(data, bytes.second - 1), std::invalid_argument);
+    CPPUNIT_ASSERT_THROW(compact_theta_sketch::deserialize(data, bytes.second, 123), std::invalid_argument);
+    // keys are not in place, there is no view of them
+    CPPUNIT_ASSERT_THROW(compact_theta_sketch_view(data, bytes.second), std::invalid_argument);
+    // not written by serialize_compressed(), but readable: no keys, so no packed words
+    uint32_t num_keys;
+    std::memcpy(&num_keys, data + 8, sizeof(num_keys));
+    const uint32_t no_keys = 0;
+    std::memcpy(data + 8, &no_keys, sizeof(no_keys));
+    std::stringstream s(std::ios::in | std::ios::out | std::ios::binary);
+    s.write(data, bytes.second);
+    const compact_theta_sketch from_stream = compact_theta_sketch::deserialize(s);
+    CPPUNIT_ASSERT(!from_stream.is_empty());
+    CPPUNIT_ASSERT_EQUAL(0U, from_stream.get_num_retained());
+    CPPUNIT_ASSERT_EQUAL(0U, compact_theta_sketch::deserialize(data, bytes.second).get_num_retained());
+    // the width of the first block
+    data[24] = 64;
+    std::memcpy(data + 8, &num_keys, sizeof(num_keys));
+    CPPUNIT_ASSERT_THROW(compact_theta_sketch::deserialize(data, bytes.second), std::invalid_argument);
+  }
+
+  void compact_view_invalid() {
+    update_theta_sketch update_sketch = update_theta_sketch::builder().build();
+    for (int i = 0; i < 1000; i++) update_sketch.update(i);
+    auto bytes = update_sketch.compact().serialize(8);
+    const char* data = static_cast<const char*>(bytes.first.get());
+    const size_t size = bytes.second - 8;
+    CPPUNIT_ASSERT_THROW(compact_theta_sketch_view(data + 8, size - 1), std::invalid_argument);
+    CPPUNIT_ASSERT_THROW(compact_theta_sketch_view(data + 8, size, 123), std::invalid_argument);
+    CPPUNIT_ASSERT_THROW(compact_theta_sketch_view(data + 4, size), std::invalid_argument);
+    // an update sketch is not laid out as a compact one
+    auto update_bytes = update_sketch.serialize();
+    CPPUNIT_ASSERT_THROW(compact_theta_sketch_view(update_bytes.first.get(), update_bytes.second), std::invalid_argument);
+  }
+
+  void prehashed_update() {
+    const size_t n = 5000;
+    std::vector<uint64_t> values(n);
+    for (size_t i = 0; i < n; i++) values[i] = i;
+    std::vector<uint64_t> hashes(n);
+    update_theta_sketch::compute_hashes(values.data(), n, hashes.data());
+
+    // one hashing pass feeds several sketches
+    update_theta_sketch sketch1 = update_theta_sketch::builder().set_lg_k(10).build();
+    update_theta_sketch sketch2 = update_theta_sketch::builder().set_lg_k(10).build();
+    update_theta_sketch sketch3 = update_theta_sketch::builder().set_lg_k(10).build();
+    for (uint64_t value: values) sketch1.update(value);
+    sketch2.update_hashes(hashes.data(), n);
+    sketch3.update_hashes(hashes.data(), n);
+    assert_same_keys(sketch1, sketch2);
+    assert_same_keys(sketch1, sketch3);
+
+    CPPUNIT_ASSERT_EQUAL(hashes[7], update_theta_sketch::compute_hash(values[7]));
+    const std::string key("key");
+    update_theta_sketch sketch4 = update_theta_sketch::builder().build();
+    update_theta_sketch sketch5 = update_theta_sketch::builder().build();
+    sketch4.update(key);
+    const uint64_t hash = update_theta_sketch::compute_hash(key.data(), key.length());
+    sketch5.update_hashes(&hash, 1);
+    assert_same_keys(sketch4, sketch5);
+
+    // hashes of another seed are rejected
+    update_theta_sketch sketch6 = update_theta_sketch::builder().set_seed(123).build();
+    CPPUNIT_ASSERT_THROW(sketch6.update_hashes(hashes.data(), n), std::invalid_argument);
+    CPPUNIT_ASSERT(sketch6.is_empty());
+    std::vector<uint64_t> hashes123(n);
+    update_theta_sketch::compute_hashes(values.data(), n, hashes123.data(), 123);
+    sketch6.update_hashes(hashes123.data(), n, 123);
+    update_theta_sketch sketch7 = update_theta_sketch::builder().set_seed(123).build();
+    for (uint64_t value: values) sketch7.update(value);
+    assert_same_keys(sketch6, sketch7);
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(theta_sketch_test);
@@ -0,0 +1,160 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <theta_sorted_set.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace datasketches {
+
+class theta_sorted_set_test: public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE(theta_sorted_set_test);
+  CPPUNIT_TEST(merge_kernels);
+  CPPUNIT_TEST(intersection_gallops);
+  CPPUNIT_TEST(theta_cuts_both_sides);
+  CPPUNIT_TEST(union_loser_tree);
+  CPPUNIT_TEST_SUITE_END();
+
+  typedef uint32_t (*kernel)(const uint64_t*, uint32_t, const uint64_t*, uint32_t, uint64_t*);
+
+  // ascending distinct keys, each of the pool with the given chance
+  static std::vector<uint64_t> random_keys(std::mt19937_64& random, uint32_t pool, double chance) {
+    std::bernoulli_distribution pick(chance);
+    std::vector<uint64_t> keys;
+    for (uint32_t i = 1; i <= pool; i++) if (pick(random)) keys.push_back(i * 1000003ULL);
+    return keys;
+  }
+
+  // in place, as the set operations call them
+  static void check_kernel(kernel merge, bool intersect, const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+    std::vector<uint64_t> expected;
+    if (intersect) {
+      std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+    } else {
+      std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+    }
+    std::vector<uint64_t> out(a);
+    const uint32_t count = merge(out.data(), out.size(), b.data(), b.size(), out.data());
+    CPPUNIT_ASSERT(std::vector<uint64_t>(out.begin(), out.begin() + count) == expected);
+  }
+
+  void merge_kernels() {
+    std::vector<std::pair<kernel, kernel>> kernels;
+    kernels.push_back(std::make_pair(&sorted_set_merge_scalar<true>, &sorted_set_merge_scalar<false>));
+#ifdef THETA_SORTED_SET_SIMD_DISPATCH
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+      kernels.push_back(std::make_pair(&sorted_set_merge_avx2<true>, &sorted_set_merge_avx2<false>));
+    }
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt")) {
+      kernels.push_back(std::make_pair(&sorted_set_merge_avx512<true>, &sorted_set_merge_avx512<false>));
+    }
+#endif
+    kernels.push_back(std::make_pair(&sorted_set_merge<true>, &sorted_set_merge<false>));
+    std::mt19937_64 random(1);
+    // around the block sizes, sparse and dense overlaps
+    for (uint32_t pool: {1, 4, 7, 8, 9, 16, 17, 33, 100, 10000}) {
+      for (double chance_a: {0.1, 0.5, 0.9, 1.0}) {
+        for (double chance_b: {0.1, 0.5, 1.0}) {
+          const std::vector<uint64_t> a = random_keys(random, pool, chance_a);
+          const std::vector<uint64_t> b = random_keys(random, pool, chance_b);
+          for (const auto& merge: kernels) {
+            check_kernel(merge.first, true, a, b);
+            check_kernel(merge.second, false, a, b);
+            check_kernel(merge.first, true, b, a);
+            check_kernel(merge.second, false, b, a);
+          }
+        }
+      }
+    }
+  }
+
+  void intersection_gallops() {
+    std::mt19937_64 random(2);
+    const std::vector<uint64_t> large = random_keys(random, 100000, 0.5);
+    const std::vector<uint64_t> small = random_keys(random, 100000, 0.001);
+    std::vector<uint64_t> expected;
+    std::set_intersection(small.begin(), small.end(), large.begin(), large.end(), std::back_inserter(expected));
+    CPPUNIT_ASSERT(!expected.empty());
+    std::vector<uint64_t> out(small);
+    uint32_t count = sorted_set_intersection(out.data(), out.size(), large.data(), large.size(), UINT64_MAX, out.data());
+    CPPUNIT_ASSERT(std::vector<uint64_t>(out.begin(), out.begin() + count) == expected);
+    out = large;
+    count = sorted_set_intersection(out.data(), out.size(), small.data(), small.size(), UINT64_MAX, out.data());
+    CPPUNIT_ASSERT(std::vector<uint64_t>(out.begin(), out.begin() + count) == expected);
+  }
+
+  void theta_cuts_both_sides() {
+    std::mt19937_64 random(3);
+    const std::vector<uint64_t> a = random_keys(random, 1000, 0.5);
+    const std::vector<uint64_t> b = random_keys(random, 1000, 0.5);
+    const uint64_t theta = 500 * 1000003ULL;
+    std::vector<uint64_t> out(a);
+    uint32_t count = sorted_set_intersection(out.data(), out.size(), b.data(), b.size(), theta, out.data());
+    CPPUNIT_ASSERT(count > 0);
+    for (uint32_t i = 0; i < count; i++) CPPUNIT_ASSERT(out[i] < theta);
+    out = a;
+    count = sorted_set_difference(out.data(), out.size(), b.data(), b.size(), theta, out.data());
+    CPPUNIT_ASSERT(count > 0);
+    for (uint32_t i = 0; i < count; i++) CPPUNIT_ASSERT(out[i] < theta and !std::binary_search(b.begin(), b.end(), out[i]));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32_t>(std::lower_bound(a.begin(), a.end(), theta) - a.begin()),
+        count + static_cast<uint32_t>(sorted_set_intersection(a.data(), a.size(), b.data(), b.size(), theta, out.data())));
+  }
+
+  void union_loser_tree() {
+    std::mt19937_64 random(4);
+    // odd and even counts of runs, some of them empty, cut by theta and by max_keys
+    for (uint32_t num_runs: {1, 2, 3, 5, 8, 13}) {
+      std::vector<std::vector<uint64_t>> keys;
+      std::vector<const uint64_t*> runs;
+      std::vector<uint32_t> sizes;
+      std::set<uint64_t> all;
+      for (uint32_t i = 0; i < num_runs; i++) keys.push_back(random_keys(random, 1000, i % 4 == 3 ? 0.0 : 0.3));
+      for (const auto& run: keys) {
+        runs.push_back(run.data());
+        sizes.push_back(run.size());
+        all.insert(run.begin(), run.end());
+      }
+      const std::vector<uint64_t> expected(all.begin(), all.end());
+      for (uint64_t theta: {static_cast<uint64_t>(UINT64_MAX >> 1), static_cast<uint64_t>(300 * 1000003ULL)}) {
+        const uint32_t below_theta = std::lower_bound(expected.begin(), expected.end(), theta) - expected.begin();
+        for (uint32_t max_keys: {below_theta, below_theta / 2, 1U}) {
+          std::vector<uint64_t> out(max_keys);
+          uint64_t next;
+          const uint32_t count = sorted_set_union<std::allocator<void>>(runs.data(), sizes.data(), num_runs, theta, max_keys, out.data(), next);
+          CPPUNIT_ASSERT_EQUAL(max_keys, count);
+          CPPUNIT_ASSERT(std::equal(out.begin(), out.end(), expected.begin()));
+          CPPUNIT_ASSERT_EQUAL(count < below_theta ? expected[count] : theta, next);
+        }
+      }
+    }
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(theta_sorted_set_test);
+
+} /* namespace datasketches */
@@ -22,6 +22,13 @@
 
 #include <theta_union.hpp>
 
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 namespace datasketches {
 
 class theta_union_test: public CppUnit::TestFixture {
@@ -32,6 +39,12 @@ class theta_union_test: public CppUnit::TestFixture {
   CPPUNIT_TEST(exact_mode_half_overlap);
   CPPUNIT_TEST(estimation_mode_half_overlap);
   CPPUNIT_TEST(seed_mismatch);
+  CPPUNIT_TEST(compact_views);
+  CPPUNIT_TEST(update_range_ordered);
+  CPPUNIT_TEST(update_range_unordered);
+  CPPUNIT_TEST(update_parallel);
+  CPPUNIT_TEST(serialized);
+  CPPUNIT_TEST(streamed);
   CPPUNIT_TEST_SUITE_END();
 
   void empty() {
@@ -105,6 +118,224 @@ class theta_union_test: public CppUnit::TestFixture {
     CPPUNIT_ASSERT_THROW(u.update(sketch), std::invalid_argument);
   }
 
+  void compact_views() {
+    // inputs of larger lg_k than the union, ordered and unordered, and an empty one:
+    // the union trims the views to its own size like the sketches
+    std::vector<compact_theta_sketch> sketches;
+    for (int i = 0; i < 3; i++) {
+      update_theta_sketch sketch = update_theta_sketch::builder().set_lg_k(11 + i).build();
+      for (int j = 0; j < 10000; j++) sketch.update(i * 5000 + j);
+      sketches.push_back(sketch.compact(i % 2 == 0));
+    }
+    sketches.push_back(update_theta_sketch::builder().build().compact());
+    theta_union u1 = theta_union::builder().set_lg_k(10).build();
+    theta_union u2 = theta_union::builder().set_lg_k(10).build();
+    std::vector<std::pair<void_ptr_with_deleter, const size_t>> bytes;
+    for (const auto& sketch: sketches) {
+      bytes.push_back(sketch.serialize());
+      u1.update(sketch);
+      u2.update(compact_theta_sketch_view(bytes.back().first.get(), bytes.back().second));
+    }
+    for (bool ordered: {true, false}) {
+      compact_theta_sketch result1 = u1.get_result(ordered);
+      compact_theta_sketch result2 = u2.get_result(ordered);
+      CPPUNIT_ASSERT(result1.is_estimation_mode());
+      CPPUNIT_ASSERT_EQUAL(result1.get_theta64(), result2.get_theta64());
+      std::vector<uint64_t> keys1(result1.begin(), result1.end());
+      std::vector<uint64_t> keys2(result2.begin(), result2.end());
+      std::sort(keys1.begin(), keys1.end());
+      std::sort(keys2.begin(), keys2.end());
+      CPPUNIT_ASSERT(keys1 == keys2);
+    }
+  }
+
+
+  void update_range_ordered() {
+    // exact and estimation mode inputs, some of them empty
+    std::vector<compact_theta_sketch> sketches;
+    for (int i = 0; i < 7; i++) {
+      update_theta_sketch sketch = update_theta_sketch::builder().set_lg_k(10 + i % 3).build();
+      if (i != 4) for (int j = 0; j < 500 + i * 3000; j++) sketch.update(i * 1000 + j);
+      sketches.push_back(sketch.compact());
+    }
+    theta_union u1 = theta_union::builder().set_lg_k(11).build();
+    for (const auto& sketch: sketches) u1.update(sketch);
+    theta_union u2 = theta_union::builder().set_lg_k(11).build();
+    u2.update(sketches.begin(), sketches.begin() + 3);
+    u2.update(sketches.begin() + 3, sketches.end());
+
+    compact_theta_sketch result1 = u1.get_result();
+    compact_theta_sketch result2 = u2.get_result();
+    CPPUNIT_ASSERT(result1.get_theta64() < theta_sketch::MAX_THETA);
+    CPPUNIT_ASSERT_EQUAL(result1.get_theta64(), result2.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(result1.get_num_retained(), result2.get_num_retained());
+    CPPUNIT_ASSERT(std::equal(result1.begin(), result1.end(), result2.begin()));
+    const compact_theta_sketch unordered = u2.get_result(false);
+    CPPUNIT_ASSERT(std::is_sorted(unordered.begin(), unordered.end()));
+
+    // one by one after the range, through the hash table
+    update_theta_sketch sketch = update_theta_sketch::builder().build();
+    for (int j = 0; j < 1000; j++) sketch.update(100000 + j);
+    u1.update(sketch);
+    u2.update(sketch);
+    result1 = u1.get_result();
+    result2 = u2.get_result();
+    CPPUNIT_ASSERT_EQUAL(result1.get_theta64(), result2.get_theta64());
+    CPPUNIT_ASSERT(std::equal(result1.begin(), result1.end(), result2.begin()));
+  }
+
+  void update_range_unordered() {
+    std::vector<compact_theta_sketch> sketches;
+    for (int i = 0; i < 4; i++) {
+      update_theta_sketch sketch = update_theta_sketch::builder().build();
+      for (int j = 0; j < 3000; j++) sketch.update(i * 1000 + j);
+      sketches.push_back(sketch.compact(i != 2));
+    }
+    theta_union u1 = theta_union::builder().build();
+    for (const auto& sketch: sketches) u1.update(sketch);
+    theta_union u2 = theta_union::builder().build();
+    u2.update(sketches.begin(), sketches.end());
+    compact_theta_sketch result1 = u1.get_result();
+    compact_theta_sketch result2 = u2.get_result();
+    CPPUNIT_ASSERT_EQUAL(result1.get_theta64(), result2.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(result1.get_num_retained(), result2.get_num_retained());
+    CPPUNIT_ASSERT(std::equal(result1.begin(), result1.end(), result2.begin()));
+
+    update_theta_sketch sketch = update_theta_sketch::builder().set_seed(123).build();
+    sketch.update(1);
+    sketches.push_back(sketch.compact());
+    CPPUNIT_ASSERT_THROW(u2.update(sketches.begin(), sketches.end()), std::invalid_argument);
+  }
+
+  void serialized() {
+    std::vector<compact_theta_sketch> sketches;
+    for (int i = 0; i < 4; i++) {
+      update_theta_sketch sketch = update_theta_sketch::builder().set_lg_k(10 + i).build();
+      for (int j = 0; j < 5000 * (i + 1); j++) sketch.update(i * 3000 + j);
+      sketches.push_back(sketch.compact());
+    }
+    sketches.push_back(update_theta_sketch::builder().build().compact());
+    theta_union u1 = theta_union::builder().build();
+    for (const auto& sketch: sketches) u1.update(sketch);
+
+    // compressed, plain, plain at an odd address
+    theta_union u2 = theta_union::builder().build();
+    for (size_t i = 0; i < sketches.size(); i++) {
+      if (i % 3 == 0) {
+        auto bytes = sketches[i].serialize_compressed();
+        u2.update(bytes.first.get(), bytes.second);
+      } else {
+        auto bytes = sketches[i].serialize(i % 3 == 1 ? 0 : 1);
+        u2.update(static_cast<const char*>(bytes.first.get()) + i % 3 - 1, bytes.second - i % 3 + 1);
+      }
+    }
+    compact_theta_sketch result1 = u1.get_result();
+    compact_theta_sketch result2 = u2.get_result();
+    CPPUNIT_ASSERT_EQUAL(result1.get_theta64(), result2.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(result1.get_num_retained(), result2.get_num_retained());
+    CPPUNIT_ASSERT(std::equal(result1.begin(), result1.end(), result2.begin()));
+
+    update_theta_sketch other_seed = update_theta_sketch::builder().set_seed(123).build();
+    other_seed.update(1);
+    other_seed.update(2);
+    auto bytes = other_seed.compact().serialize_compressed();
+    CPPUNIT_ASSERT_THROW(u2.update(bytes.first.get(), bytes.second), std::invalid_argument);
+  }
+
+  void streamed() {
+    std::vector<update_theta_sketch> update_sketches;
+    for (int i = 0; i < 4; i++) {
+      update_sketches.push_back(update_theta_sketch::builder().set_lg_k(10 + i).build());
+      for (int j = 0; j < 5000 * (i + 1); j++) update_sketches.back().update(i * 3000 + j);
+    }
+    update_sketches.push_back(update_theta_sketch::builder().build());
+    theta_union u1 = theta_union::builder().build();
+    for (const auto& sketch: update_sketches) u1.update(sketch);
+
+    // one after the other in one stream: update, ordered, unordered, compressed, empty
+    std::stringstream s(std::ios::in | std::ios::out | std::ios::binary);
+    update_sketches[0].serialize(s);
+    update_sketches[1].compact(true).serialize(s);
+    update_sketches[2].compact(false).serialize(s);
+    update_sketches[3].compact(true).serialize_compressed(s);
+    update_sketches[4].compact().serialize(s);
+    s.put(42);
+    theta_union u2 = theta_union::builder().build();
+    for (size_t i = 0; i < update_sketches.size(); i++) u2.update(s);
+    CPPUNIT_ASSERT_EQUAL(42, s.get());
+    compact_theta_sketch result1 = u1.get_result();
+    compact_theta_sketch result2 = u2.get_result();
+    CPPUNIT_ASSERT_EQUAL(result1.get_theta64(), result2.get_theta64());
+    CPPUNIT_ASSERT_EQUAL(result1.get_num_retained(), result2.get_num_retained());
+    CPPUNIT_ASSERT(std::equal(result1.begin(), result1.end(), result2.begin()));
+
+    // the keys of the lg_k 13 sketch from the theta of the lg_k 10 one on are skipped, not lost
+    theta_union u3 = theta_union::builder().set_lg_k(10).build();
+    update_sketches[0].compact().serialize(s);
+    update_sketches[3].compact().serialize(s);
+    update_sketches[3].compact().serialize_compressed(s);
+    s.put(42);
+    for (int i = 0; i < 3; i++) u3.update(s);
+    CPPUNIT_ASSERT_EQUAL(42, s.get());
+
+    std::stringstream truncated(std::ios::in | std::ios::out | std::ios::binary);
+    update_sketches[1].compact().serialize(truncated);
+    const std::string bytes = truncated.str();
+    truncated.str(bytes.substr(0, bytes.size() - 1));
+    CPPUNIT_ASSERT_THROW(u3.update(truncated), std::runtime_error);
+  }
+
+  // a thread per task, joined when the executor goes
+  struct thread_executor {
+    std::vector<std::thread> threads;
+    void operator()(std::function<void()> task) { threads.emplace_back(task); }
+    ~thread_executor() { for (auto& thread: threads) thread.join(); }
+  };
+
+  void update_parallel() {
+    // estimation mode, ordered and unordered, some empty, different thetas
+    std::vector<compact_theta_sketch> sketches;
+    for (int i = 0; i < 200; i++) {
+      update_theta_sketch sketch = update_theta_sketch::builder().set_lg_k(9 + i % 3).build();
+      if (i % 17 != 0) for (int j = 0; j < 2000 + (i % 7) * 500; j++) sketch.update(i * 300 + j);
+      sketches.push_back(sketch.compact(i % 5 != 0));
+    }
+    theta_union serial = theta_union::builder().set_lg_k(10).build();
+    for (const auto& sketch: sketches) serial.update(sketch);
+    const compact_theta_sketch expected = serial.get_result();
+    CPPUNIT_ASSERT(expected.get_theta64() < theta_sketch::MAX_THETA);
+
+    for (unsigned num_tasks: {1, 3, 8, 500}) {
+      theta_union u = theta_union::builder().set_lg_k(10).build();
+      {
+        thread_executor executor;
+        u.update(sketches.begin(), sketches.end(), executor, num_tasks);
+      }
+      const compact_theta_sketch result = u.get_result();
+      CPPUNIT_ASSERT_EQUAL(expected.get_theta64(), result.get_theta64());
+      CPPUNIT_ASSERT_EQUAL(expected.get_num_retained(), result.get_num_retained());
+      CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), result.begin()));
+    }
+
+    // inline, after a serial update
+    theta_union u = theta_union::builder().set_lg_k(10).build();
+    u.update(sketches[0]);
+    auto inline_executor = [](std::function<void()> task) { task(); };
+    u.update(sketches.begin() + 1, sketches.end(), inline_executor, 4);
+    CPPUNIT_ASSERT_EQUAL(expected.get_theta64(), u.get_result().get_theta64());
+    CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), u.get_result().begin()));
+
+    // a failing executor leaves the union as it was
+    unsigned accepted = 0;
+    auto failing_executor = [&accepted](std::function<void()> task) {
+      if (accepted++ == 2) throw std::runtime_error("pool is shut down");
+      task();
+    };
+    theta_union failed = theta_union::builder().set_lg_k(10).build();
+    CPPUNIT_ASSERT_THROW(failed.update(sketches.begin(), sketches.end(), failing_executor, 4), std::runtime_error);
+    CPPUNIT_ASSERT(failed.get_result().is_empty());
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(theta_union_test);